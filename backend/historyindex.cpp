@@ -0,0 +1,9 @@
+#include "historyindex.h"
+
+void MarkerHistoryIndex::clear() {
+    m_events.clear();
+}
+
+void MarkerHistoryIndex::record(const MarkerEvent& event) {
+    m_events[event.marker.id()].append(event);
+}
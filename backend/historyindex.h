@@ -0,0 +1,47 @@
+#ifndef HISTORYINDEX_H
+#define HISTORYINDEX_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+#include "../src/data/markerevent.h"
+
+/**
+ * @brief 标记历史索引
+ *
+ * 维护 标记ID -> 事件列表（按快照序号递增）的映射，
+ * 查询某个标记的完整生命周期无需扫描全部快照。
+ */
+class MarkerHistoryIndex {
+public:
+    /**
+     * @brief 清空索引
+     */
+    void clear();
+
+    /**
+     * @brief 记录一个事件
+     * @param event 标记事件（快照序号不得小于该标记已记录的事件）
+     */
+    void record(const MarkerEvent& event);
+
+    /**
+     * @brief 判断标记是否有历史记录
+     * @param markerId 标记ID
+     * @return 有记录返回 true
+     */
+    bool contains(const QString& markerId) const { return m_events.contains(markerId); }
+
+    /**
+     * @brief 获取标记的全部事件
+     * @param markerId 标记ID
+     * @return 事件列表（按时间顺序），无记录时为空
+     */
+    QVector<MarkerEvent> events(const QString& markerId) const { return m_events.value(markerId); }
+
+private:
+    QHash<QString, QVector<MarkerEvent>> m_events;  ///< 标记ID -> 事件列表
+};
+
+#endif // HISTORYINDEX_H
@@ -3,6 +3,7 @@
 #include <QCommandLineOption>
 #include <QDebug>
 #include "server.h"
+#include "../src/data/mapjsoncodec.h"
 
 int main(int argc, char *argv[]) {
     QGuiApplication app(argc, argv);
@@ -21,9 +22,15 @@ int main(int argc, char *argv[]) {
                                   "服务器监听端口", "port", "8888");
     parser.addOption(portOption);
 
+    QCommandLineOption decodeThreadsOption(QStringList() << "decode-threads",
+                                           "解码快照数据的最大线程数（0 表示按 CPU 核数）",
+                                           "count", "0");
+    parser.addOption(decodeThreadsOption);
+
     parser.process(app);
 
     quint16 port = parser.value(portOption).toUShort();
+    MapJsonCodec::setMaxDecodeThreads(parser.value(decodeThreadsOption).toInt());
 
     // 创建并启动服务器
     HttpServer server;
@@ -0,0 +1,193 @@
+#include "searchindex.h"
+#include <QSet>
+#include <QtMath>
+#include <algorithm>
+#include <climits>
+
+namespace {
+
+/**
+ * @brief 判断码点是否属于中日韩文字
+ */
+bool isCjk(char32_t ucs4) {
+    switch (QChar::script(ucs4)) {
+        case QChar::Script_Han:
+        case QChar::Script_Hiragana:
+        case QChar::Script_Katakana:
+        case QChar::Script_Hangul:
+        case QChar::Script_Bopomofo:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief 将一段连续的中文字符输出为词项
+ */
+void emitCjkRun(const QStringList& run, bool forQuery, QStringList& tokens) {
+    if (run.isEmpty()) {
+        return;
+    }
+
+    // 单字片段只能以单字形式检索
+    if (run.size() == 1) {
+        tokens.append(run.first());
+        return;
+    }
+
+    // 建索引时同时收录单字，查询时只用二元组（更精确）
+    if (!forQuery) {
+        tokens.append(run);
+    }
+    for (int i = 0; i + 1 < run.size(); ++i) {
+        tokens.append(run[i] + run[i + 1]);
+    }
+}
+
+} // namespace
+
+void MarkerSearchIndex::clear() {
+    m_versions.clear();
+    m_liveVersions.clear();
+    m_postings.clear();
+}
+
+void MarkerSearchIndex::addMarker(const Marker& marker, int snapshotIndex) {
+    // 同一ID重复出现时先关闭旧版本
+    if (m_liveVersions.contains(marker.id())) {
+        removeMarker(marker.id(), snapshotIndex);
+    }
+
+    const QStringList tokens = tokenize(marker.note());
+    const int version = m_versions.size();
+    m_versions.append({marker, snapshotIndex, INT_MAX, static_cast<int>(tokens.size())});
+    m_liveVersions.insert(marker.id(), version);
+
+    // 统计词频并追加到倒排表（版本序号单调递增，倒排表天然有序）
+    QHash<QString, int> frequencies;
+    for (const QString& token : tokens) {
+        ++frequencies[token];
+    }
+    for (auto it = frequencies.cbegin(); it != frequencies.cend(); ++it) {
+        m_postings[it.key()].append({version, it.value()});
+    }
+}
+
+void MarkerSearchIndex::removeMarker(const QString& markerId, int snapshotIndex) {
+    auto it = m_liveVersions.find(markerId);
+    if (it == m_liveVersions.end()) {
+        return;
+    }
+
+    m_versions[it.value()].removedAt = snapshotIndex;
+    m_liveVersions.erase(it);
+}
+
+void MarkerSearchIndex::updateMarker(const Marker& marker, int snapshotIndex) {
+    removeMarker(marker.id(), snapshotIndex);
+    addMarker(marker, snapshotIndex);
+}
+
+QList<MarkerSearchIndex::Hit> MarkerSearchIndex::search(const QString& query, int snapshotIndex) const {
+    QList<Hit> hits;
+
+    const QStringList queryTokens = tokenize(query, true);
+    const QSet<QString> terms(queryTokens.cbegin(), queryTokens.cend());
+    if (terms.isEmpty()) {
+        return hits;
+    }
+
+    // 所有词项都必须出现（AND 语义），从最短的倒排表开始求交集
+    QList<const QVector<Posting>*> lists;
+    for (const QString& term : terms) {
+        auto it = m_postings.constFind(term);
+        if (it == m_postings.cend()) {
+            return hits;
+        }
+        lists.append(&it.value());
+    }
+    std::sort(lists.begin(), lists.end(), [](const QVector<Posting>* a, const QVector<Posting>* b) {
+        return a->size() < b->size();
+    });
+
+    const double versionCount = m_versions.size();
+    QHash<int, double> scores;
+    bool first = true;
+    for (const QVector<Posting>* list : lists) {
+        const double idf = qLn(1.0 + versionCount / list->size());
+        QHash<int, double> next;
+        for (const Posting& posting : *list) {
+            const Version& version = m_versions[posting.version];
+            if (version.addedAt > snapshotIndex || version.removedAt <= snapshotIndex) {
+                continue;
+            }
+            if (!first && !scores.contains(posting.version)) {
+                continue;
+            }
+            const double weight = posting.frequency * idf / qSqrt(qMax(1, version.length));
+            next.insert(posting.version, scores.value(posting.version) + weight);
+        }
+        scores = next;
+        first = false;
+        if (scores.isEmpty()) {
+            return hits;
+        }
+    }
+
+    // 备注中完整包含查询串的结果额外加权
+    const QString needle = query.trimmed();
+    hits.reserve(scores.size());
+    for (auto it = scores.cbegin(); it != scores.cend(); ++it) {
+        const Marker& marker = m_versions[it.key()].marker;
+        double score = it.value();
+        if (marker.note().contains(needle, Qt::CaseInsensitive)) {
+            score *= 2.0;
+        }
+        hits.append({marker, score});
+    }
+
+    // 得分降序，同分时较新的标记优先
+    std::sort(hits.begin(), hits.end(), [](const Hit& a, const Hit& b) {
+        if (a.score != b.score) {
+            return a.score > b.score;
+        }
+        return a.marker.createTime() > b.marker.createTime();
+    });
+
+    return hits;
+}
+
+QStringList MarkerSearchIndex::tokenize(const QString& text, bool forQuery) {
+    QStringList tokens;
+    QStringList cjkRun;
+    QString word;
+
+    auto flushWord = [&]() {
+        if (!word.isEmpty()) {
+            tokens.append(word.toCaseFolded());
+            word.clear();
+        }
+    };
+
+    const QList<uint> codePoints = text.toUcs4();
+    for (uint value : codePoints) {
+        const char32_t ucs4 = value;
+        if (isCjk(ucs4)) {
+            flushWord();
+            cjkRun.append(QString::fromUcs4(&ucs4, 1));
+        } else if (QChar::isLetterOrNumber(ucs4)) {
+            emitCjkRun(cjkRun, forQuery, tokens);
+            cjkRun.clear();
+            word.append(QString::fromUcs4(&ucs4, 1));
+        } else {
+            flushWord();
+            emitCjkRun(cjkRun, forQuery, tokens);
+            cjkRun.clear();
+        }
+    }
+    flushWord();
+    emitCjkRun(cjkRun, forQuery, tokens);
+
+    return tokens;
+}
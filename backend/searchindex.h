@@ -0,0 +1,99 @@
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QVector>
+#include <QList>
+
+#include "../src/data/marker.h"
+
+/**
+ * @brief 标记备注全文检索索引（倒排索引）
+ *
+ * 分词规则：
+ * - 中日韩文字：连续片段切分为二元组（bigram），同时收录单字以支持单字查询
+ * - 拉丁字母/数字：按单词切分，统一转为小写
+ *
+ * 索引记录的是标记的"版本"：每个版本带有生效区间 [addedAt, removedAt)，
+ * 以快照序号表示。添加、删除、修改标记时只追加或关闭版本，无需重建，
+ * 因此既能增量维护，又能回答"某个历史时刻"的检索。
+ */
+class MarkerSearchIndex {
+public:
+    /**
+     * @brief 检索结果
+     */
+    struct Hit {
+        Marker marker;      ///< 命中的标记（该时刻的数据）
+        double score;       ///< 相关度得分，越大越相关
+    };
+
+    /**
+     * @brief 清空索引
+     */
+    void clear();
+
+    /**
+     * @brief 标记在指定快照中出现（新增）
+     * @param marker 标记数据
+     * @param snapshotIndex 快照序号
+     */
+    void addMarker(const Marker& marker, int snapshotIndex);
+
+    /**
+     * @brief 标记在指定快照中被删除
+     * @param markerId 标记ID
+     * @param snapshotIndex 快照序号
+     */
+    void removeMarker(const QString& markerId, int snapshotIndex);
+
+    /**
+     * @brief 标记内容在指定快照中被修改
+     * @param marker 修改后的标记数据
+     * @param snapshotIndex 快照序号
+     */
+    void updateMarker(const Marker& marker, int snapshotIndex);
+
+    /**
+     * @brief 检索指定时刻的标记
+     * @param query 查询文本
+     * @param snapshotIndex 快照序号（检索该快照中存在的标记）
+     * @return 按相关度降序排列的全部命中结果
+     */
+    QList<Hit> search(const QString& query, int snapshotIndex) const;
+
+    /**
+     * @brief 对文本分词
+     * @param text 待分词文本
+     * @param forQuery true 时为查询分词：长度大于1的中文片段只取二元组
+     * @return 词项列表（可能包含重复项）
+     */
+    static QStringList tokenize(const QString& text, bool forQuery = false);
+
+private:
+    /**
+     * @brief 标记的一个版本
+     */
+    struct Version {
+        Marker marker;      ///< 该版本的标记数据
+        int addedAt;        ///< 生效的快照序号
+        int removedAt;      ///< 失效的快照序号（仍然有效时为 INT_MAX）
+        int length;         ///< 词项总数，用于长度归一化
+    };
+
+    /**
+     * @brief 倒排表项
+     */
+    struct Posting {
+        int version;        ///< 版本序号
+        int frequency;      ///< 词项在该版本中出现的次数
+    };
+
+    QVector<Version> m_versions;                    ///< 所有版本
+    QHash<QString, int> m_liveVersions;             ///< 标记ID -> 当前有效的版本序号
+    QHash<QString, QVector<Posting>> m_postings;    ///< 词项 -> 倒排表（按版本序号递增）
+};
+
+#endif // SEARCHINDEX_H
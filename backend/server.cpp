@@ -6,6 +6,54 @@
 #include <QCoreApplication>
 #include <QUrlQuery>
 #include <QRegularExpression>
+#include <algorithm>
+
+#include "../src/data/markerdiff.h"
+#include "../src/data/mapjsoncodec.h"
+#include "../src/data/markerpatch.h"
+
+namespace {
+
+/**
+ * @brief 拆分请求路径（不含查询参数）
+ * @return 各段（按 URL 编码分别解码，编码的 "/" 不拆分）；路径不以 "/" 开头时返回空列表
+ */
+QStringList pathSegments(const QUrl& url) {
+    const QString encoded = url.path(QUrl::FullyEncoded);
+    if (!encoded.startsWith('/')) {
+        return QStringList();
+    }
+    QStringList segments = encoded.mid(1).split('/');
+    for (QString& segment : segments) {
+        segment = QUrl::fromPercentEncoding(segment.toUtf8());
+    }
+    return segments;
+}
+
+/**
+ * @brief 按段匹配路由
+ * @param segments 请求路径的各段
+ * @param pattern 路由各段，"{id}" 匹配任意一段（可为空，由调用方检查）
+ * @param id 输出："{id}" 匹配到的段
+ * @return 段数相同且其余各段完全相同时返回 true
+ */
+bool matchRoute(const QStringList& segments, const QStringList& pattern, QString* id = nullptr) {
+    if (segments.size() != pattern.size()) {
+        return false;
+    }
+    for (int i = 0; i < pattern.size(); ++i) {
+        if (pattern[i] == QLatin1String("{id}")) {
+            if (id) {
+                *id = segments[i];
+            }
+        } else if (segments[i] != pattern[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
 
 HttpServer::HttpServer(QObject* parent)
     : QObject(parent)
@@ -53,18 +101,20 @@ void HttpServer::loadData() {
     QByteArray data = file.readAll();
     file.close();
 
-    QJsonDocument doc = QJsonDocument::fromJson(data);
-    if (!doc.isArray()) {
-        qWarning() << "Invalid data format, expected array";
+    QList<MapSnapshot> snapshots;
+    QString errorMessage;
+    if (!MapJsonCodec::readSnapshots(data, &snapshots, &errorMessage)) {
+        qWarning() << "Invalid data format:" << errorMessage;
         return;
     }
 
-    QJsonArray snapshotArray = doc.array();
-    m_snapshots.clear();
-    for (const QJsonValue& value : snapshotArray) {
-        m_snapshots.append(MapSnapshot::fromJson(value.toObject()));
+    m_snapshots = snapshots;
+    for (int i = 1; i < m_snapshots.size(); ++i) {
+        m_snapshots[i].shareMarkersWith(m_snapshots[i - 1]);
     }
 
+    rebuildIndexes();
+
     qDebug() << "Loaded" << m_snapshots.size() << "snapshots from file";
 }
 
@@ -75,13 +125,7 @@ void HttpServer::saveData() {
         return;
     }
 
-    QJsonArray snapshotArray;
-    for (const MapSnapshot& snapshot : m_snapshots) {
-        snapshotArray.append(snapshot.toJson());
-    }
-
-    QJsonDocument doc(snapshotArray);
-    file.write(doc.toJson());
+    file.write(MapJsonCodec::writeSnapshots(m_snapshots, QJsonDocument::Indented));
     file.close();
 
     qDebug() << "Saved" << m_snapshots.size() << "snapshots to file";
@@ -115,6 +159,15 @@ void HttpServer::onRequestReady() {
     QString path = requestLine[1];
     QString body;
 
+    // 提取操作者（X-User 请求头）
+    QString user;
+    for (int i = 1; i < lines.size() && !lines[i].isEmpty(); ++i) {
+        if (lines[i].startsWith("X-User:", Qt::CaseInsensitive)) {
+            user = lines[i].mid(QString("X-User:").length()).trimmed();
+            break;
+        }
+    }
+
     // 提取请求体
     int emptyLinePos = request.indexOf("\r\n\r\n");
     if (emptyLinePos >= 0) {
@@ -123,41 +176,63 @@ void HttpServer::onRequestReady() {
 
     qDebug() << "Request:" << method << path;
 
-    handleRequest(method, path, body.toUtf8(), socket);
+    handleRequest(method, path, body.toUtf8(), user, socket);
 }
 
 void HttpServer::handleRequest(const QString& method, const QString& path,
-                                const QByteArray& body, QTcpSocket* socket) {
+                                const QByteArray& body, const QString& user,
+                                QTcpSocket* socket) {
+    // 只解析一次路径，各方法都按段匹配
+    const QUrl url(path);
+    const QStringList segments = pathSegments(url);
+    QString markerId;
+
     // GET /api/map/snapshots - 获取所有快照
-    if (method == "GET" && path == "/api/map/snapshots") {
-        QJsonArray snapshotArray;
-        for (const MapSnapshot& snapshot : m_snapshots) {
-            snapshotArray.append(snapshot.toJson());
+    if (method == "GET" && matchRoute(segments, {"api", "map", "snapshots"})) {
+        sendJsonArrayResponse(socket, 200,
+                              MapJsonCodec::writeSnapshots(m_snapshots, QJsonDocument::Compact));
+        return;
+    }
+
+    // GET /api/map/markers/search?q=&at=&offset=&limit= - 检索标记备注
+    if (method == "GET" && matchRoute(segments, {"api", "map", "markers", "search"})) {
+        handleSearch(QUrlQuery(url), socket);
+        return;
+    }
+
+    // GET /api/map/markers/{id}/history - 获取标记的生命周期
+    // （search 是保留的子路径，不作为标记ID）
+    if (method == "GET" && matchRoute(segments, {"api", "map", "markers", "{id}", "history"}, &markerId)
+        && markerId != QLatin1String("search")) {
+        if (markerId.isEmpty()) {
+            sendResponse(socket, 400, "Missing marker id");
+            return;
         }
-        sendJsonArrayResponse(socket, 200, snapshotArray);
+        handleMarkerHistory(markerId, socket);
         return;
     }
 
     // POST /api/map/markers - 添加标记
-    if (method == "POST" && path == "/api/map/markers") {
-        QJsonDocument doc = QJsonDocument::fromJson(body);
-        if (!doc.isObject()) {
+    if (method == "POST" && matchRoute(segments, {"api", "map", "markers"})) {
+        Marker marker;
+        if (!MapJsonCodec::readMarker(body, &marker)) {
             sendResponse(socket, 400, "Invalid JSON");
             return;
         }
 
-        Marker marker = Marker::fromJson(doc.object());
-
-        // 创建新快照
-        QList<Marker> currentMarkers;
+        // 创建新快照（在最新快照的标记集合上插入，与之共享结构）
+        PersistentMarkerMap currentMarkers;
         if (!m_snapshots.isEmpty()) {
-            currentMarkers = m_snapshots.last().markers();
+            currentMarkers = m_snapshots.last().markerMap();
         }
-        currentMarkers.append(marker);
+        currentMarkers.insert(marker);
 
         QString description = QString("添加标记: %1").arg(marker.note().left(20));
+        if (!user.isEmpty()) {
+            description += QString(" (操作者: %1)").arg(user);
+        }
         MapSnapshot newSnapshot(QDateTime::currentDateTime(), currentMarkers, description);
-        m_snapshots.append(newSnapshot);
+        appendSnapshot(newSnapshot);
 
         // 持久化
         saveData();
@@ -167,38 +242,84 @@ void HttpServer::handleRequest(const QString& method, const QString& path,
         return;
     }
 
-    // DELETE /api/map/markers/{id} - 删除标记
-    if (method == "DELETE" && path.startsWith("/api/map/markers/")) {
-        QString markerId = path.mid(QString("/api/map/markers/").length());
+    // PATCH /api/map/markers/{id} - 修改标记（请求体只包含变化的字段）
+    if (method == "PATCH" && matchRoute(segments, {"api", "map", "markers", "{id}"}, &markerId)) {
+        if (markerId.isEmpty()) {
+            sendResponse(socket, 400, "Missing marker id");
+            return;
+        }
+
+        const QJsonDocument doc = QJsonDocument::fromJson(body);
+        MarkerPatch patch;
+        if (!doc.isObject() || !MarkerPatch::fromJson(markerId, doc.object(), &patch)) {
+            sendResponse(socket, 400, "Invalid JSON");
+            return;
+        }
 
-        // 从最新快照中删除标记
         if (m_snapshots.isEmpty()) {
             sendResponse(socket, 404, "No snapshots found");
             return;
         }
 
-        QList<Marker> currentMarkers = m_snapshots.last().markers();
-        bool found = false;
-        Marker deletedMarker;
+        // 在最新快照的标记集合上修改，与之共享结构
+        PersistentMarkerMap currentMarkers = m_snapshots.last().markerMap();
+        if (!currentMarkers.contains(markerId)) {
+            sendResponse(socket, 404, "Marker not found");
+            return;
+        }
+
+        const Marker before = currentMarkers.value(markerId);
+        const Marker after = patch.applyTo(before);
+        const MarkerPatch changes = MarkerPatch::between(before, after);
+
+        // 没有实际变化时不创建快照
+        if (!changes.isEmpty()) {
+            currentMarkers.insert(after);
 
-        for (int i = 0; i < currentMarkers.size(); ++i) {
-            if (currentMarkers[i].id() == markerId) {
-                deletedMarker = currentMarkers[i];
-                currentMarkers.removeAt(i);
-                found = true;
-                break;
+            QString description = changes.describe(after.note());
+            if (!user.isEmpty()) {
+                description += QString(" (操作者: %1)").arg(user);
             }
+            MapSnapshot newSnapshot(QDateTime::currentDateTime(), currentMarkers, description);
+            appendSnapshot(newSnapshot);
+
+            // 持久化
+            saveData();
+        }
+
+        sendJsonResponse(socket, 200, after.toJson());
+        qDebug() << "Marker updated:" << markerId << "fields:" << int(changes.fields);
+        return;
+    }
+
+    // DELETE /api/map/markers/{id} - 删除标记
+    if (method == "DELETE" && matchRoute(segments, {"api", "map", "markers", "{id}"}, &markerId)) {
+        if (markerId.isEmpty()) {
+            sendResponse(socket, 400, "Missing marker id");
+            return;
+        }
+
+        // 从最新快照中删除标记
+        if (m_snapshots.isEmpty()) {
+            sendResponse(socket, 404, "No snapshots found");
+            return;
         }
 
-        if (!found) {
+        PersistentMarkerMap currentMarkers = m_snapshots.last().markerMap();
+        Marker deletedMarker = currentMarkers.value(markerId);
+
+        if (!currentMarkers.remove(markerId)) {
             sendResponse(socket, 404, "Marker not found");
             return;
         }
 
         // 创建新快照
         QString description = QString("删除标记: %1").arg(deletedMarker.note().left(20));
+        if (!user.isEmpty()) {
+            description += QString(" (操作者: %1)").arg(user);
+        }
         MapSnapshot newSnapshot(QDateTime::currentDateTime(), currentMarkers, description);
-        m_snapshots.append(newSnapshot);
+        appendSnapshot(newSnapshot);
 
         // 持久化
         saveData();
@@ -212,25 +333,24 @@ void HttpServer::handleRequest(const QString& method, const QString& path,
     }
 
     // POST /api/map/snapshots/batch - 批量上传快照
-    if (method == "POST" && path == "/api/map/snapshots/batch") {
-        QJsonDocument doc = QJsonDocument::fromJson(body);
-        if (!doc.isArray()) {
+    if (method == "POST" && matchRoute(segments, {"api", "map", "snapshots", "batch"})) {
+        QList<MapSnapshot> snapshots;
+        if (!MapJsonCodec::readSnapshots(body, &snapshots)) {
             sendResponse(socket, 400, "Invalid JSON array");
             return;
         }
 
-        QJsonArray snapshotArray = doc.array();
-        for (const QJsonValue& value : snapshotArray) {
-            m_snapshots.append(MapSnapshot::fromJson(value.toObject()));
+        for (const MapSnapshot& snapshot : snapshots) {
+            appendSnapshot(snapshot);
         }
 
         // 持久化
         saveData();
 
         QJsonObject response;
-        response["message"] = QString("Uploaded %1 snapshots").arg(snapshotArray.size());
+        response["message"] = QString("Uploaded %1 snapshots").arg(snapshots.size());
         sendJsonResponse(socket, 201, response);
-        qDebug() << "Uploaded" << snapshotArray.size() << "snapshots";
+        qDebug() << "Uploaded" << snapshots.size() << "snapshots";
         return;
     }
 
@@ -238,6 +358,146 @@ void HttpServer::handleRequest(const QString& method, const QString& path,
     sendResponse(socket, 404, "Not Found");
 }
 
+void HttpServer::handleSearch(const QUrlQuery& query, QTcpSocket* socket) {
+    const QString text = query.queryItemValue("q", QUrl::FullyDecoded).trimmed();
+    if (text.isEmpty()) {
+        sendResponse(socket, 400, "Missing query parameter: q");
+        return;
+    }
+
+    const QString at = query.queryItemValue("at", QUrl::FullyDecoded);
+    const int snapshotIndex = resolveSnapshotIndex(at);
+    if (!at.isEmpty() && snapshotIndex < 0) {
+        sendResponse(socket, 404, "Snapshot not found");
+        return;
+    }
+
+    // 分页参数
+    bool ok = false;
+    int offset = query.queryItemValue("offset").toInt(&ok);
+    if (!ok || offset < 0) {
+        offset = 0;
+    }
+    int limit = query.queryItemValue("limit").toInt(&ok);
+    if (!ok || limit <= 0) {
+        limit = 20;
+    }
+    limit = qMin(limit, 100);
+
+    const QList<MarkerSearchIndex::Hit> hits = m_searchIndex.search(text, snapshotIndex);
+
+    QJsonArray results;
+    for (int i = offset; i < hits.size() && i < offset + limit; ++i) {
+        QJsonObject item = hits[i].marker.toJson();
+        item["score"] = hits[i].score;
+        results.append(item);
+    }
+
+    QJsonObject response;
+    response["query"] = text;
+    response["at"] = snapshotIndex;
+    response["total"] = static_cast<int>(hits.size());
+    response["offset"] = offset;
+    response["limit"] = limit;
+    response["results"] = results;
+    sendJsonResponse(socket, 200, response);
+    qDebug() << "Search:" << text << "at" << snapshotIndex << "hits:" << hits.size();
+}
+
+void HttpServer::handleMarkerHistory(const QString& markerId, QTcpSocket* socket) {
+    if (!m_historyIndex.contains(markerId)) {
+        sendResponse(socket, 404, "Marker not found");
+        return;
+    }
+
+    QJsonArray events;
+    for (const MarkerEvent& event : m_historyIndex.events(markerId)) {
+        events.append(event.toJson());
+    }
+
+    QJsonObject response;
+    response["markerId"] = markerId;
+    response["events"] = events;
+    sendJsonResponse(socket, 200, response);
+    qDebug() << "History:" << markerId << "events:" << events.size();
+}
+
+void HttpServer::appendSnapshot(const MapSnapshot& snapshot) {
+    m_snapshots.append(snapshot);
+    if (m_snapshots.size() > 1) {
+        m_snapshots.last().shareMarkersWith(m_snapshots[m_snapshots.size() - 2]);
+    }
+    indexSnapshot(m_snapshots.size() - 1);
+}
+
+void HttpServer::indexSnapshot(int index) {
+    const PersistentMarkerMap previous = index > 0 ? m_snapshots[index - 1].markerMap()
+                                                   : PersistentMarkerMap();
+    const MapSnapshot& snapshot = m_snapshots[index];
+    const MarkerDiff diff = PersistentMarkerMap::diff(previous, snapshot.markerMap());
+
+    MarkerEvent event;
+    event.snapshotIndex = index;
+    event.snapshotId = snapshot.snapshotId();
+    event.timestamp = snapshot.timestamp();
+    event.operatorName = MarkerEvent::operatorFromDescription(snapshot.description());
+
+    for (const Marker& marker : diff.removed) {
+        m_searchIndex.removeMarker(marker.id(), index);
+        event.type = MarkerEvent::Deleted;
+        event.marker = marker;
+        m_historyIndex.record(event);
+    }
+    for (const Marker& marker : diff.updated) {
+        m_searchIndex.updateMarker(marker, index);
+        event.type = MarkerEvent::Updated;
+        event.marker = marker;
+        m_historyIndex.record(event);
+    }
+    for (const Marker& marker : diff.added) {
+        m_searchIndex.addMarker(marker, index);
+        MarkerEvent added = event;
+        added.type = MarkerEvent::Added;
+        added.marker = marker;
+        if (added.operatorName.isEmpty()) {
+            added.operatorName = marker.createdBy();
+        }
+        m_historyIndex.record(added);
+    }
+}
+
+void HttpServer::rebuildIndexes() {
+    m_searchIndex.clear();
+    m_historyIndex.clear();
+    for (int i = 0; i < m_snapshots.size(); ++i) {
+        indexSnapshot(i);
+    }
+}
+
+int HttpServer::resolveSnapshotIndex(const QString& at) const {
+    if (at.isEmpty()) {
+        return m_snapshots.size() - 1;
+    }
+
+    // 快照序号
+    bool ok = false;
+    const int index = at.toInt(&ok);
+    if (ok) {
+        return (index >= 0 && index < m_snapshots.size()) ? index : -1;
+    }
+
+    // ISO 8601 时间：取不晚于该时间的最后一个快照（快照按时间顺序追加）
+    const QDateTime time = QDateTime::fromString(at, Qt::ISODate);
+    if (!time.isValid()) {
+        return -1;
+    }
+    auto it = std::upper_bound(m_snapshots.cbegin(), m_snapshots.cend(), time,
+                               [](const QDateTime& t, const MapSnapshot& snapshot) {
+                                   return t < snapshot.timestamp();
+                               });
+    return static_cast<int>(it - m_snapshots.cbegin()) - 1;
+}
+
 void HttpServer::sendResponse(QTcpSocket* socket, int statusCode,
                               const QByteArray& data) {
     QString statusText;
@@ -296,28 +556,26 @@ void HttpServer::sendJsonResponse(QTcpSocket* socket, int statusCode,
 }
 
 void HttpServer::sendJsonArrayResponse(QTcpSocket* socket, int statusCode,
-                                       const QJsonArray& array) {
-    QJsonDocument doc(array);
-    QByteArray data = doc.toJson(QJsonDocument::Compact);
-
+                                       const QByteArray& json) {
     QString statusText;
     switch (statusCode) {
         case 200: statusText = "OK"; break;
         default: statusText = "Unknown"; break;
     }
 
-    QString response = QString("HTTP/1.1 %1 %2\r\n"
-                               "Content-Type: application/json\r\n"
-                               "Content-Length: %3\r\n"
-                               "Access-Control-Allow-Origin: *\r\n"
-                               "Connection: close\r\n"
-                               "\r\n%4")
-                          .arg(statusCode)
-                          .arg(statusText)
-                          .arg(data.size())
-                          .arg(QString::fromUtf8(data));
-
-    socket->write(response.toUtf8());
+    // 响应体可能很大，直接写出已编码的字节，不再经过 QString
+    QString header = QString("HTTP/1.1 %1 %2\r\n"
+                             "Content-Type: application/json\r\n"
+                             "Content-Length: %3\r\n"
+                             "Access-Control-Allow-Origin: *\r\n"
+                             "Connection: close\r\n"
+                             "\r\n")
+                        .arg(statusCode)
+                        .arg(statusText)
+                        .arg(json.size());
+
+    socket->write(header.toUtf8());
+    socket->write(json);
     socket->flush();
     socket->disconnectFromHost();
 }
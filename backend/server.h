@@ -6,9 +6,12 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QList>
+#include <QUrlQuery>
 
 #include "../src/data/marker.h"
 #include "../src/data/mapsnapshot.h"
+#include "searchindex.h"
+#include "historyindex.h"
 
 /**
  * @brief 简单的 HTTP 服务器
@@ -64,13 +67,15 @@ private slots:
 private:
     /**
      * @brief 处理 HTTP 请求
-     * @param method HTTP 方法 (GET/POST/DELETE)
+     * @param method HTTP 方法 (GET/POST/PATCH/DELETE)
      * @param path 请求路径
      * @param body 请求体
+     * @param user 请求头 X-User 中的操作者（可为空）
      * @param socket 客户端 socket
      */
     void handleRequest(const QString& method, const QString& path,
-                      const QByteArray& body, QTcpSocket* socket);
+                      const QByteArray& body, const QString& user,
+                      QTcpSocket* socket);
 
     /**
      * @brief 发送 HTTP 响应
@@ -94,15 +99,55 @@ private:
      * @brief 发送 JSON 数组响应
      * @param socket 客户端 socket
      * @param statusCode 状态码
-     * @param array JSON 数组
+     * @param json 已编码的 JSON 数组（UTF-8）
      */
     void sendJsonArrayResponse(QTcpSocket* socket, int statusCode,
-                               const QJsonArray& array);
+                               const QByteArray& json);
+
+    /**
+     * @brief 处理标记检索请求
+     * @param query 请求的查询参数（q, at, offset, limit）
+     * @param socket 客户端 socket
+     */
+    void handleSearch(const QUrlQuery& query, QTcpSocket* socket);
+
+    /**
+     * @brief 处理标记历史请求
+     * @param markerId 标记ID
+     * @param socket 客户端 socket
+     */
+    void handleMarkerHistory(const QString& markerId, QTcpSocket* socket);
+
+    /**
+     * @brief 追加一个快照并增量更新索引
+     * @param snapshot 新快照
+     */
+    void appendSnapshot(const MapSnapshot& snapshot);
+
+    /**
+     * @brief 将指定快照相对前一个快照的变化写入索引
+     * @param index 快照序号
+     */
+    void indexSnapshot(int index);
+
+    /**
+     * @brief 根据全部快照重建索引
+     */
+    void rebuildIndexes();
+
+    /**
+     * @brief 将 at 参数解析为快照序号
+     * @param at 快照序号或 ISO 8601 时间，为空表示最新
+     * @return 快照序号；无法解析返回 -1
+     */
+    int resolveSnapshotIndex(const QString& at) const;
 
 private:
     QTcpServer* m_tcpServer;
     QList<MapSnapshot> m_snapshots;  ///< 所有快照数据
     QString m_dataFile;               ///< 数据文件路径
+    MarkerSearchIndex m_searchIndex;  ///< 备注全文检索索引
+    MarkerHistoryIndex m_historyIndex; ///< 标记历史索引
 };
 
 #endif // SERVER_H
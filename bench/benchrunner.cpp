@@ -0,0 +1,118 @@
+#include "benchrunner.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSysInfo>
+#include <QTextStream>
+#include <QThread>
+#include <ctime>
+
+BenchRunner::BenchRunner(const Options& options)
+    : m_options(options)
+{
+}
+
+bool BenchRunner::shouldRun(const QString& name) const {
+    return m_options.filter.pattern().isEmpty() || m_options.filter.match(name).hasMatch();
+}
+
+void BenchRunner::run(const QString& name, const std::function<void()>& operation) {
+    if (!shouldRun(name)) {
+        return;
+    }
+
+    // 预热一次（分配缓存、驻留字符串等）
+    operation();
+
+    qint64 iterations = 1;
+    for (;;) {
+        QElapsedTimer timer;
+        const std::clock_t cpuStart = std::clock();
+        timer.start();
+        for (qint64 i = 0; i < iterations; ++i) {
+            operation();
+        }
+        const double realNs = double(timer.nsecsElapsed());
+        const double cpuNs = double(std::clock() - cpuStart) * 1e9 / CLOCKS_PER_SEC;
+
+        const double minTimeNs = m_options.minTimeMs * 1e6;
+        if (realNs >= minTimeNs || iterations >= m_options.maxIterations) {
+            report(name, iterations, realNs, cpuNs);
+            return;
+        }
+
+        // 按已测速度估算达到下限所需的次数，多留 40% 余量，每轮至少翻倍
+        const double scale = realNs > 0 ? minTimeNs * 1.4 / realNs : 10.0;
+        iterations = qMin(m_options.maxIterations,
+                          qMax(iterations * 2, qint64(double(iterations) * qMin(scale, 10.0))));
+    }
+}
+
+void BenchRunner::runFixed(const QString& name, int iterations,
+                           const std::function<void(int)>& operation) {
+    if (!shouldRun(name) || iterations <= 0) {
+        return;
+    }
+
+    QElapsedTimer timer;
+    const std::clock_t cpuStart = std::clock();
+    timer.start();
+    for (int i = 0; i < iterations; ++i) {
+        operation(i);
+    }
+    const double realNs = double(timer.nsecsElapsed());
+    const double cpuNs = double(std::clock() - cpuStart) * 1e9 / CLOCKS_PER_SEC;
+    report(name, iterations, realNs, cpuNs);
+}
+
+void BenchRunner::report(const QString& name, qint64 iterations, double realNs, double cpuNs) {
+    const double realPerIteration = realNs / double(iterations);
+    const double cpuPerIteration = cpuNs / double(iterations);
+
+    QTextStream out(stdout);
+    out << name.leftJustified(48) << QString::number(iterations).rightJustified(12)
+        << QString::number(realPerIteration, 'f', 0).rightJustified(16) << " ns"
+        << QString::number(cpuPerIteration, 'f', 0).rightJustified(16) << " ns\n";
+    out.flush();
+
+    QJsonObject result;
+    result["name"] = name;
+    result["run_name"] = name;
+    result["run_type"] = "iteration";
+    result["iterations"] = iterations;
+    result["real_time"] = realPerIteration;
+    result["cpu_time"] = cpuPerIteration;
+    result["time_unit"] = "ns";
+    m_results.append(result);
+}
+
+bool BenchRunner::writeJson(const QString& fileName) const {
+    QJsonObject context;
+    context["date"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+    context["host_name"] = QSysInfo::machineHostName();
+    context["executable"] = "LibraryMapBench";
+    context["num_cpus"] = QThread::idealThreadCount();
+    context["cpu_architecture"] = QSysInfo::currentCpuArchitecture();
+    context["os"] = QSysInfo::prettyProductName();
+    context["qt_version"] = QString::fromLatin1(qVersion());
+#ifdef NDEBUG
+    context["library_build_type"] = "release";
+#else
+    context["library_build_type"] = "debug";
+#endif
+
+    QJsonObject root;
+    root["context"] = context;
+    root["benchmarks"] = m_results;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open benchmark output file:" << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson());
+    return true;
+}
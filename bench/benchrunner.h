@@ -0,0 +1,92 @@
+#ifndef BENCHRUNNER_H
+#define BENCHRUNNER_H
+
+#include <QJsonArray>
+#include <QRegularExpression>
+#include <QString>
+#include <functional>
+
+/**
+ * @class BenchRunner
+ * @brief 简单的基准测试执行器
+ *
+ * 每个用例自动增加迭代次数，直到累计耗时达到下限，报告每次迭代的平均耗时。
+ * 结果输出到控制台，并可导出为 Google Benchmark 兼容的 JSON
+ * （context + benchmarks[name, iterations, real_time, cpu_time, time_unit]），
+ * 便于用现有的比较工具跟踪性能回归。
+ */
+class BenchRunner {
+public:
+    /**
+     * @brief 运行选项
+     */
+    struct Options {
+        QRegularExpression filter;      ///< 只运行名称匹配的用例（空表示全部）
+        double minTimeMs = 200.0;       ///< 每个用例的最少累计耗时（毫秒）
+        qint64 maxIterations = 1000000000;  ///< 迭代次数上限
+        bool quick = false;             ///< 只运行最小规模
+    };
+
+    /**
+     * @brief 构造函数
+     * @param options 运行选项
+     */
+    explicit BenchRunner(const Options& options);
+
+    /**
+     * @brief 是否运行指定用例
+     * @param name 用例名称
+     */
+    bool shouldRun(const QString& name) const;
+
+    /**
+     * @brief 是否只运行最小规模
+     */
+    bool quick() const { return m_options.quick; }
+
+    /**
+     * @brief 运行用例：重复执行直到累计耗时达到下限
+     * @param name 用例名称（如 "MapSnapshot/toJson/1000"）
+     * @param operation 一次迭代
+     */
+    void run(const QString& name, const std::function<void()>& operation);
+
+    /**
+     * @brief 运行用例：固定执行 iterations 次
+     * @param name 用例名称
+     * @param iterations 迭代次数
+     * @param operation 一次迭代（参数为迭代序号）
+     *
+     * 用于会改变状态的操作（添加、删除），每次迭代面对的数据规模基本不变。
+     */
+    void runFixed(const QString& name, int iterations,
+                  const std::function<void(int)>& operation);
+
+    /**
+     * @brief 导出 JSON 结果
+     * @param fileName 输出文件
+     * @return 成功返回 true
+     */
+    bool writeJson(const QString& fileName) const;
+
+private:
+    void report(const QString& name, qint64 iterations, double realNs, double cpuNs);
+
+    Options m_options;
+    QJsonArray m_results;   ///< 已完成的用例结果
+};
+
+/**
+ * @brief 防止编译器优化掉基准测试中未使用的结果
+ */
+template <typename T>
+inline void doNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+#endif // BENCHRUNNER_H
@@ -0,0 +1,500 @@
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QJsonDocument>
+#include <QImage>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QPainter>
+#include <QRandomGenerator>
+#include <QStyleOptionGraphicsItem>
+#include <QDebug>
+
+#include "benchrunner.h"
+#include "src/core/markermanager.h"
+#include "src/core/snapshothistory.h"
+#include "src/data/dataschema.h"
+#include "src/data/mapjsoncodec.h"
+#include "src/data/mapsnapshot.h"
+#include "src/data/marker.h"
+#include "src/data/markerpatch.h"
+#include "src/data/markertable.h"
+#include "src/data/persistentmarkermap.h"
+#include "src/data/stringpool.h"
+#include "src/widgets/markerlayeritem.h"
+
+namespace {
+
+const QList<int> kMarkerCounts = {1000, 10000, 100000};     ///< 标记数量规模
+const QList<int> kSnapshotCounts = {1000, 10000};           ///< 快照数量规模
+const QList<int> kRestoreSnapshotCounts = {1000, 10000, 100000};   ///< 随机回溯用例的快照数量规模
+const int kHistoryMarkers = 100;        ///< 快照历史用例中每个快照的初始标记数
+const int kMutationOps = 1000;          ///< 添加/删除用例的操作次数
+const QSize kViewportSize(1280, 800);   ///< 缩放用例的视口尺寸
+const QSizeF kMapSize(8000, 6000);      ///< 缩放用例的地图尺寸
+
+const QDateTime kBaseTime = QDateTime(QDate(2024, 9, 1), QTime(8, 0));
+
+/**
+ * @brief 生成确定的测试标记
+ *
+ * Marker::generateId() 以毫秒时间戳加随机数生成ID，批量生成时会重复，
+ * 这里通过 JSON 指定唯一ID。
+ */
+Marker makeMarker(int index, QRandomGenerator& random) {
+    static const QStringList colors = {"#e74c3c", "#3498db", "#2ecc71", "#f1c40f", "#9b59b6"};
+    QJsonObject json;
+    json["id"] = QString("bench-%1").arg(index);
+    json["x"] = random.generateDouble();
+    json["y"] = random.generateDouble();
+    json["note"] = QString("图书馆 %1 层 自习区 %2").arg(index % 7 + 1).arg(index);
+    json["color"] = colors[index % colors.size()];
+    json["createTime"] = kBaseTime.addSecs(index).toString(Qt::ISODate);
+    json["createdBy"] = QString("user%1").arg(index % 50);
+    return Marker::fromJson(json);
+}
+
+QList<Marker> makeMarkers(int count, int firstIndex = 0) {
+    QRandomGenerator random(quint32(count) * 7919u + quint32(firstIndex));
+    QList<Marker> markers;
+    markers.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        markers.append(makeMarker(firstIndex + i, random));
+    }
+    return markers;
+}
+
+/**
+ * @brief 生成快照历史：从 markerCount 个标记开始，每个快照新增、修改或删除一个标记
+ */
+QList<MapSnapshot> makeHistory(int snapshotCount, int markerCount) {
+    QRandomGenerator random(quint32(snapshotCount));
+    PersistentMarkerMap markers = PersistentMarkerMap::fromList(makeMarkers(markerCount));
+    int nextIndex = markerCount;
+
+    QList<MapSnapshot> snapshots;
+    snapshots.reserve(snapshotCount);
+    for (int i = 0; i < snapshotCount; ++i) {
+        const int action = random.bounded(3);
+        if (action == 0 || markers.isEmpty()) {
+            markers.insert(makeMarker(nextIndex++, random));
+        } else {
+            const int index = random.bounded(nextIndex);
+            const QString id = QString("bench-%1").arg(index);
+            if (action == 1 && markers.contains(id)) {
+                markers.insert(makeMarker(index, random));     // 同一ID，新的位置
+            } else {
+                markers.remove(id);
+            }
+        }
+        snapshots.append(MapSnapshot(kBaseTime.addSecs(60 * i), markers,
+                                     QString("快照 %1").arg(i)));
+    }
+    return snapshots;
+}
+
+MarkerManager* makeManager(int markerCount, QObject* parent) {
+    auto* manager = new MarkerManager(parent);
+    manager->loadFromSnapshots({MapSnapshot(kBaseTime, makeMarkers(markerCount), "初始数据")});
+    return manager;
+}
+
+// ========== 序列化 ==========
+
+void benchSerialization(BenchRunner& runner, int markerCount) {
+    const QString size = QString::number(markerCount);
+    const QList<Marker> markers = makeMarkers(markerCount);
+    const MapSnapshot snapshot(kBaseTime, markers, "bench");
+
+    runner.run("Marker/toJson/" + size, [&]() {
+        for (const Marker& marker : markers) {
+            doNotOptimize(marker.toJson());
+        }
+    });
+
+    QList<QJsonObject> markerJson;
+    markerJson.reserve(markerCount);
+    for (const Marker& marker : markers) {
+        markerJson.append(marker.toJson());
+    }
+    runner.run("Marker/fromJson/" + size, [&]() {
+        for (const QJsonObject& json : markerJson) {
+            doNotOptimize(Marker::fromJson(json));
+        }
+    });
+
+    runner.run("MapSnapshot/toJson/" + size, [&]() {
+        doNotOptimize(QJsonDocument(snapshot.toJson()).toJson(QJsonDocument::Compact));
+    });
+
+    const QByteArray snapshotJson = QJsonDocument(snapshot.toJson()).toJson(QJsonDocument::Compact);
+    runner.run("MapSnapshot/fromJson/" + size, [&]() {
+        doNotOptimize(MapSnapshot::fromJson(QJsonDocument::fromJson(snapshotJson).object()));
+    });
+
+    const QList<MapSnapshot> single = {snapshot};
+    runner.run("MapJsonCodec/write/" + size, [&]() {
+        doNotOptimize(MapJsonCodec::writeSnapshots(single, QJsonDocument::Compact));
+    });
+
+    const QByteArray arrayJson = MapJsonCodec::writeSnapshots(single, QJsonDocument::Compact);
+    runner.run("MapJsonCodec/read/" + size, [&]() {
+        QList<MapSnapshot> decoded;
+        MapJsonCodec::readSnapshots(arrayJson, &decoded);
+        doNotOptimize(decoded);
+    });
+}
+
+void benchHistorySerialization(BenchRunner& runner, int snapshotCount) {
+    const QString size = QString::number(snapshotCount);
+    const QList<MapSnapshot> history = makeHistory(snapshotCount, kHistoryMarkers);
+
+    runner.run("History/write/" + size, [&]() {
+        doNotOptimize(MapJsonCodec::writeSnapshots(history, QJsonDocument::Indented));
+    });
+
+    const QByteArray json = MapJsonCodec::writeSnapshots(history, QJsonDocument::Indented);
+    runner.run("History/read/" + size, [&]() {
+        QList<MapSnapshot> decoded;
+        MapJsonCodec::readSnapshots(json, &decoded);
+        doNotOptimize(decoded);
+    });
+}
+
+// ========== MarkerManager ==========
+
+void benchManager(BenchRunner& runner, int markerCount) {
+    const QString size = QString::number(markerCount);
+    QObject owner;
+
+    // 添加：每次迭代新增一个标记（并创建快照）
+    if (runner.shouldRun("MarkerManager/addMarker/" + size)) {
+        MarkerManager* manager = makeManager(markerCount, &owner);
+        const QList<Marker> extra = makeMarkers(kMutationOps, markerCount);
+        runner.runFixed("MarkerManager/addMarker/" + size, kMutationOps, [&](int i) {
+            manager->addMarker(extra[i], "bench");
+        });
+    }
+
+    // 批量添加：kMutationOps 次添加合并为一个快照
+    if (runner.shouldRun("MarkerManager/addMarkerBatch/" + size)) {
+        MarkerManager* manager = makeManager(markerCount, &owner);
+        const QList<Marker> extra = makeMarkers(kMutationOps, markerCount);
+        manager->beginBatch();
+        runner.runFixed("MarkerManager/addMarkerBatch/" + size, kMutationOps, [&](int i) {
+            manager->addMarker(extra[i], "bench");
+            if (i == kMutationOps - 1) {
+                manager->commitBatch();
+            }
+        });
+    }
+
+    // 删除：预先多放 kMutationOps 个标记，逐个删除
+    if (runner.shouldRun("MarkerManager/deleteMarker/" + size)) {
+        MarkerManager* manager = makeManager(markerCount + kMutationOps, &owner);
+        runner.runFixed("MarkerManager/deleteMarker/" + size, kMutationOps, [&](int i) {
+            manager->deleteMarker(QString("bench-%1").arg(markerCount + i), "bench");
+        });
+    }
+
+    // 移动：每次迭代拖动一个已有标记（历史中只记录坐标差值）
+    if (runner.shouldRun("MarkerManager/updateMarker/" + size)) {
+        MarkerManager* manager = makeManager(markerCount, &owner);
+        runner.runFixed("MarkerManager/updateMarker/" + size, kMutationOps, [&](int i) {
+            MarkerPatch patch;
+            patch.markerId = QString("bench-%1").arg(i % markerCount);
+            patch.fields = MarkerPatch::Position;
+            patch.position = QPointF((i % 1000) / 1000.0, 0.5);
+            manager->updateMarker(patch, "bench");
+        });
+    }
+
+    MarkerManager* manager = makeManager(markerCount, &owner);
+
+    runner.run("MarkerManager/currentMarkers/" + size, [&]() {
+        doNotOptimize(manager->currentMarkers());
+    });
+
+    QStringList ids;
+    QRandomGenerator random(42);
+    for (int i = 0; i < 1024; ++i) {
+        ids.append(QString("bench-%1").arg(random.bounded(markerCount)));
+    }
+    int next = 0;
+    runner.run("MarkerManager/findMarker/" + size, [&]() {
+        doNotOptimize(manager->findMarker(ids[next++ & 1023]));
+    });
+}
+
+void benchRestore(BenchRunner& runner, int snapshotCount) {
+    const QString name = "MarkerManager/restoreSnapshot/" + QString::number(snapshotCount);
+    if (!runner.shouldRun(name)) {
+        return;
+    }
+
+    MarkerManager manager;
+    manager.loadFromSnapshots(makeHistory(snapshotCount, 1000));
+
+    QRandomGenerator random(7);
+    runner.run(name, [&]() {
+        manager.restoreSnapshot(random.bounded(snapshotCount));
+    });
+}
+
+void benchMarkerLayer(BenchRunner& runner, int markerCount) {
+    const QString size = QString::number(markerCount);
+    const QString zoomName = "MarkerLayer/zoomFrame/" + size;
+    const QString hitName = "MarkerLayer/markerAt/" + size;
+    const QString setName = "MarkerLayer/setMarkers/" + size;
+    if (!runner.shouldRun(zoomName) && !runner.shouldRun(hitName) && !runner.shouldRun(setName)) {
+        return;
+    }
+
+    MarkerLayerItem layer;
+    layer.setMapSize(kMapSize);
+    layer.insert(makeMarkers(markerCount));
+
+    // 与 MapView 的滚轮缩放相同：每步 1.15 倍，从整图可见放大到 4 倍再缩回
+    QVector<qreal> zoomSteps;
+    const qreal fitScale = qMin(kViewportSize.width() / kMapSize.width(),
+                                kViewportSize.height() / kMapSize.height());
+    for (qreal zoom = fitScale; zoom < 4.0; zoom *= 1.15) {
+        zoomSteps.append(zoom);
+    }
+    for (int i = zoomSteps.size() - 2; i > 0; --i) {
+        zoomSteps.append(zoomSteps[i]);
+    }
+
+    // 视口中心固定在地图中心
+    auto viewTransform = [](qreal zoom) {
+        QTransform transform;
+        transform.translate(kViewportSize.width() / 2.0, kViewportSize.height() / 2.0);
+        transform.scale(zoom, zoom);
+        transform.translate(-kMapSize.width() / 2.0, -kMapSize.height() / 2.0);
+        return transform;
+    };
+
+    // 一次缩放 = 视图变换改变后重绘整个视口
+    QImage frame(kViewportSize, QImage::Format_ARGB32_Premultiplied);
+    int step = 0;
+    runner.run(zoomName, [&]() {
+        const QTransform transform = viewTransform(zoomSteps[step++ % zoomSteps.size()]);
+        frame.fill(Qt::white);
+
+        QPainter painter(&frame);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.setWorldTransform(transform);
+        QStyleOptionGraphicsItem option;
+        option.exposedRect = transform.inverted().mapRect(QRectF(QPointF(0, 0), QSizeF(kViewportSize)));
+        layer.paint(&painter, &option, nullptr);
+    });
+
+    QRandomGenerator random(11);
+    const QTransform transform = viewTransform(1.0);
+    runner.run(hitName, [&]() {
+        const QPointF scenePos(random.generateDouble() * kMapSize.width(),
+                               random.generateDouble() * kMapSize.height());
+        doNotOptimize(layer.markerAt(scenePos, transform));
+    });
+
+    // 相邻快照之间来回切换：1% 的标记被删除，另有同样多的新标记
+    const int changed = qMax(1, markerCount / 100);
+    const QList<Marker> before = makeMarkers(markerCount);
+    const QList<Marker> after = before.mid(0, markerCount - changed) + makeMarkers(changed, markerCount);
+    layer.setMarkers(before);
+    bool forward = true;
+    runner.run(setName, [&]() {
+        doNotOptimize(layer.setMarkers(forward ? after : before));
+        forward = !forward;
+    });
+}
+
+// ========== 正确性检查 ==========
+
+/**
+ * @brief 时区写法各不相同的时间：本地时间、UTC（"Z"）、固定偏移（"+08:00"）
+ */
+QList<QDateTime> zoneSamples() {
+    return {kBaseTime,
+            QDateTime::fromString("2024-09-01T08:00:00Z", Qt::ISODate),
+            QDateTime::fromString("2024-09-01T08:00:00+08:00", Qt::ISODate)};
+}
+
+bool check(bool condition, const QString& what) {
+    if (!condition) {
+        qCritical().noquote() << "Check failed:" << what;
+    }
+    return condition;
+}
+
+QByteArray jsonOf(const QJsonObject& json) {
+    return QJsonDocument(json).toJson(QJsonDocument::Compact);
+}
+
+/**
+ * @brief CBOR 和紧凑二进制的往返：时间的时区写法不变
+ */
+bool verifyCodecs() {
+    bool ok = true;
+    QRandomGenerator random(1);
+    for (const QDateTime& time : zoneSamples()) {
+        const QString zone = time.toString(Qt::ISODate);
+        QJsonObject json = makeMarker(0, random).toJson();
+        json["createTime"] = zone;
+        const Marker marker = Marker::fromJson(json);
+        const MapSnapshot snapshot(time, QList<Marker>{marker}, "zone");
+
+        Marker decoded;
+        ok &= check(DataSchema::fromCbor(DataSchema::toCbor(marker), &decoded)
+                    && jsonOf(decoded.toJson()) == jsonOf(marker.toJson()),
+                    "Marker CBOR round trip " + zone);
+        ok &= check(DataSchema::fromBinary(DataSchema::toBinary(marker), &decoded)
+                    && jsonOf(decoded.toJson()) == jsonOf(marker.toJson()),
+                    "Marker binary round trip " + zone);
+
+        MapSnapshot decodedSnapshot;
+        ok &= check(DataSchema::fromCbor(DataSchema::toCbor(snapshot), &decodedSnapshot)
+                    && jsonOf(decodedSnapshot.toJson()) == jsonOf(snapshot.toJson()),
+                    "MapSnapshot CBOR round trip " + zone);
+        ok &= check(DataSchema::fromBinary(DataSchema::toBinary(snapshot), &decodedSnapshot)
+                    && jsonOf(decodedSnapshot.toJson()) == jsonOf(snapshot.toJson()),
+                    "MapSnapshot binary round trip " + zone);
+    }
+    return ok;
+}
+
+/**
+ * @brief 历史页换出到临时文件再读回后，快照（元数据和标记）不变
+ */
+bool verifyHistorySpill() {
+    const QList<QDateTime> zones = zoneSamples();
+    QList<MapSnapshot> snapshots = makeHistory(2 * SnapshotHistory::kPageSize + 1, kHistoryMarkers);
+    for (int i = 0; i < snapshots.size(); ++i) {
+        const MapSnapshot& source = snapshots[i];
+        snapshots[i] = MapSnapshot(zones[i % zones.size()].addSecs(60 * i), source.markerMap(),
+                                   source.description());
+    }
+
+    // 预算为 0：除最后一页外都写入临时文件
+    SnapshotHistory history;
+    history.setPageBudget(0);
+    for (const MapSnapshot& snapshot : snapshots) {
+        history.append(snapshot);
+    }
+
+    // 常驻的只剩最后一页中的一个快照
+    bool ok = check(history.residentPageBytes() < 4096, "History pages spilled");
+    for (int i = 0; i < snapshots.size(); ++i) {
+        ok &= check(jsonOf(history.at(i).toJson()) == jsonOf(snapshots[i].toJson()),
+                    QString("History snapshot %1 after spill").arg(i));
+    }
+    return ok;
+}
+
+/**
+ * @brief 不再被任何集合或表引用的字符串会被字符串池回收
+ */
+bool verifyStringReclaim() {
+    StringPool& strings = StringPool::markerStrings();
+    const QString note = QStringLiteral("verify-reclaim-note");
+    QRandomGenerator random(2);
+
+    // 两次回收：刚驻留的字符串会保留到下一次回收之后
+    auto reclaim = [&strings]() {
+        strings.collect();
+        strings.collect();
+    };
+
+    bool ok = true;
+    {
+        Marker marker = makeMarker(0, random);
+        marker.setNote(note);
+        PersistentMarkerMap markers;
+        markers.insert(marker);
+        const MarkerTable table = MarkerTable::fromMap(markers);
+        markers = PersistentMarkerMap();
+
+        reclaim();
+        ok &= check(strings.indexOf(note) >= 0 && table.marker(0).note() == note,
+                    "String kept while a table row holds it");
+    }
+    reclaim();
+    ok &= check(strings.indexOf(note) < 0, "String reclaimed after its holders are gone");
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    // 标记图层的聚合气泡需要绘制文字（字体需要 QGuiApplication），不需要显示器
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QGuiApplication app(argc, argv);
+    app.setApplicationName("LibraryMapBench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("数据层、核心层和标记图层的基准测试");
+    parser.addHelpOption();
+
+    QCommandLineOption filterOption(QStringList() << "f" << "filter",
+                                    "只运行名称匹配正则表达式的用例", "regex");
+    QCommandLineOption outputOption(QStringList() << "o" << "out",
+                                    "将结果导出为 JSON 文件", "file");
+    QCommandLineOption minTimeOption(QStringList() << "min-time",
+                                     "每个用例的最少累计耗时（毫秒）", "ms", "200");
+    QCommandLineOption quickOption(QStringList() << "quick",
+                                   "只运行最小规模（1k 标记 / 1k 快照）");
+    QCommandLineOption verifyOption(QStringList() << "verify",
+                                    "只运行编解码往返等正确性检查，失败时返回非零");
+    parser.addOption(filterOption);
+    parser.addOption(outputOption);
+    parser.addOption(minTimeOption);
+    parser.addOption(quickOption);
+    parser.addOption(verifyOption);
+    parser.process(app);
+
+    if (parser.isSet(verifyOption)) {
+        QLoggingCategory::setFilterRules("default.debug=false");
+        const bool codecs = verifyCodecs();
+        const bool history = verifyHistorySpill();
+        const bool ok = verifyStringReclaim() && codecs && history;
+        qInfo().noquote() << (ok ? "All checks passed" : "Some checks failed");
+        return ok ? 0 : 1;
+    }
+
+    // 核心层每次操作都会输出调试日志，测量时关闭
+    QLoggingCategory::setFilterRules("default.debug=false");
+
+    BenchRunner::Options options;
+    options.filter = QRegularExpression(parser.value(filterOption));
+    options.minTimeMs = parser.value(minTimeOption).toDouble();
+    options.quick = parser.isSet(quickOption);
+    BenchRunner runner(options);
+
+    const QList<int> markerCounts = options.quick ? kMarkerCounts.mid(0, 1) : kMarkerCounts;
+    const QList<int> snapshotCounts = options.quick ? kSnapshotCounts.mid(0, 1) : kSnapshotCounts;
+    const QList<int> restoreCounts = options.quick ? kRestoreSnapshotCounts.mid(0, 1)
+                                                   : kRestoreSnapshotCounts;
+
+    for (int count : markerCounts) {
+        benchSerialization(runner, count);
+    }
+    for (int count : snapshotCounts) {
+        benchHistorySerialization(runner, count);
+    }
+    for (int count : markerCounts) {
+        benchManager(runner, count);
+    }
+    for (int count : restoreCounts) {
+        benchRestore(runner, count);
+    }
+    for (int count : markerCounts) {
+        benchMarkerLayer(runner, count);
+    }
+
+    if (parser.isSet(outputOption) && !runner.writeJson(parser.value(outputOption))) {
+        return 1;
+    }
+    return 0;
+}
@@ -3,8 +3,8 @@
 #include <QTextEdit>
 #include <QGroupBox>
 #include <QDir>
+#include <QFile>
 #include <QDebug>
-#include <QImageReader>
 
 MainWindow::MainWindow(QWidget* parent)
     : QMainWindow(parent)
@@ -15,12 +15,15 @@ MainWindow::MainWindow(QWidget* parent)
     , m_markerManager(nullptr)
     , m_apiClient(nullptr)
 {
+    m_startupTimer.start();
+
     // 创建业务逻辑组件
     m_markerManager = new MarkerManager(this);
     m_apiClient = new ApiClient(this);
 
     // 初始化UI（必须在连接信号之前）
     setupUi();
+    logStartupPhase("setupUi");
 
     // 设置窗口属性
     setWindowTitle("NPU 虚拟校园地图 - 交互系统");
@@ -34,26 +37,37 @@ MainWindow::MainWindow(QWidget* parent)
                 this, &MainWindow::onRestoreLatestClicked);
     }
 
-    connect(m_markerManager, &MarkerManager::markersChanged,
-            this, &MainWindow::onMarkersChanged);
+    // 地图只处理受影响的标记
+    connect(m_markerManager, &MarkerManager::markersRemoved,
+            m_mapView, &MapView::removeMarkers);
+    connect(m_markerManager, &MarkerManager::markersUpdated,
+            m_mapView, &MapView::updateMarkers);
+    connect(m_markerManager, &MarkerManager::markersAdded,
+            m_mapView, &MapView::addMarkers);
     connect(m_markerManager, &MarkerManager::currentSnapshotChanged,
             [this](int index, const MapSnapshot& snapshot) {
                 if (m_timelineWidget) {
-                    m_timelineWidget->setCurrentIndex(index);
+                    m_timelineWidget->setSnapshotCount(m_markerManager->snapshotCount());
+                    m_timelineWidget->setCurrentSnapshot(index, snapshot);
                 }
             });
 
     connect(m_apiClient, &ApiClient::snapshotsFetched,
             this, &MainWindow::onSnapshotsFetched);
+    connect(m_markerManager, &MarkerManager::historyLoaded,
+            this, &MainWindow::onHistoryLoaded);
     connect(m_apiClient, &ApiClient::errorOccurred,
             this, &MainWindow::onNetworkError);
+    connect(m_apiClient, &ApiClient::markerHistoryFetched,
+            this, &MainWindow::onMarkerHistoryFetched);
 
     // 初始化时间轴（空状态）
     if (m_timelineWidget) {
-        m_timelineWidget->setSnapshots(m_markerManager->snapshots());
+        m_timelineWidget->setSnapshotCount(m_markerManager->snapshotCount());
     }
 
     qDebug() << "MainWindow initialized";
+    logStartupPhase("constructed");
 }
 
 void MainWindow::setupUi() {
@@ -73,26 +87,28 @@ void MainWindow::setupUi() {
     m_mapView = new MapView(this);
     mainLayout->addWidget(m_mapView, 1);  // stretch=1 占据剩余空间
 
-    // 增加 QImage 分配限制（默认 256MB，图片较大时需要）
-    QImageReader::setAllocationLimit(512);  // 设置为 512MB
-
-    // 加载地图图片（如果存在）
-    QPixmap mapPixmap("map.jpg");
-    qDebug() << "Loading map.jpg, isNull:" << mapPixmap.isNull()
-             << "size:" << mapPixmap.size();
-    if (!mapPixmap.isNull()) {
-        m_mapView->setMapPixmap(mapPixmap);
-        qDebug() << "Map loaded successfully";
-    } else {
-        qDebug() << "Failed to load map.jpg - file not found or invalid format";
-        qDebug() << "Current working dir:" << QDir::currentPath();
-    }
+    // 首帧和地图各阶段的耗时
+    m_mapView->viewport()->installEventFilter(this);
+    connect(m_mapView, &MapView::mapPreviewReady, this, [this]() {
+        logStartupPhase("map preview");
+    });
+    connect(m_mapView, &MapView::mapTilesReady, this, [this]() {
+        if (!m_mapTilesLogged) {
+            m_mapTilesLogged = true;
+            logStartupPhase("map full resolution");
+        }
+    });
+    loadMap();
 
     // 连接地图视图信号
     connect(m_mapView, &MapView::addMarkerRequested,
             this, &MainWindow::onAddMarkerRequested);
     connect(m_mapView, &MapView::deleteMarkerRequested,
             this, &MainWindow::onDeleteMarkerRequested);
+    connect(m_mapView, &MapView::markerMoveRequested,
+            this, &MainWindow::onMarkerMoveRequested);
+    connect(m_mapView, &MapView::markerHistoryRequested,
+            m_apiClient, &ApiClient::fetchMarkerHistory);
 
     // ========== 底部时间轴（停靠窗口） ==========
     QDockWidget* timelineDock = new QDockWidget("历史时间轴", this);
@@ -104,6 +120,34 @@ void MainWindow::setupUi() {
     addDockWidget(Qt::BottomDockWidgetArea, timelineDock);
 }
 
+void MainWindow::loadMap() {
+    // 优先使用预先切好的瓦片归档，否则从图片分块按需解码；
+    // 这里只读取文件头，预览和瓦片都在后台线程中解码
+    if (QFile::exists("map.tiles") && m_mapView->setMapTileArchive("map.tiles")) {
+        qDebug() << "Map tile archive loaded successfully";
+    } else if (m_mapView->setMapImageFile("map.jpg")) {
+        qDebug() << "Map loaded successfully";
+    } else {
+        qDebug() << "Failed to load map.jpg - file not found or invalid format";
+        qDebug() << "Current working dir:" << QDir::currentPath();
+    }
+    logStartupPhase("map opened");
+}
+
+void MainWindow::logStartupPhase(const char* phase) {
+    qDebug() << "Startup:" << phase << "at" << m_startupTimer.elapsed() << "ms";
+}
+
+bool MainWindow::eventFilter(QObject* watched, QEvent* event) {
+    if (!m_firstFrameLogged && event->type() == QEvent::Paint
+        && watched == m_mapView->viewport()) {
+        m_firstFrameLogged = true;
+        m_mapView->viewport()->removeEventFilter(this);
+        logStartupPhase("first frame");
+    }
+    return QMainWindow::eventFilter(watched, event);
+}
+
 QWidget* MainWindow::createControlPanel() {
     QWidget* panel = new QWidget();
     QVBoxLayout* layout = new QVBoxLayout(panel);
@@ -167,10 +211,17 @@ QWidget* MainWindow::createControlPanel() {
     layout->addWidget(statusGroup);
 
     // 连接标记管理器信号，更新状态显示
-    connect(m_markerManager, &MarkerManager::markersChanged, this, [this, markerCountLabel, snapshotLabel]() {
-        markerCountLabel->setText(QString("标记数: %1").arg(m_markerManager->currentMarkers().size()));
+    // 标记数只在新增/移除时变化，快照数在创建或切换（含同步后加载）时更新，都是 O(1)
+    auto updateMarkerCount = [this, markerCountLabel]() {
+        markerCountLabel->setText(QString("标记数: %1").arg(m_markerManager->currentMarkerCount()));
+    };
+    auto updateSnapshotCount = [this, snapshotLabel]() {
         snapshotLabel->setText(QString("快照数: %1").arg(m_markerManager->snapshotCount()));
-    });
+    };
+    connect(m_markerManager, &MarkerManager::markersAdded, this, updateMarkerCount);
+    connect(m_markerManager, &MarkerManager::markersRemoved, this, updateMarkerCount);
+    connect(m_markerManager, &MarkerManager::snapshotCreated, this, updateSnapshotCount);
+    connect(m_markerManager, &MarkerManager::currentSnapshotChanged, this, updateSnapshotCount);
 
     // ========== 弹性空间 ==========
     layout->addStretch();
@@ -186,6 +237,7 @@ QWidget* MainWindow::createControlPanel() {
         "<li><b>添加标记:</b> 点击按钮后选择地图位置</li>"
         "<li><b>查看备注:</b> 右键点击标记查看</li>"
         "<li><b>删除标记:</b> 右键点击标记选择删除</li>"
+        "<li><b>移动标记:</b> 左键拖动标记</li>"
         "<li><b>时间回溯:</b> 使用底部时间轴滑块</li>"
         "<li><b>缩放地图:</b> 鼠标滚轮</li>"
         "<li><b>拖拽地图:</b> 鼠标左键拖拽</li>"
@@ -235,12 +287,9 @@ void MainWindow::onAddMarkerRequested(const QPointF& normalizedPos) {
         // 添加标记到管理器
         m_markerManager->addMarker(marker, "当前用户");
 
-        // 同时发送到服务器
+        // 同时发送到服务器（地图通过 markersAdded 显示新标记）
         m_apiClient->addMarker(marker);
 
-        // 在地图上显示
-        m_mapView->addMarker(marker);
-
         QMessageBox::information(this, "成功", "标记已添加");
     }
 }
@@ -248,16 +297,25 @@ void MainWindow::onAddMarkerRequested(const QPointF& normalizedPos) {
 void MainWindow::onDeleteMarkerRequested(const QString& markerId) {
     // 从管理器中删除
     if (m_markerManager->deleteMarker(markerId, "当前用户")) {
-        // 从地图上移除
-        m_mapView->removeMarker(markerId);
-
-        // 发送到服务器
+        // 发送到服务器（地图通过 markersRemoved 移除标记）
         m_apiClient->deleteMarker(markerId);
 
         QMessageBox::information(this, "成功", "标记已删除");
     }
 }
 
+void MainWindow::onMarkerMoveRequested(const QString& markerId, const QPointF& normalizedPos) {
+    MarkerPatch patch;
+    patch.markerId = markerId;
+    patch.fields = MarkerPatch::Position;
+    patch.position = normalizedPos;
+
+    // 历史中只记录新坐标，请求也只发送 x / y（地图通过 markersUpdated 更新位置）
+    if (m_markerManager->updateMarker(patch, "当前用户")) {
+        m_apiClient->updateMarker(patch);
+    }
+}
+
 Marker MainWindow::showAddMarkerDialog(const QPointF& normalizedPos) {
     // 输入备注信息
     bool ok;
@@ -287,8 +345,8 @@ Marker MainWindow::showAddMarkerDialog(const QPointF& normalizedPos) {
 }
 
 void MainWindow::onTimelineIndexChanged(int index) {
-    // 切换到指定快照
-    m_markerManager->restoreSnapshot(index);
+    // 切换到指定快照（后台重建，拖动时只发布最后的位置）
+    m_markerManager->requestSnapshot(index);
 }
 
 void MainWindow::onRestoreLatestClicked() {
@@ -296,12 +354,6 @@ void MainWindow::onRestoreLatestClicked() {
     m_markerManager->restoreLatestSnapshot();
 }
 
-void MainWindow::onMarkersChanged(const QList<Marker>& markers) {
-    // 更新地图显示
-    m_mapView->clearMarkers();
-    m_mapView->addMarkers(markers);
-}
-
 void MainWindow::onSyncFromServer() {
     m_syncButton->setEnabled(false);
     m_syncButton->setText("同步中...");
@@ -316,14 +368,16 @@ void MainWindow::onSyncFromServer() {
 }
 
 void MainWindow::onSnapshotsFetched(const QList<MapSnapshot>& snapshots) {
-    // 加载快照到管理器
-    m_markerManager->loadFromSnapshots(snapshots);
+    // 加载快照到管理器（在工作线程中计算增量，完成后触发 historyLoaded）
+    m_markerManager->loadFromSnapshotsAsync(snapshots);
+}
 
-    // 更新时间轴
-    m_timelineWidget->setSnapshots(snapshots);
+void MainWindow::onHistoryLoaded(int snapshotCount) {
+    // 更新时间轴（当前快照的摘要由 currentSnapshotChanged 更新）
+    m_timelineWidget->setSnapshotCount(snapshotCount);
 
     QMessageBox::information(this, "同步成功",
-                             QString("已同步 %1 个快照").arg(snapshots.size()));
+                             QString("已同步 %1 个快照").arg(snapshotCount));
 }
 
 void MainWindow::onNetworkError(const QString& error) {
@@ -333,3 +387,28 @@ void MainWindow::onNetworkError(const QString& error) {
     m_syncButton->setEnabled(true);
     m_syncButton->setText("从服务器同步");
 }
+
+void MainWindow::onMarkerHistoryFetched(const QString& markerId, const QList<MarkerEvent>& events) {
+    if (events.isEmpty()) {
+        QMessageBox::information(this, "标记历史", QString("标记 %1 没有历史记录").arg(markerId));
+        return;
+    }
+
+    QStringList lines;
+    for (const MarkerEvent& event : events) {
+        QString action;
+        switch (event.type) {
+            case MarkerEvent::Added: action = "添加"; break;
+            case MarkerEvent::Updated: action = "修改"; break;
+            case MarkerEvent::Deleted: action = "删除"; break;
+        }
+        QString line = QString("%1  %2  %3")
+            .arg(event.timestamp.toString("yyyy-MM-dd HH:mm:ss"), action, event.marker.note());
+        if (!event.operatorName.isEmpty()) {
+            line += QString(" (操作者: %1)").arg(event.operatorName);
+        }
+        lines.append(line);
+    }
+
+    QMessageBox::information(this, "标记历史", lines.join("\n"));
+}
@@ -9,6 +9,7 @@
 #include <QColorDialog>
 #include <QMessageBox>
 #include <QDockWidget>
+#include <QElapsedTimer>
 
 #include "src/widgets/mapview.h"
 #include "src/widgets/timelinewidget.h"
@@ -52,6 +53,13 @@ private slots:
      */
     void onDeleteMarkerRequested(const QString& markerId);
 
+    /**
+     * @brief 处理拖动标记
+     * @param markerId 标记ID
+     * @param normalizedPos 新的归一化坐标
+     */
+    void onMarkerMoveRequested(const QString& markerId, const QPointF& normalizedPos);
+
     /**
      * @brief 处理添加标记按钮点击
      */
@@ -68,12 +76,6 @@ private slots:
      */
     void onRestoreLatestClicked();
 
-    /**
-     * @brief 处理标记列表变化
-     * @param markers 新的标记列表
-     */
-    void onMarkersChanged(const QList<Marker>& markers);
-
     /**
      * @brief 处理从服务器同步数据
      */
@@ -85,18 +87,48 @@ private slots:
      */
     void onSnapshotsFetched(const QList<MapSnapshot>& snapshots);
 
+    /**
+     * @brief 处理历史加载完成
+     * @param snapshotCount 快照数量
+     */
+    void onHistoryLoaded(int snapshotCount);
+
     /**
      * @brief 处理网络错误
      * @param error 错误信息
      */
     void onNetworkError(const QString& error);
 
+    /**
+     * @brief 处理标记历史获取成功
+     * @param markerId 标记ID
+     * @param events 事件列表
+     */
+    void onMarkerHistoryFetched(const QString& markerId, const QList<MarkerEvent>& events);
+
+protected:
+    /**
+     * @brief 记录地图视图的第一次绘制（启动耗时）
+     */
+    bool eventFilter(QObject* watched, QEvent* event) override;
+
 private:
     /**
      * @brief 初始化UI
      */
     void setupUi();
 
+    /**
+     * @brief 加载地图（只读取文件头，瓦片在后台解码）
+     */
+    void loadMap();
+
+    /**
+     * @brief 输出启动阶段的耗时（从构造开始计时）
+     * @param phase 阶段名称
+     */
+    void logStartupPhase(const char* phase);
+
     /**
      * @brief 创建控制面板
      * @return 控制面板widget
@@ -120,6 +152,11 @@ private:
     // 业务逻辑组件
     MarkerManager* m_markerManager;     ///< 标记管理器
     ApiClient* m_apiClient;             ///< API客户端
+
+    // 启动计时
+    QElapsedTimer m_startupTimer;       ///< 从构造开始的计时
+    bool m_firstFrameLogged = false;    ///< 是否已记录首帧
+    bool m_mapTilesLogged = false;      ///< 是否已记录地图完整显示
 };
 
 #endif // MAINWINDOW_H
@@ -4,31 +4,43 @@ MarkerManager::MarkerManager(QObject* parent)
     : QObject(parent)
     , m_currentSnapshotIndex(-1)  // -1 表示没有快照
 {
+    // 历史只在这个线程池中访问；单线程保证任务按提交顺序执行，不需要加锁
+    m_worker.setMaxThreadCount(1);
+}
+
+MarkerManager::~MarkerManager() {
+    // 丢弃尚未开始的任务，等待正在执行的任务结束（它们会访问 m_history）
+    m_restoreGeneration.fetchAndAddOrdered(1);
+    m_loadGeneration.fetchAndAddOrdered(1);
+    m_worker.clear();
+    m_worker.waitForDone();
 }
 
 bool MarkerManager::addMarker(const Marker& marker, const QString& createdBy) {
+    if (isLoading()) {
+        qWarning() << "Cannot add marker: history is loading.";
+        return false;
+    }
+
     // 检查是否处于历史视图模式
-    if (m_currentSnapshotIndex >= 0 && m_currentSnapshotIndex < m_snapshots.size() - 1) {
+    if (m_currentSnapshotIndex >= 0 && m_currentSnapshotIndex < m_snapshotCount - 1) {
         qWarning() << "Cannot add marker: currently viewing historical snapshot."
                    << "Please restore to latest first.";
         return false;
     }
 
-    // 如果有历史快照，确保我们在最新的快照基础上操作
-    if (!m_snapshots.isEmpty()) {
-        // 确保在最新快照上操作
-        restoreLatestSnapshot();
-    }
+    // 确保在最新快照上操作（批量操作中当前集合已是最新状态加暂存的修改）
+    ensureLatestSnapshot();
 
-    // 添加标记到当前标记列表
-    m_currentMarkers[marker.id()] = marker;
+    // 添加标记到当前标记集合（只复制受影响的路径）
+    m_currentMarkers.insert(marker);
 
     // 创建新快照记录此次添加
     QString description = QString("添加标记: %1").arg(marker.note().left(20));
     if (!createdBy.isEmpty()) {
         description += QString(" (操作者: %1)").arg(createdBy);
     }
-    createSnapshot(description);
+    recordChange(description);
 
     qDebug() << "Marker added:" << marker.id() << "Total markers:" << m_currentMarkers.size();
 
@@ -36,6 +48,11 @@ bool MarkerManager::addMarker(const Marker& marker, const QString& createdBy) {
 }
 
 bool MarkerManager::deleteMarker(const QString& markerId, const QString& deletedBy) {
+    if (isLoading()) {
+        qWarning() << "Cannot delete marker: history is loading.";
+        return false;
+    }
+
     // 检查标记是否存在
     if (!m_currentMarkers.contains(markerId)) {
         qWarning() << "Cannot delete marker: not found" << markerId;
@@ -43,19 +60,17 @@ bool MarkerManager::deleteMarker(const QString& markerId, const QString& deleted
     }
 
     // 检查是否处于历史视图模式
-    if (m_currentSnapshotIndex >= 0 && m_currentSnapshotIndex < m_snapshots.size() - 1) {
+    if (m_currentSnapshotIndex >= 0 && m_currentSnapshotIndex < m_snapshotCount - 1) {
         qWarning() << "Cannot delete marker: currently viewing historical snapshot."
                    << "Please restore to latest first.";
         return false;
     }
 
     // 确保在最新快照上操作
-    if (!m_snapshots.isEmpty()) {
-        restoreLatestSnapshot();
-    }
+    ensureLatestSnapshot();
 
     // 获取标记信息用于日志
-    Marker marker = m_currentMarkers[markerId];
+    Marker marker = m_currentMarkers.value(markerId);
 
     // 从当前标记列表中移除
     m_currentMarkers.remove(markerId);
@@ -65,36 +80,134 @@ bool MarkerManager::deleteMarker(const QString& markerId, const QString& deleted
     if (!deletedBy.isEmpty()) {
         description += QString(" (操作者: %1)").arg(deletedBy);
     }
-    createSnapshot(description);
+    recordChange(description);
 
     qDebug() << "Marker deleted:" << markerId << "Total markers:" << m_currentMarkers.size();
 
     return true;
 }
 
-QList<Marker> MarkerManager::currentMarkers() const {
-    // 如果有快照且当前在查看某个快照，返回快照中的标记
-    if (m_currentSnapshotIndex >= 0 && m_currentSnapshotIndex < m_snapshots.size()) {
-        return m_snapshots[m_currentSnapshotIndex].markers();
+bool MarkerManager::updateMarker(const MarkerPatch& patch, const QString& updatedBy) {
+    if (isLoading()) {
+        qWarning() << "Cannot update marker: history is loading.";
+        return false;
     }
 
-    // 否则返回当前内存中的标记
-    return m_currentMarkers.values();
+    // 检查标记是否存在
+    if (!m_currentMarkers.contains(patch.markerId)) {
+        qWarning() << "Cannot update marker: not found" << patch.markerId;
+        return false;
+    }
+
+    // 检查是否处于历史视图模式
+    if (m_currentSnapshotIndex >= 0 && m_currentSnapshotIndex < m_snapshotCount - 1) {
+        qWarning() << "Cannot update marker: currently viewing historical snapshot."
+                   << "Please restore to latest first.";
+        return false;
+    }
+
+    // 确保在最新快照上操作
+    ensureLatestSnapshot();
+
+    // 只保留实际变化的字段（例如拖动后又放回原处）
+    const Marker before = m_currentMarkers.value(patch.markerId);
+    const Marker after = patch.applyTo(before);
+    const MarkerPatch changes = MarkerPatch::between(before, after);
+    if (changes.isEmpty()) {
+        return false;
+    }
+
+    m_currentMarkers.insert(after);
+
+    // 创建新快照记录此次修改
+    QString description = changes.describe(after.note());
+    if (!updatedBy.isEmpty()) {
+        description += QString(" (操作者: %1)").arg(updatedBy);
+    }
+    recordChange(description);
+
+    qDebug() << "Marker updated:" << patch.markerId << "fields:" << int(changes.fields);
+
+    return true;
 }
 
-Marker MarkerManager::findMarker(const QString& markerId) const {
-    // 先在当前标记中查找
-    if (m_currentMarkers.contains(markerId)) {
-        return m_currentMarkers[markerId];
+void MarkerManager::beginBatch() {
+    // 历史视图中的增删仍会被拒绝，这里不切换快照
+    if (m_batchDepth++ > 0) {
+        return;
     }
+    m_batchChanges = 0;
+    m_batchDescription.clear();
+}
 
-    // 如果没找到，在当前快照的标记中查找
-    if (m_currentSnapshotIndex >= 0 && m_currentSnapshotIndex < m_snapshots.size()) {
-        for (const Marker& marker : m_snapshots[m_currentSnapshotIndex].markers()) {
-            if (marker.id() == markerId) {
-                return marker;
-            }
-        }
+void MarkerManager::commitBatch(const QString& description) {
+    if (m_batchDepth == 0) {
+        qWarning() << "commitBatch() called without beginBatch()";
+        return;
+    }
+    if (--m_batchDepth > 0) {
+        return;
+    }
+
+    const int operations = m_batchChanges;
+    m_batchChanges = 0;
+
+    // 按净变化判断：批量中相互抵消的操作（如先添加再删除）不生成快照
+    if (operations == 0 || m_currentMarkers.isSharedWith(m_latestSnapshot.markerMap())) {
+        m_batchDescription.clear();
+        return;
+    }
+    const int changes = PersistentMarkerMap::diff(m_latestSnapshot.markerMap(), m_currentMarkers).changeCount();
+    if (changes == 0) {
+        m_batchDescription.clear();
+        return;
+    }
+
+    QString snapshotDescription = description;
+    if (snapshotDescription.isEmpty()) {
+        snapshotDescription = operations == 1 ? m_batchDescription
+                                              : QString("批量操作: %1 项修改").arg(changes);
+    }
+    m_batchDescription.clear();
+    createSnapshot(snapshotDescription);
+
+    qDebug() << "Batch committed:" << changes << "changes" << "Total markers:" << m_currentMarkers.size();
+}
+
+void MarkerManager::ensureLatestSnapshot() {
+    if (m_snapshotCount == 0 || isInBatch()) {
+        return;
+    }
+
+    // 已在最新快照上，且没有尚未发布的回溯请求
+    const int latest = m_snapshotCount - 1;
+    if (m_currentSnapshotIndex == latest && m_requestedIndex == latest) {
+        return;
+    }
+    restoreLatestSnapshot();
+}
+
+void MarkerManager::recordChange(const QString& description) {
+    // 当前标记集合已经改变，尚未发布的回溯结果不再适用
+    cancelPendingRestore();
+
+    if (isInBatch()) {
+        ++m_batchChanges;
+        m_batchDescription = description;
+        return;
+    }
+    createSnapshot(description);
+}
+
+QList<Marker> MarkerManager::currentMarkers() const {
+    // 当前标记集合始终与正在查看的快照一致
+    return m_currentMarkers.values();
+}
+
+Marker MarkerManager::findMarker(const QString& markerId) const {
+    // 当前标记集合始终与正在查看的快照一致
+    if (const CompactMarker* marker = m_currentMarkers.find(markerId)) {
+        return marker->toMarker();
     }
 
     // 没找到，返回无效标记
@@ -102,73 +215,298 @@ Marker MarkerManager::findMarker(const QString& markerId) const {
 }
 
 bool MarkerManager::restoreSnapshot(int index) {
-    if (index < 0 || index >= m_snapshots.size()) {
-        qWarning() << "Invalid snapshot index:" << index;
+    if (!canRestore(index)) {
         return false;
     }
 
-    m_currentSnapshotIndex = index;
-    const MapSnapshot& snapshot = m_snapshots[index];
+    cancelPendingRestore();
+    const int direction = m_requestedIndex >= 0 ? index - m_requestedIndex : 0;
+    m_requestedIndex = index;
+
+    MapSnapshot snapshot = m_latestSnapshot;
+    if (index != m_snapshotCount - 1) {
+        // 最近的关键帧 + 有限的增量重放（在工作线程中执行，排在之前提交的追加之后）
+        snapshot = runOnWorker([this, index, direction]() {
+            const MapSnapshot restored = m_history.at(index);
+            m_history.prefetch(index, direction);
+            return restored;
+        });
+    }
+
+    // 与当前显示状态比较，跳过共享的子树，代价与变化量成正比
+    applySnapshot(index, snapshot, PersistentMarkerMap::diff(m_currentMarkers, snapshot.markerMap()));
+    return true;
+}
 
-    // 更新当前标记列表
-    m_currentMarkers.clear();
-    for (const Marker& marker : snapshot.markers()) {
-        m_currentMarkers[marker.id()] = marker;
+bool MarkerManager::requestSnapshot(int index) {
+    if (!canRestore(index)) {
+        return false;
     }
 
-    qDebug() << "Restored snapshot:" << snapshot.snapshotId()
-             << "at" << snapshot.timestamp();
+    const quint64 generation = cancelPendingRestore();
+    const int direction = m_requestedIndex >= 0 ? index - m_requestedIndex : 0;
+    m_requestedIndex = index;
 
-    emit currentSnapshotChanged(index, snapshot);
-    emit markersChanged(snapshot.markers());
+    if (index == m_snapshotCount - 1) {
+        // 最新快照常驻界面线程
+        applySnapshot(index, m_latestSnapshot,
+                      PersistentMarkerMap::diff(m_currentMarkers, m_latestSnapshot.markerMap()));
+        return true;
+    }
+
+    const PersistentMarkerMap base = m_currentMarkers;
+    m_worker.start([this, generation, index, direction, base]() {
+        // 开始前已有更新的请求：直接跳过
+        if (m_restoreGeneration.loadAcquire() != generation) {
+            return;
+        }
+
+        const MapSnapshot snapshot = m_history.at(index);
+        m_history.prefetch(index, direction);
+        if (m_restoreGeneration.loadAcquire() != generation) {
+            return;
+        }
 
+        // 差异也在工作线程中计算，界面线程只发布结果
+        const MarkerDiff diff = PersistentMarkerMap::diff(base, snapshot.markerMap());
+        QMetaObject::invokeMethod(this, [this, generation, index, snapshot, base, diff]() {
+            finishRequest(generation, index, snapshot, base, diff);
+        }, Qt::QueuedConnection);
+    });
     return true;
 }
 
+void MarkerManager::finishRequest(quint64 generation, int index, const MapSnapshot& snapshot,
+                                  const PersistentMarkerMap& base, const MarkerDiff& diff) {
+    // 等待期间有更新的请求或修改
+    if (m_restoreGeneration.loadAcquire() != generation) {
+        return;
+    }
+
+    if (m_currentMarkers.isSharedWith(base)) {
+        applySnapshot(index, snapshot, diff);
+    } else {
+        applySnapshot(index, snapshot, PersistentMarkerMap::diff(m_currentMarkers, snapshot.markerMap()));
+    }
+}
+
 void MarkerManager::restoreLatestSnapshot() {
-    if (m_snapshots.isEmpty()) {
+    if (m_snapshotCount == 0) {
         return;
     }
 
-    restoreSnapshot(m_snapshots.size() - 1);
+    restoreSnapshot(m_snapshotCount - 1);
+}
+
+bool MarkerManager::canRestore(int index) const {
+    if (index < 0 || index >= m_snapshotCount) {
+        qWarning() << "Invalid snapshot index:" << index;
+        return false;
+    }
+
+    // 切换会丢弃批量操作中暂存的修改
+    if (isInBatch()) {
+        qWarning() << "Cannot restore snapshot: a batch is in progress.";
+        return false;
+    }
+
+    if (isLoading()) {
+        qWarning() << "Cannot restore snapshot: history is loading.";
+        return false;
+    }
+    return true;
+}
+
+quint64 MarkerManager::cancelPendingRestore() {
+    return m_restoreGeneration.fetchAndAddOrdered(1) + 1;
+}
+
+void MarkerManager::applySnapshot(int index, const MapSnapshot& snapshot, const MarkerDiff& diff) {
+    m_currentSnapshotIndex = index;
+
+    // 更新当前标记集合（与快照共享结构，O(1)）
+    m_currentMarkers = snapshot.markerMap();
+
+    qDebug() << "Restored snapshot:" << snapshot.snapshotId()
+             << "at" << snapshot.timestamp() << "changes:" << diff.changeCount();
+
+    emit currentSnapshotChanged(index, snapshot);
+    emitMarkerChanges(diff);
 }
 
 void MarkerManager::createSnapshot(const QString& description) {
+    // 变化前显示的是最新快照（增删操作前都会先回到最新状态），与之比较得到本次变化
+    const MarkerDiff diff = PersistentMarkerMap::diff(m_latestSnapshot.markerMap(), m_currentMarkers);
+
     MapSnapshot snapshot = createSnapshotInternal(description);
-    m_snapshots.append(snapshot);
-    m_currentSnapshotIndex = m_snapshots.size() - 1;
+    cancelPendingRestore();
+    m_latestSnapshot = snapshot;
+    ++m_snapshotCount;
+    m_currentSnapshotIndex = m_snapshotCount - 1;
+    m_requestedIndex = m_currentSnapshotIndex;
 
-    // 更新当前标记列表到最新状态
-    m_currentMarkers.clear();
-    for (const Marker& marker : snapshot.markers()) {
-        m_currentMarkers[marker.id()] = marker;
-    }
+    // 计算并保存增量在工作线程中进行
+    m_worker.start([this, snapshot]() {
+        m_history.append(snapshot);
+    });
 
     emit snapshotCreated(snapshot);
     emit currentSnapshotChanged(m_currentSnapshotIndex, snapshot);
-    emit markersChanged(snapshot.markers());
+    emitMarkerChanges(diff);
+}
+
+void MarkerManager::emitMarkerChanges(const MarkerDiff& diff) {
+    if (!diff.removed.isEmpty()) {
+        emit markersRemoved(diff.removed);
+    }
+    if (!diff.updated.isEmpty()) {
+        emit markersUpdated(diff.updated);
+    }
+    if (!diff.added.isEmpty()) {
+        emit markersAdded(diff.added);
+    }
 }
 
-const MapSnapshot& MarkerManager::snapshotAt(int index) const {
-    if (index < 0 || index >= m_snapshots.size()) {
-        static MapSnapshot invalidSnapshot;
-        return invalidSnapshot;
+QList<MapSnapshot> MarkerManager::snapshots() const {
+    return runOnWorker([this]() {
+        return m_history.toList();
+    });
+}
+
+MapSnapshot MarkerManager::snapshotAt(int index) const {
+    if (index < 0 || index >= m_snapshotCount) {
+        return MapSnapshot();
+    }
+    if (index == m_snapshotCount - 1) {
+        return m_latestSnapshot;
     }
-    return m_snapshots[index];
+
+    return runOnWorker([this, index]() {
+        return m_history.at(index);
+    });
+}
+
+void MarkerManager::setHistoryMemoryBudget(qint64 bytes) {
+    m_worker.start([this, bytes]() {
+        m_history.setMemoryBudget(bytes);
+    });
+}
+
+void MarkerManager::setHistoryPageBudget(qint64 bytes) {
+    m_worker.start([this, bytes]() {
+        m_history.setPageBudget(bytes);
+    });
 }
 
 void MarkerManager::loadFromSnapshots(const QList<MapSnapshot>& snapshots) {
-    m_snapshots = snapshots;
-    if (!m_snapshots.isEmpty()) {
+    // 加载会替换当前标记集合，丢弃批量操作中暂存的修改
+    if (isInBatch()) {
+        qWarning() << "Cannot load history: a batch is in progress.";
+        return;
+    }
+
+    const quint64 generation = m_loadGeneration.fetchAndAddOrdered(1) + 1;
+    const PersistentMarkerMap base = m_currentMarkers;
+    const LoadResult result = runOnWorker([this, snapshots, generation, base]() {
+        return loadHistory(snapshots, generation, base);
+    });
+    finishLoad(generation, result);
+}
+
+void MarkerManager::loadFromSnapshotsAsync(const QList<MapSnapshot>& snapshots) {
+    if (isInBatch()) {
+        qWarning() << "Cannot load history: a batch is in progress.";
+        return;
+    }
+
+    const quint64 generation = m_loadGeneration.fetchAndAddOrdered(1) + 1;
+    cancelPendingRestore();
+    ++m_pendingLoads;
+
+    const PersistentMarkerMap base = m_currentMarkers;
+    m_worker.start([this, snapshots, generation, base]() {
+        const LoadResult result = loadHistory(snapshots, generation, base);
+        QMetaObject::invokeMethod(this, [this, generation, result]() {
+            --m_pendingLoads;
+            finishLoad(generation, result);
+        }, Qt::QueuedConnection);
+    });
+}
+
+MarkerManager::LoadResult MarkerManager::loadHistory(const QList<MapSnapshot>& snapshots,
+                                                     quint64 generation,
+                                                     const PersistentMarkerMap& base) {
+    // 只保存相邻快照之间的增量，历史占用的内存与变化量成正比
+    LoadResult result;
+    m_history.clear();
+    for (const MapSnapshot& snapshot : snapshots) {
+        // 已有更新的加载请求（它会重新清空历史），放弃
+        if (m_loadGeneration.loadAcquire() != generation) {
+            return result;
+        }
+        m_history.append(snapshot);
+    }
+
+    result.completed = true;
+    result.snapshotCount = m_history.size();
+    result.base = base;
+    if (!m_history.isEmpty()) {
+        result.latest = m_history.at(m_history.size() - 1);
+        result.diff = PersistentMarkerMap::diff(base, result.latest.markerMap());
+    }
+    return result;
+}
+
+void MarkerManager::finishLoad(quint64 generation, const LoadResult& result) {
+    if (!result.completed || m_loadGeneration.loadAcquire() != generation) {
+        return;
+    }
+
+    cancelPendingRestore();
+    m_snapshotCount = result.snapshotCount;
+    m_latestSnapshot = result.latest;
+    m_currentSnapshotIndex = -1;
+    m_requestedIndex = -1;
+
+    if (m_snapshotCount > 0) {
         // 默认加载到最新快照
-        restoreLatestSnapshot();
+        const int latest = m_snapshotCount - 1;
+        if (m_currentMarkers.isSharedWith(result.base)) {
+            applySnapshot(latest, m_latestSnapshot, result.diff);
+        } else {
+            applySnapshot(latest, m_latestSnapshot,
+                          PersistentMarkerMap::diff(m_currentMarkers, m_latestSnapshot.markerMap()));
+        }
+        m_requestedIndex = latest;
     }
+
+    emit historyLoaded(m_snapshotCount);
 }
 
 MapSnapshot MarkerManager::createSnapshotInternal(const QString& description) {
     QDateTime now = QDateTime::currentDateTime();
-    QList<Marker> markers = m_currentMarkers.values();
 
-    MapSnapshot snapshot(now, markers, description);
+    MapSnapshot snapshot(now, m_currentMarkers, description);
     return snapshot;
 }
+
+// ========== MarkerManager::Batch ==========
+
+MarkerManager::Batch::Batch(MarkerManager* manager, const QString& description)
+    : m_manager(manager)
+    , m_description(description)
+{
+    m_manager->beginBatch();
+}
+
+MarkerManager::Batch::~Batch() {
+    commit();
+}
+
+void MarkerManager::Batch::commit() {
+    if (m_committed) {
+        return;
+    }
+    m_committed = true;
+    m_manager->commitBatch(m_description);
+}
@@ -3,26 +3,82 @@
 
 #include <QObject>
 #include <QList>
-#include <QMap>
 #include <QDateTime>
+#include <QAtomicInteger>
+#include <QSemaphore>
+#include <QThreadPool>
 
 #include "../data/marker.h"
 #include "../data/mapsnapshot.h"
+#include "../data/markerpatch.h"
+#include "../data/persistentmarkermap.h"
+#include "snapshothistory.h"
 
 /**
  * @class MarkerManager
  * @brief 标记和快照管理器
  *
  * 负责管理地图标记和历史快照的核心业务逻辑：
- * - 添加/删除标记
+ * - 添加/删除/修改标记
  * - 自动创建快照
  * - 时间回溯（切换到历史快照）
+ *   历史由 SnapshotHistory 以增量 + 关键帧保存，访问任意快照只需重放有限的增量；
+ *   较早的历史分页写入临时文件，回溯时按方向预读
+ * - 批量操作（beginBatch / commitBatch 或 MarkerManager::Batch）：多次增删只生成一个快照
+ *
+ * 线程模型：SnapshotHistory 只在内部的单线程工作池中访问（任务按提交顺序执行）。
+ * 增删标记只在界面线程修改当前标记集合，历史追加交给工作线程；
+ * 重建历史快照（requestSnapshot）和加载历史（loadFromSnapshotsAsync）在工作线程中完成，
+ * 结果（共享结构的不可变标记集合及其差异）通过排队调用回到界面线程发布。
+ * 被更新的请求取代的工作会在开始前或完成后丢弃。
  * - 数据持久化（内存 -> 后端同步由 ApiClient 负责）
  */
 class MarkerManager : public QObject {
     Q_OBJECT
 
 public:
+    /**
+     * @class Batch
+     * @brief 批量操作的作用域对象
+     *
+     * 构造时调用 beginBatch()，析构时（若尚未提交）调用 commitBatch()：
+     * @code
+     * {
+     *     MarkerManager::Batch batch(manager, "导入标记");
+     *     for (const Marker& marker : imported) {
+     *         manager->addMarker(marker);
+     *     }
+     * }   // 生成一个快照，只发出一次变化通知
+     * @endcode
+     */
+    class Batch {
+    public:
+        /**
+         * @brief 开始批量操作
+         * @param manager 标记管理器
+         * @param description 提交时的快照描述（空则自动生成）
+         */
+        explicit Batch(MarkerManager* manager, const QString& description = QString());
+
+        /**
+         * @brief 析构函数，尚未提交时自动提交
+         */
+        ~Batch();
+
+        Batch(const Batch&) = delete;
+        Batch& operator=(const Batch&) = delete;
+
+        /**
+         * @brief 提交批量操作（只能调用一次）
+         */
+        void commit();
+
+    private:
+        MarkerManager* m_manager;
+        QString m_description;
+        bool m_committed = false;
+    };
+
     /**
      * @brief 构造函数
      * @param parent 父对象
@@ -32,7 +88,7 @@ public:
     /**
      * @brief 析构函数
      */
-    ~MarkerManager() override = default;
+    ~MarkerManager() override;
 
     // ========== 标记操作 ==========
 
@@ -42,7 +98,7 @@ public:
      * @param createdBy 操作者（可选）
      * @return 成功返回 true
      *
-     * 添加后会自动创建新的快照。
+     * 添加后会自动创建新的快照；批量操作中则推迟到 commitBatch()。
      */
     bool addMarker(const Marker& marker, const QString& createdBy = QString());
 
@@ -52,10 +108,44 @@ public:
      * @param deletedBy 删除操作者（可选）
      * @return 成功返回 true
      *
-     * 删除后会自动创建新的快照。
+     * 删除后会自动创建新的快照；批量操作中则推迟到 commitBatch()。
      */
     bool deleteMarker(const QString& markerId, const QString& deletedBy = QString());
 
+    /**
+     * @brief 修改标记的部分字段
+     * @param patch 字段级修改（如拖动后的新位置）
+     * @param updatedBy 修改操作者（可选）
+     * @return 成功返回 true；标记不存在或没有实际变化返回 false
+     *
+     * 修改后会自动创建新的快照（批量操作中则推迟到 commitBatch()），
+     * 历史中只记录变化的字段。
+     */
+    bool updateMarker(const MarkerPatch& patch, const QString& updatedBy = QString());
+
+    // ========== 批量操作 ==========
+
+    /**
+     * @brief 开始批量操作
+     *
+     * 之后的 addMarker / deleteMarker / updateMarker 只修改当前标记集合，不创建快照、不发出信号，
+     * 直到对应的 commitBatch()。可以嵌套，最外层提交时才生效。
+     */
+    void beginBatch();
+
+    /**
+     * @brief 提交批量操作
+     * @param description 快照描述（空则使用唯一一次操作的描述或自动汇总）
+     *
+     * 最外层提交时，若与最新快照相比有净变化，则创建一个快照并发出一次变化通知。
+     */
+    void commitBatch(const QString& description = QString());
+
+    /**
+     * @brief 是否处于批量操作中
+     */
+    bool isInBatch() const { return m_batchDepth > 0; }
+
     /**
      * @brief 获取当前显示的所有标记
      * @return 标记列表
@@ -69,13 +159,19 @@ public:
      */
     Marker findMarker(const QString& markerId) const;
 
+    /**
+     * @brief 获取当前显示的标记数量
+     * @return 标记数量（O(1)）
+     */
+    int currentMarkerCount() const { return m_currentMarkers.size(); }
+
     // ========== 快照操作 ==========
 
     /**
      * @brief 获取所有历史快照
-     * @return 快照列表（按时间顺序）
+     * @return 快照列表（按时间顺序，按需展开，代价与历史的总变化量成正比）
      */
-    const QList<MapSnapshot>& snapshots() const { return m_snapshots; }
+    QList<MapSnapshot> snapshots() const;
 
     /**
      * @brief 获取当前快照索引
@@ -87,19 +183,36 @@ public:
      * @brief 获取快照总数
      * @return 快照数量
      */
-    int snapshotCount() const { return m_snapshots.size(); }
+    int snapshotCount() const { return m_snapshotCount; }
 
     /**
-     * @brief 回溯到指定索引的快照
+     * @brief 回溯到指定索引的快照（同步）
      * @param index 快照索引
      * @return 成功返回 true
      *
-     * 切换后会触发 currentSnapshotChanged 信号。
+     * 批量操作中和加载历史期间不能切换快照。会等待工作线程完成重建，
+     * 界面中请使用 requestSnapshot()。
+     * 只计算当前显示状态与目标快照之间的差异（向前或向后均可），
+     * 相邻快照共享结构，代价与两者之间的变化量成正比，而不是标记总数。
+     * 切换后会触发 currentSnapshotChanged 信号，再按变化触发 markersRemoved / markersUpdated / markersAdded。
      */
     bool restoreSnapshot(int index);
 
+    /**
+     * @brief 请求回溯到指定索引的快照（异步）
+     * @param index 快照索引
+     * @return 请求被接受返回 true
+     *
+     * 在工作线程中重建快照并计算差异，完成后在界面线程发出与 restoreSnapshot() 相同的信号。
+     * 新的请求（或增删标记、回到最新状态）会取消尚未完成的请求，
+     * 拖动时间轴时只有最后的位置会被发布。最新快照常驻界面线程，直接切换。
+     */
+    bool requestSnapshot(int index);
+
     /**
      * @brief 回溯到最新快照（即当前状态）
+     *
+     * 最新状态常驻界面线程，不需要等待工作线程。
      */
     void restoreLatestSnapshot();
 
@@ -114,27 +227,59 @@ public:
     /**
      * @brief 获取指定索引的快照
      * @param index 快照索引
-     * @return 快照对象
+     * @return 快照对象（由最近的关键帧重建），索引无效返回空快照
+     */
+    MapSnapshot snapshotAt(int index) const;
+
+    /**
+     * @brief 设置历史关键帧缓存的内存预算
+     * @param bytes 预算（字节），默认为 SnapshotHistory::kDefaultMemoryBudget
+     *
+     * 预算越小，回溯到较早历史时需要重放的增量越多。
      */
-    const MapSnapshot& snapshotAt(int index) const;
+    void setHistoryMemoryBudget(qint64 bytes);
+
+    /**
+     * @brief 设置历史常驻页的内存预算
+     * @param bytes 预算（字节），默认为 SnapshotHistory::kDefaultPageBudget
+     *
+     * 超出预算时最久未访问的历史页写入临时文件，再次访问时读回。
+     */
+    void setHistoryPageBudget(qint64 bytes);
 
     // ========== 数据导入/导出 ==========
 
     /**
-     * @brief 从快照列表加载历史数据
+     * @brief 从快照列表加载历史数据（同步）
      * @param snapshots 快照列表
      *
-     * 用于从后端同步数据。
+     * 等待工作线程完成加载后返回，并切换到最新快照。
+     * 批量操作进行中时拒绝加载（输出警告，不改变当前状态），以免丢弃暂存的修改。
      */
     void loadFromSnapshots(const QList<MapSnapshot>& snapshots);
 
+    /**
+     * @brief 从快照列表加载历史数据（异步）
+     * @param snapshots 快照列表
+     *
+     * 用于从后端同步数据。在工作线程中计算增量，完成后切换到最新快照并发出 historyLoaded。
+     * 加载期间不能增删标记和切换快照；新的加载请求会取消尚未完成的加载。
+     * 与 loadFromSnapshots() 相同，批量操作进行中时拒绝加载，先提交批量操作再加载。
+     */
+    void loadFromSnapshotsAsync(const QList<MapSnapshot>& snapshots);
+
+    /**
+     * @brief 是否正在加载历史
+     */
+    bool isLoading() const { return m_pendingLoads > 0; }
+
     /**
      * @brief 导出当前所有快照
      * @return 快照列表
      *
      * 用于同步到后端。
      */
-    QList<MapSnapshot> exportSnapshots() const { return m_snapshots; }
+    QList<MapSnapshot> exportSnapshots() const { return snapshots(); }
 
 signals:
     /**
@@ -155,25 +300,151 @@ signals:
     void snapshotCreated(const MapSnapshot& snapshot);
 
     /**
-     * @brief 标记列表改变信号
-     * @param markers 当前显示的标记列表
+     * @brief 历史加载完成信号
+     * @param snapshotCount 加载后的快照数量
      *
-     * 当切换快照或修改标记时触发。
+     * loadFromSnapshots / loadFromSnapshotsAsync 完成并切换到最新快照后触发。
      */
-    void markersChanged(const QList<Marker>& markers);
+    void historyLoaded(int snapshotCount);
+
+    /**
+     * @brief 标记新增信号
+     * @param markers 新出现在当前显示状态中的标记
+     *
+     * 增删标记、提交批量操作或切换快照时，只携带受影响的标记。
+     * 同一次变化按 markersRemoved -> markersUpdated -> markersAdded 的顺序发出，
+     * 没有对应变化的信号不发出。
+     */
+    void markersAdded(const QList<Marker>& markers);
+
+    /**
+     * @brief 标记移除信号
+     * @param markers 从当前显示状态中消失的标记（移除前的数据）
+     */
+    void markersRemoved(const QList<Marker>& markers);
+
+    /**
+     * @brief 标记修改信号
+     * @param markers 内容发生变化的标记（变化后的数据）
+     */
+    void markersUpdated(const QList<Marker>& markers);
 
 private:
+    /**
+     * @brief 工作线程中加载历史的结果
+     */
+    struct LoadResult {
+        bool completed = false;         ///< 是否完成（被更新的加载取代时为 false）
+        int snapshotCount = 0;          ///< 快照数量
+        MapSnapshot latest;             ///< 最新快照
+        PersistentMarkerMap base;       ///< 计算差异时的显示状态
+        MarkerDiff diff;                ///< 从 base 到最新快照的差异
+    };
+
     /**
      * @brief 创建快照的内部实现
      * @param description 快照描述
      * @return 新创建的快照
+     *
+     * 快照直接共享当前标记集合，代价为 O(1)。
      */
     MapSnapshot createSnapshotInternal(const QString& description);
 
+    /**
+     * @brief 记录一次标记修改：批量操作中暂存，否则立即创建快照
+     * @param description 本次修改的描述
+     */
+    void recordChange(const QString& description);
+
+    /**
+     * @brief 修改标记前确保显示的是最新快照
+     *
+     * 已显示最新快照且没有未完成的回溯请求时不做任何事，
+     * 避免每次修改都多发出一次 currentSnapshotChanged。批量操作中不切换。
+     */
+    void ensureLatestSnapshot();
+
+    /**
+     * @brief 按差异发出 markersRemoved / markersUpdated / markersAdded
+     * @param diff 从之前显示的状态到当前状态的差异
+     */
+    void emitMarkerChanges(const MarkerDiff& diff);
+
+    /**
+     * @brief 检查能否切换到指定快照
+     */
+    bool canRestore(int index) const;
+
+    /**
+     * @brief 取消尚未发布的异步回溯
+     * @return 新的请求代号
+     */
+    quint64 cancelPendingRestore();
+
+    /**
+     * @brief 切换当前显示的快照并发出信号
+     * @param index 快照索引
+     * @param snapshot 快照对象
+     * @param diff 从当前显示状态到快照的差异
+     */
+    void applySnapshot(int index, const MapSnapshot& snapshot, const MarkerDiff& diff);
+
+    /**
+     * @brief 发布异步回溯的结果（已被取代时丢弃）
+     */
+    void finishRequest(quint64 generation, int index, const MapSnapshot& snapshot,
+                       const PersistentMarkerMap& base, const MarkerDiff& diff);
+
+    /**
+     * @brief 在工作线程中重建历史
+     * @param snapshots 快照列表
+     * @param generation 加载请求代号（被取代时中途放弃）
+     * @param base 当前显示状态（用于计算差异）
+     */
+    LoadResult loadHistory(const QList<MapSnapshot>& snapshots, quint64 generation,
+                           const PersistentMarkerMap& base);
+
+    /**
+     * @brief 发布加载结果（已被取代时丢弃）
+     */
+    void finishLoad(quint64 generation, const LoadResult& result);
+
+    /**
+     * @brief 在工作线程中执行并等待结果（排在之前提交的任务之后）
+     *
+     * 不使用 QFuture::result() 等待：它可能把尚未开始的任务拿到当前线程执行，
+     * 越过之前提交的追加，并与工作线程中正在执行的任务同时访问 m_history。
+     */
+    template <typename Function>
+    auto runOnWorker(Function function) const -> decltype(function());
+
 private:
-    QList<MapSnapshot> m_snapshots;        ///< 历史快照列表
+    SnapshotHistory m_history;             ///< 历史快照（增量 + 关键帧，只在工作线程中访问）
+    mutable QThreadPool m_worker;          ///< 历史工作线程（单线程，按提交顺序执行）
+    QAtomicInteger<quint64> m_restoreGeneration;  ///< 回溯请求代号（递增即取消之前的请求）
+    QAtomicInteger<quint64> m_loadGeneration;     ///< 加载请求代号
+    int m_pendingLoads = 0;                ///< 尚未发布的异步加载数
+
+    int m_snapshotCount = 0;               ///< 快照数量（界面线程的副本）
+    MapSnapshot m_latestSnapshot;          ///< 最新快照（界面线程的副本，与历史共享结构）
     int m_currentSnapshotIndex;            ///< 当前查看的快照索引
-    QMap<QString, Marker> m_currentMarkers; ///< 当前显示的标记 (ID -> Marker)
+    int m_requestedIndex = -1;             ///< 最近请求的快照索引（用于判断回溯方向）
+    PersistentMarkerMap m_currentMarkers;  ///< 当前显示的标记 (ID -> Marker，与快照共享结构)
+    int m_batchDepth = 0;                  ///< 批量操作的嵌套深度
+    int m_batchChanges = 0;                ///< 批量操作中暂存的修改次数
+    QString m_batchDescription;            ///< 批量操作中最后一次修改的描述
 };
 
+template <typename Function>
+auto MarkerManager::runOnWorker(Function function) const -> decltype(function()) {
+    decltype(function()) result;
+    QSemaphore done;
+    m_worker.start([&result, &done, &function]() {
+        result = function();
+        done.release();
+    });
+    done.acquire();
+    return result;
+}
+
 #endif // MARKERMANAGER_H
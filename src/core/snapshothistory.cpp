@@ -0,0 +1,615 @@
+#include "snapshothistory.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+#include "../data/dataschema.h"
+#include "../data/stringpool.h"
+
+// 冷页文件只在本进程内使用，紧凑记录和字符串序号按内存布局直接写入
+static_assert(std::is_trivially_copyable<CompactMarker>::value,
+              "CompactMarker is written to the spill file as raw bytes");
+
+namespace {
+
+/**
+ * 编码一个标记的字段级修改：ID 序号，然后是按 Schema<Marker> 生成的修改
+ * （变化字段的位图 + 变化的字段）。坐标和时间写与旧值的差，拖动时通常只有几个字节。
+ */
+void writePatch(QByteArray& out, const CompactMarker& before, const CompactMarker& after) {
+    DataSchema::writeVarint(out, after.id);
+    DataSchema::writeCompactPatch<Marker>(out, before, after);
+}
+
+/**
+ * 在标记集合上依次应用 writePatch 编码的修改
+ * @return 数据完整返回 true
+ */
+bool applyPatches(const QByteArray& patches, PersistentMarkerMap& markers) {
+    DataSchema::BinaryReader reader{patches.constData(), patches.constData() + patches.size()};
+    while (reader.pos < reader.end) {
+        quint64 id = 0;
+        if (!reader.readVarint(&id)) {
+            return false;
+        }
+        const CompactMarker* current = markers.find(quint32(id));
+        if (!current) {
+            return false;
+        }
+
+        CompactMarker marker = *current;
+        if (!DataSchema::applyCompactPatch<Marker>(reader, &marker) || marker.id != quint32(id)) {
+            return false;
+        }
+        markers.insert(marker);
+    }
+    return true;
+}
+
+} // namespace
+
+SnapshotHistory::SnapshotHistory() = default;
+
+SnapshotHistory::~SnapshotHistory() {
+    waitForPrefetch();
+    releaseStrings();
+}
+
+void SnapshotHistory::clear() {
+    waitForPrefetch();
+    releaseStrings();
+    m_pages.clear();
+    m_size = 0;
+    m_keyframes.clear();
+    m_latest = PersistentMarkerMap();
+    m_changesSinceKeyframe = 0;
+    m_snapshotsSinceKeyframe = 0;
+    m_residentBytes = 0;
+    m_spillFile.reset();
+    m_keyframeBytes = 0;
+    m_residentKeyframes = 0;
+    m_appendGeneration = 0;
+}
+
+void SnapshotHistory::retainStrings(const CompactMarker& marker) {
+    DataSchema::forEachField<Marker>([&](const auto& field) {
+        using V = typename std::decay_t<decltype(field)>::ValueType;
+        if constexpr (std::is_same<V, QString>::value) {
+            const quint32 index = field.getCompact(marker);
+            if (index != 0 && !m_strings.contains(index)) {
+                m_strings.insert(index);
+                StringPool::markerStrings().retain(index);
+            }
+        }
+    });
+}
+
+void SnapshotHistory::releaseStrings() {
+    StringPool& strings = StringPool::markerStrings();
+    for (quint32 index : std::as_const(m_strings)) {
+        strings.release(index);
+    }
+    m_strings.clear();
+}
+
+void SnapshotHistory::append(const MapSnapshot& snapshot) {
+    Entry entry;
+    entry.header = snapshot;
+    entry.header.setMarkers(PersistentMarkerMap());
+    if (!snapshot.markerMap().isSharedWith(m_latest)) {
+        std::vector<CompactMarker> upserts;
+        PersistentMarkerMap::diffCompact(m_latest, snapshot.markerMap(),
+                                         &upserts, &entry.removedIds);
+
+        // 已有的标记只记录变化的字段
+        for (const CompactMarker& marker : upserts) {
+            retainStrings(marker);
+            if (const CompactMarker* before = m_latest.find(marker.id)) {
+                writePatch(entry.patches, *before, marker);
+                ++entry.patchCount;
+            } else {
+                entry.upserts.push_back(marker);
+            }
+        }
+    }
+
+    // 在最新状态上重放增量，而不是直接保存传入的集合：
+    // 从 JSON 加载的快照彼此独立，重放后才与历史中的其他状态共享结构
+    replay(entry, m_latest);
+    entry.markerCount = m_latest.size();
+
+    m_changesSinceKeyframe += int(entry.upserts.size() + entry.removedIds.size()) + entry.patchCount;
+    ++m_snapshotsSinceKeyframe;
+
+    const int index = m_size;
+    const bool keyframe = m_keyframes.isEmpty()
+                          || m_changesSinceKeyframe >= kKeyframeChanges
+                          || m_snapshotsSinceKeyframe >= kMaxKeyframeSpacing;
+    if (keyframe) {
+        entry.keyframeCost = qMax(1, m_changesSinceKeyframe) * kBytesPerChange;
+        Keyframe added;
+        added.index = index;
+        added.changeCost = entry.keyframeCost;
+        added.fullCost = qint64(m_latest.size()) * kBytesPerMarker;
+        m_keyframes.append(added);
+        m_changesSinceKeyframe = 0;
+        m_snapshotsSinceKeyframe = 0;
+    }
+
+    // 最后一页始终常驻；写满后开始新的一页，之前的页可以换出
+    if (m_pages.isEmpty() || m_pages.last().entries.size() == kPageSize) {
+        m_pages.append(Page());
+    }
+    Page& page = m_pages.last();
+    const qint64 cost = entryCost(entry);
+    page.entries.append(std::move(entry));
+    page.memoryCost += cost;
+    page.lastUsed = ++m_useClock;
+    m_residentBytes += cost;
+    ++m_size;
+
+    if (keyframe) {
+        // 最新状态由前一个关键帧的原始实例增量得到，与它共享结构
+        const int position = m_keyframes.size() - 1;
+        makeResident(position, m_latest, position > 0 ? m_appendGeneration : 0);
+        m_appendGeneration = m_keyframes[position].generation;
+        evictKeyframes(position);
+    }
+    if (m_residentBytes > m_pageBudget) {
+        evictPages(m_pages.size() - 1);
+    }
+}
+
+MapSnapshot SnapshotHistory::at(int index) const {
+    if (index < 0 || index >= m_size) {
+        return MapSnapshot();
+    }
+
+    MapSnapshot snapshot = entry(index).header;
+    snapshot.setMarkers(markersAt(index));
+    return snapshot;
+}
+
+PersistentMarkerMap SnapshotHistory::markersAt(int index) const {
+    if (index < 0 || index >= m_size) {
+        return PersistentMarkerMap();
+    }
+    if (index == m_size - 1) {
+        return m_latest;
+    }
+
+    // 从不晚于 index 的最近一个关键帧开始（被淘汰时从文件读回），只重放一个间隔内的增量
+    const int position = keyframeAtOrBefore(index);
+    PersistentMarkerMap markers = keyframeMarkers(position);
+    for (int i = m_keyframes[position].index + 1; i <= index; ++i) {
+        replay(entry(i), markers);
+    }
+    return markers;
+}
+
+int SnapshotHistory::markerCountAt(int index) const {
+    if (index < 0 || index >= m_size) {
+        return 0;
+    }
+    return entry(index).markerCount;
+}
+
+QList<MapSnapshot> SnapshotHistory::toList() const {
+    QList<MapSnapshot> snapshots;
+    snapshots.reserve(m_size);
+
+    PersistentMarkerMap markers;
+    for (int i = 0; i < m_size; ++i) {
+        const Entry& current = entry(i);
+        replay(current, markers);
+        MapSnapshot snapshot = current.header;
+        snapshot.setMarkers(markers);
+        snapshots.append(snapshot);
+    }
+    return snapshots;
+}
+
+void SnapshotHistory::prefetch(int index, int direction) const {
+    if (direction == 0 || index < 0 || index >= m_size || !m_spillFile) {
+        return;
+    }
+
+    const int pageIndex = index / kPageSize + (direction > 0 ? 1 : -1);
+    if (pageIndex < 0 || pageIndex >= m_pages.size()) {
+        return;
+    }
+
+    Page& page = m_pages[pageIndex];
+    if (page.resident || page.pending.isValid() || page.fileOffset < 0) {
+        return;
+    }
+    page.pending = QtConcurrent::run(&SnapshotHistory::readPage, m_spillFile->fileName(),
+                                     page.fileOffset, page.fileSize);
+}
+
+void SnapshotHistory::setMemoryBudget(qint64 bytes) {
+    m_keyframeBudget = qMax<qint64>(0, bytes);
+    evictKeyframes(-1);
+}
+
+void SnapshotHistory::setPageBudget(qint64 bytes) {
+    m_pageBudget = qMax<qint64>(0, bytes);
+    if (!m_pages.isEmpty()) {
+        evictPages(m_pages.size() - 1);
+    }
+}
+
+// ========== 增量 ==========
+
+void SnapshotHistory::replay(const Entry& entry, PersistentMarkerMap& markers) {
+    for (quint32 id : entry.removedIds) {
+        markers.remove(id);
+    }
+    for (const CompactMarker& marker : entry.upserts) {
+        markers.insert(marker);
+    }
+    if (!applyPatches(entry.patches, markers)) {
+        qCritical() << "Corrupted marker patches in history:" << entry.header.snapshotId();
+    }
+}
+
+qint64 SnapshotHistory::entryCost(const Entry& entry) {
+    const qint64 strings = entry.header.snapshotId().size() + entry.header.description().size();
+    return qint64(sizeof(Entry)) + strings * qint64(sizeof(QChar))
+           + qint64(entry.removedIds.capacity() * sizeof(quint32))
+           + qint64(entry.upserts.capacity() * sizeof(CompactMarker))
+           + qint64(entry.patches.capacity());
+}
+
+// ========== 关键帧 ==========
+
+int SnapshotHistory::keyframeAtOrBefore(int index) const {
+    // 第一个快照总是关键帧，结果不小于 0
+    const auto next = std::upper_bound(m_keyframes.constBegin(), m_keyframes.constEnd(), index,
+                                       [](int value, const Keyframe& keyframe) {
+                                           return value < keyframe.index;
+                                       });
+    return int(next - m_keyframes.constBegin()) - 1;
+}
+
+PersistentMarkerMap SnapshotHistory::keyframeMarkers(int position) const {
+    Keyframe& keyframe = m_keyframes[position];
+    keyframe.lastUsed = ++m_useClock;
+    if (keyframe.resident) {
+        return keyframe.markers;
+    }
+
+    PersistentMarkerMap markers;
+    if (keyframe.fileOffset >= 0
+        && decodeKeyframe(readSpill(m_spillFile->fileName(), keyframe.fileOffset, keyframe.fileSize),
+                          &markers)) {
+        // 读回的集合不与其他关键帧共享结构
+        makeResident(position, markers, 0);
+    } else {
+        if (keyframe.fileOffset >= 0) {
+            qCritical() << "Failed to read history keyframe" << keyframe.index << "from"
+                        << m_spillFile->fileName();
+        }
+
+        // 没能写入文件时从前一个关键帧重放一个间隔
+        quint64 baseGeneration = 0;
+        int start = 0;
+        if (position > 0) {
+            markers = keyframeMarkers(position - 1);
+            baseGeneration = m_keyframes[position - 1].generation;
+            start = m_keyframes[position - 1].index + 1;
+        }
+        for (int i = start; i <= keyframe.index; ++i) {
+            replay(entry(i), markers);
+        }
+        makeResident(position, markers, baseGeneration);
+    }
+    evictKeyframes(position);
+    return markers;
+}
+
+void SnapshotHistory::makeResident(int position, const PersistentMarkerMap& markers,
+                                   quint64 baseGeneration) const {
+    Keyframe& keyframe = m_keyframes[position];
+    keyframe.markers = markers;
+    keyframe.resident = true;
+    keyframe.generation = ++m_keyframeGeneration;
+    keyframe.baseGeneration = baseGeneration;
+    keyframe.lastUsed = ++m_useClock;
+    keyframe.memoryCost = keyframeCost(position);
+    m_keyframeBytes += keyframe.memoryCost;
+    ++m_residentKeyframes;
+}
+
+qint64 SnapshotHistory::keyframeCost(int position) const {
+    // 沿派生链向前累计差异，直到遇到仍常驻的那个实例：
+    // 中间被淘汰的关键帧原先与它共享的节点现在只由它持有，不超过完整集合的估算
+    const Keyframe& keyframe = m_keyframes[position];
+    qint64 cost = 0;
+    for (int i = position; i > 0 && cost < keyframe.fullCost; --i) {
+        const Keyframe& current = m_keyframes[i];
+        if (current.baseGeneration == 0) {
+            break;
+        }
+        cost += current.changeCost;
+        const Keyframe& base = m_keyframes[i - 1];
+        if (base.resident && base.generation == current.baseGeneration) {
+            return qMin(cost, keyframe.fullCost);
+        }
+    }
+    return keyframe.fullCost;
+}
+
+void SnapshotHistory::updateSuccessorCost(int position) const {
+    // 只有第一个常驻的后继可能经由它共享，更靠后的在该后继处停止累计
+    for (int i = position + 1; i < m_keyframes.size(); ++i) {
+        Keyframe& next = m_keyframes[i];
+        if (next.resident) {
+            const qint64 cost = keyframeCost(i);
+            m_keyframeBytes += cost - next.memoryCost;
+            next.memoryCost = cost;
+            return;
+        }
+    }
+}
+
+void SnapshotHistory::evictKeyframes(int keepPosition) const {
+    while (m_keyframeBytes > m_keyframeBudget) {
+        // 淘汰最久未访问的常驻关键帧（正在使用的除外）
+        int victim = -1;
+        for (int i = 0; i < m_keyframes.size(); ++i) {
+            const Keyframe& keyframe = m_keyframes[i];
+            if (keyframe.resident && i != keepPosition
+                && (victim < 0 || keyframe.lastUsed < m_keyframes[victim].lastUsed)) {
+                victim = i;
+            }
+        }
+        if (victim < 0) {
+            return;
+        }
+        spillKeyframe(m_keyframes[victim]);
+        updateSuccessorCost(victim);
+    }
+}
+
+void SnapshotHistory::spillKeyframe(Keyframe& keyframe) const {
+    // 完整记录只需写入一次；写入失败时仍然释放，之后从前一个关键帧重建
+    if (keyframe.fileOffset < 0) {
+        const QByteArray data = encodeKeyframe(keyframe.markers);
+        qint64 offset = 0;
+        if (writeSpill(data, &offset)) {
+            keyframe.fileOffset = offset;
+            keyframe.fileSize = data.size();
+        }
+    }
+
+    keyframe.markers = PersistentMarkerMap();
+    keyframe.resident = false;
+    m_keyframeBytes -= keyframe.memoryCost;
+    keyframe.memoryCost = 0;
+    --m_residentKeyframes;
+}
+
+QByteArray SnapshotHistory::encodeKeyframe(const PersistentMarkerMap& markers) {
+    QByteArray out;
+    out.reserve(10 + qsizetype(markers.size()) * qsizetype(sizeof(CompactMarker)));
+    DataSchema::writeVarint(out, quint64(markers.size()));
+    markers.forEachCompact([&out](const CompactMarker& marker) {
+        out.append(reinterpret_cast<const char*>(&marker), qsizetype(sizeof(CompactMarker)));
+    });
+    return out;
+}
+
+bool SnapshotHistory::decodeKeyframe(const QByteArray& data, PersistentMarkerMap* markers) {
+    DataSchema::BinaryReader reader{data.constData(), data.constData() + data.size()};
+    quint64 count = 0;
+    const char* bytes = nullptr;
+    if (!reader.readVarint(&count)
+        || count > quint64(reader.end - reader.pos) / sizeof(CompactMarker)
+        || !reader.readBytes(qsizetype(count * sizeof(CompactMarker)), &bytes)) {
+        return false;
+    }
+
+    PersistentMarkerMap result;
+    for (quint64 i = 0; i < count; ++i) {
+        CompactMarker marker;
+        std::memcpy(&marker, bytes + i * sizeof(CompactMarker), sizeof(CompactMarker));
+        result.insert(marker);
+    }
+    *markers = result;
+    return true;
+}
+
+// ========== 分页 ==========
+
+const SnapshotHistory::Entry& SnapshotHistory::entry(int index) const {
+    return residentPage(index / kPageSize).entries[index % kPageSize];
+}
+
+SnapshotHistory::Page& SnapshotHistory::residentPage(int pageIndex) const {
+    Page& page = m_pages[pageIndex];
+    page.lastUsed = ++m_useClock;
+    if (page.resident) {
+        return page;
+    }
+
+    // 优先使用预读的结果，否则同步读回
+    QVector<Entry> entries;
+    if (page.pending.isValid()) {
+        entries = page.pending.result();
+        page.pending = QFuture<QVector<Entry>>();
+    } else {
+        entries = readPage(m_spillFile->fileName(), page.fileOffset, page.fileSize);
+    }
+    if (entries.size() != kPageSize) {
+        // 只有写满的页会被换出；读取失败时保留空增量，避免越界
+        qCritical() << "Failed to read history page" << pageIndex << "from"
+                    << m_spillFile->fileName();
+        entries.resize(kPageSize);
+    }
+
+    page.entries = std::move(entries);
+    page.resident = true;
+    m_residentBytes += page.memoryCost;
+    evictPages(pageIndex);
+    return page;
+}
+
+void SnapshotHistory::evictPages(int keepPage) const {
+    const int lastPage = m_pages.size() - 1;
+    while (m_residentBytes > m_pageBudget) {
+        // 换出最久未访问的常驻页（最后一页和正在使用的页除外）
+        int victim = -1;
+        for (int i = 0; i < lastPage; ++i) {
+            const Page& page = m_pages[i];
+            if (page.resident && i != keepPage
+                && (victim < 0 || page.lastUsed < m_pages[victim].lastUsed)) {
+                victim = i;
+            }
+        }
+        if (victim < 0 || !spillPage(m_pages[victim])) {
+            return;
+        }
+    }
+}
+
+bool SnapshotHistory::spillPage(Page& page) const {
+    // 写满的页不再变化，只需写入一次，再次换出时直接释放
+    if (page.fileOffset < 0) {
+        const QByteArray data = encodePage(page.entries);
+        qint64 offset = 0;
+        if (!writeSpill(data, &offset)) {
+            return false;
+        }
+        page.fileOffset = offset;
+        page.fileSize = data.size();
+    }
+
+    page.entries = QVector<Entry>();
+    page.resident = false;
+    m_residentBytes -= page.memoryCost;
+    return true;
+}
+
+bool SnapshotHistory::writeSpill(const QByteArray& data, qint64* offset) const {
+    if (!m_spillFile) {
+        m_spillFile = std::make_unique<QTemporaryFile>(
+            QDir::tempPath() + "/librarymap-history-XXXXXX.bin");
+        if (!m_spillFile->open()) {
+            qWarning() << "Failed to create history spill file:" << m_spillFile->errorString();
+            m_spillFile.reset();
+            return false;
+        }
+    }
+
+    // 追加到文件末尾
+    *offset = m_spillFile->size();
+    if (!m_spillFile->seek(*offset) || m_spillFile->write(data) != data.size()
+        || !m_spillFile->flush()) {
+        qWarning() << "Failed to write history spill file:" << m_spillFile->errorString();
+        return false;
+    }
+    return true;
+}
+
+void SnapshotHistory::waitForPrefetch() const {
+    for (Page& page : m_pages) {
+        if (page.pending.isValid()) {
+            page.pending.waitForFinished();
+        }
+    }
+}
+
+QByteArray SnapshotHistory::encodePage(const QVector<Entry>& entries) {
+    QByteArray out;
+    DataSchema::writeVarint(out, quint64(entries.size()));
+    for (const Entry& entry : entries) {
+        // 时间戳带 UTC 偏移，读回后时区写法不变
+        DataSchema::writeBinary(out, entry.header);
+        DataSchema::writeVarint(out, quint64(entry.markerCount));
+        DataSchema::writeVarint(out, quint64(entry.keyframeCost));
+        DataSchema::writeVarint(out, quint64(entry.removedIds.size()));
+        out.append(reinterpret_cast<const char*>(entry.removedIds.data()),
+                   qsizetype(entry.removedIds.size() * sizeof(quint32)));
+        DataSchema::writeVarint(out, quint64(entry.upserts.size()));
+        out.append(reinterpret_cast<const char*>(entry.upserts.data()),
+                   qsizetype(entry.upserts.size() * sizeof(CompactMarker)));
+        DataSchema::writeVarint(out, quint64(entry.patchCount));
+        DataSchema::writeVarint(out, quint64(entry.patches.size()));
+        out.append(entry.patches);
+    }
+    return out;
+}
+
+QVector<SnapshotHistory::Entry> SnapshotHistory::decodePage(const QByteArray& data) {
+    DataSchema::BinaryReader reader{data.constData(), data.constData() + data.size()};
+
+    // 读取 count 个 T 的原始字节，长度先与剩余数据比较，防止溢出
+    auto readArray = [&reader](auto* values) {
+        using T = typename std::decay_t<decltype(*values)>::value_type;
+        quint64 count = 0;
+        const char* bytes = nullptr;
+        if (!reader.readVarint(&count) || count > quint64(reader.end - reader.pos) / sizeof(T)
+            || !reader.readBytes(qsizetype(count * sizeof(T)), &bytes)) {
+            return false;
+        }
+        values->resize(count);
+        if (count > 0) {
+            std::memcpy(values->data(), bytes, count * sizeof(T));
+        }
+        return true;
+    };
+
+    quint64 count = 0;
+    if (!reader.readVarint(&count) || count > quint64(kPageSize)) {
+        return {};
+    }
+
+    QVector<Entry> entries(int(count));
+    for (Entry& entry : entries) {
+        quint64 markerCount = 0;
+        quint64 keyframeCost = 0;
+        quint64 patchCount = 0;
+        quint64 patchBytes = 0;
+        const char* patches = nullptr;
+        if (!DataSchema::readBinary(reader, &entry.header)
+            || !reader.readVarint(&markerCount) || !reader.readVarint(&keyframeCost)
+            || !readArray(&entry.removedIds) || !readArray(&entry.upserts)
+            || !reader.readVarint(&patchCount) || !reader.readVarint(&patchBytes)
+            || patchBytes > quint64(reader.end - reader.pos)
+            || !reader.readBytes(qsizetype(patchBytes), &patches)) {
+            return {};
+        }
+        entry.markerCount = int(markerCount);
+        entry.keyframeCost = qint64(keyframeCost);
+        entry.patchCount = int(patchCount);
+        entry.patches = QByteArray(patches, qsizetype(patchBytes));
+    }
+    return entries;
+}
+
+QVector<SnapshotHistory::Entry> SnapshotHistory::readPage(const QString& fileName,
+                                                          qint64 offset, qint64 size) {
+    const QByteArray data = readSpill(fileName, offset, size);
+    if (data.isEmpty()) {
+        return {};
+    }
+    return decodePage(data);
+}
+
+QByteArray SnapshotHistory::readSpill(const QString& fileName, qint64 offset, qint64 size) {
+    // 使用独立的文件句柄，可以在后台线程中执行
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(offset)) {
+        return {};
+    }
+    const QByteArray data = file.read(size);
+    if (data.size() != size) {
+        return {};
+    }
+    return data;
+}
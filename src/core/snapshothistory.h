@@ -0,0 +1,259 @@
+#ifndef SNAPSHOTHISTORY_H
+#define SNAPSHOTHISTORY_H
+
+#include <QFuture>
+#include <QList>
+#include <QSet>
+#include <QTemporaryFile>
+#include <QVector>
+#include <memory>
+#include <vector>
+
+#include "../data/compactmarker.h"
+#include "../data/mapsnapshot.h"
+#include "../data/persistentmarkermap.h"
+
+/**
+ * @class SnapshotHistory
+ * @brief 以增量 + 关键帧保存的快照历史
+ *
+ * 每个快照只保存相对前一个快照的变化：新增标记的紧凑记录、被删除的ID序号，
+ * 以及已有标记的字段级修改（只记录变化的字段，坐标记录差值，拖动一次约 10 字节）。
+ * 另外按变化量自适应地选取关键帧：自上一个关键帧累计的变化数达到
+ * kKeyframeChanges，或相隔 kMaxKeyframeSpacing 个快照时，当前快照成为关键帧。
+ *
+ * 关键帧的完整标记集合按内存预算 LRU 常驻，最新状态始终常驻。
+ * 关键帧由前一个关键帧增量得到，与之共享结构，常驻时只占用变化部分的内存；
+ * 前一个关键帧被淘汰后，原先共享的节点改记到仍常驻的后继上。
+ * 被淘汰的关键帧把完整的紧凑记录写入临时文件（每个关键帧只写一次），再次访问时读回。
+ * 访问任意快照 = 不晚于它的最近一个关键帧 + 重放其后的增量，
+ * 因此无论缓存状态如何，重放量都不超过一个关键帧间隔。
+ *
+ * 快照本身（元数据 + 增量）按 kPageSize 个一页分页。常驻页超过内存预算时，
+ * 最久未访问的页写入本地临时文件（紧凑二进制，每页只写一次）后释放，
+ * 再次访问时读回。prefetch() 按回溯方向在后台线程提前读取下一页。
+ * 最后一页（仍在追加）始终常驻。
+ *
+ * 增量、冷页和关键帧文件中的记录都保存字符串序号，历史持有其中每个字符串的一次引用，
+ * clear() 或析构时释放，之后字符串池才能回收这些字符串。
+ */
+class SnapshotHistory {
+public:
+    static constexpr int kKeyframeChanges = 256;        ///< 关键帧之间最多累计的变化数
+    static constexpr int kMaxKeyframeSpacing = 1024;    ///< 关键帧之间最多相隔的快照数
+    static constexpr qint64 kDefaultMemoryBudget = 64 * 1024 * 1024;   ///< 关键帧缓存的默认预算（字节）
+    static constexpr int kPageSize = 256;               ///< 每页的快照数
+    static constexpr qint64 kDefaultPageBudget = 128 * 1024 * 1024;    ///< 常驻页的默认预算（字节）
+
+    /**
+     * @brief 构造空历史
+     */
+    SnapshotHistory();
+
+    /**
+     * @brief 析构函数（等待未完成的预读，删除临时文件）
+     */
+    ~SnapshotHistory();
+
+    SnapshotHistory(const SnapshotHistory&) = delete;
+    SnapshotHistory& operator=(const SnapshotHistory&) = delete;
+
+    /**
+     * @brief 清空历史
+     */
+    void clear();
+
+    /**
+     * @brief 追加快照
+     * @param snapshot 快照（只保存与前一个快照的差异）
+     *
+     * 与最新状态共享结构时（如 MarkerManager 的增删操作），代价与变化量成正比。
+     */
+    void append(const MapSnapshot& snapshot);
+
+    /**
+     * @brief 获取快照数量
+     */
+    int size() const { return m_size; }
+
+    /**
+     * @brief 是否为空
+     */
+    bool isEmpty() const { return m_size == 0; }
+
+    /**
+     * @brief 获取指定索引的快照（按需重建标记集合）
+     * @param index 快照索引
+     * @return 快照对象，索引无效返回空快照
+     */
+    MapSnapshot at(int index) const;
+
+    /**
+     * @brief 获取指定索引的标记集合
+     * @param index 快照索引
+     * @return 标记集合，索引无效返回空集合
+     */
+    PersistentMarkerMap markersAt(int index) const;
+
+    /**
+     * @brief 获取指定索引的标记数量（不重建，所在页不常驻时会读回）
+     * @param index 快照索引
+     */
+    int markerCountAt(int index) const;
+
+    /**
+     * @brief 获取最新状态（常驻，O(1)）
+     */
+    const PersistentMarkerMap& latestMarkers() const { return m_latest; }
+
+    /**
+     * @brief 展开为完整的快照列表
+     * @return 快照列表（顺序重放一遍，相邻快照共享结构）
+     */
+    QList<MapSnapshot> toList() const;
+
+    /**
+     * @brief 在后台预读回溯方向上的下一页
+     * @param index 当前访问的快照索引
+     * @param direction 回溯方向（> 0 向新，< 0 向旧，0 不预读）
+     */
+    void prefetch(int index, int direction) const;
+
+    /**
+     * @brief 设置关键帧缓存的内存预算
+     * @param bytes 预算（字节，按未共享的节点估算）
+     */
+    void setMemoryBudget(qint64 bytes);
+
+    /**
+     * @brief 获取关键帧缓存的内存预算
+     */
+    qint64 memoryBudget() const { return m_keyframeBudget; }
+
+    /**
+     * @brief 设置常驻页的内存预算
+     * @param bytes 预算（字节，按增量和字符串大小估算）
+     */
+    void setPageBudget(qint64 bytes);
+
+    /**
+     * @brief 获取常驻页的内存预算
+     */
+    qint64 pageBudget() const { return m_pageBudget; }
+
+    /**
+     * @brief 获取关键帧数量
+     */
+    int keyframeCount() const { return m_keyframes.size(); }
+
+    /**
+     * @brief 获取当前常驻内存的关键帧数量
+     */
+    int residentKeyframeCount() const { return m_residentKeyframes; }
+
+    /**
+     * @brief 获取常驻关键帧估算占用的内存（字节）
+     */
+    qint64 residentKeyframeBytes() const { return m_keyframeBytes; }
+
+    /**
+     * @brief 获取常驻页估算占用的内存（字节）
+     */
+    qint64 residentPageBytes() const { return m_residentBytes; }
+
+private:
+    /**
+     * @brief 一个快照：元数据 + 相对前一个快照的增量
+     */
+    struct Entry {
+        MapSnapshot header;                     ///< 快照元数据（标记集合为空）
+        int markerCount = 0;                    ///< 该时刻的标记数量
+        std::vector<quint32> removedIds;        ///< 删除的标记ID序号
+        std::vector<CompactMarker> upserts;     ///< 新增标记的记录
+        QByteArray patches;                     ///< 已有标记的字段级修改（变长编码）
+        int patchCount = 0;                     ///< 修改的标记数
+        qint64 keyframeCost = 0;                ///< 作为关键帧时与前一个关键帧的差异估算（非关键帧为 0）
+    };
+
+    /**
+     * @brief 一个关键帧
+     */
+    struct Keyframe {
+        int index = 0;                          ///< 快照索引
+        qint64 changeCost = 0;                  ///< 与前一个关键帧的差异估算（同 Entry::keyframeCost）
+        qint64 fullCost = 0;                    ///< 不共享结构时完整集合的估算内存
+        PersistentMarkerMap markers;            ///< 常驻时的标记集合
+        bool resident = false;                  ///< 是否常驻内存
+        quint64 generation = 0;                 ///< 常驻实例的编号（每次重建或读回时更新）
+        quint64 baseGeneration = 0;             ///< 派生自前一个关键帧的哪个实例（0 表示不共享）
+        qint64 memoryCost = 0;                  ///< 常驻时计入预算的估算内存
+        quint64 lastUsed = 0;                   ///< 最近访问的时钟值（LRU）
+        qint64 fileOffset = -1;                 ///< 完整记录在临时文件中的位置（-1 表示尚未写入）
+        qint64 fileSize = 0;                    ///< 在临时文件中的长度
+    };
+
+    /**
+     * @brief 一页快照
+     */
+    struct Page {
+        QVector<Entry> entries;                 ///< 常驻时的快照
+        bool resident = true;                   ///< 是否常驻内存
+        qint64 fileOffset = -1;                 ///< 在临时文件中的位置（-1 表示尚未写入）
+        qint64 fileSize = 0;                    ///< 在临时文件中的长度
+        qint64 memoryCost = 0;                  ///< 常驻时估算的内存
+        quint64 lastUsed = 0;                   ///< 最近访问的时钟值（LRU）
+        QFuture<QVector<Entry>> pending;        ///< 进行中的预读
+    };
+
+    /// 每个变化估算的非共享内存（路径复制的节点）
+    static constexpr qint64 kBytesPerChange = 256;
+    /// 不共享结构时每个标记估算的内存（叶子记录 + 分摊的内部节点）
+    static constexpr qint64 kBytesPerMarker = 64;
+
+    static void replay(const Entry& entry, PersistentMarkerMap& markers);
+    static qint64 entryCost(const Entry& entry);
+    static QByteArray encodePage(const QVector<Entry>& entries);
+    static QVector<Entry> decodePage(const QByteArray& data);
+    static QVector<Entry> readPage(const QString& fileName, qint64 offset, qint64 size);
+    static QByteArray encodeKeyframe(const PersistentMarkerMap& markers);
+    static bool decodeKeyframe(const QByteArray& data, PersistentMarkerMap* markers);
+    static QByteArray readSpill(const QString& fileName, qint64 offset, qint64 size);
+
+    const Entry& entry(int index) const;
+    Page& residentPage(int pageIndex) const;
+    void evictPages(int keepPage) const;
+    bool spillPage(Page& page) const;
+    bool writeSpill(const QByteArray& data, qint64* offset) const;
+    void waitForPrefetch() const;
+    void retainStrings(const CompactMarker& marker);
+    void releaseStrings();
+
+    int keyframeAtOrBefore(int index) const;
+    PersistentMarkerMap keyframeMarkers(int position) const;
+    void makeResident(int position, const PersistentMarkerMap& markers, quint64 baseGeneration) const;
+    qint64 keyframeCost(int position) const;
+    void updateSuccessorCost(int position) const;
+    void evictKeyframes(int keepPosition) const;
+    void spillKeyframe(Keyframe& keyframe) const;
+
+    mutable QVector<Page> m_pages;              ///< 所有页（按快照顺序）
+    int m_size = 0;                             ///< 快照数
+    mutable QVector<Keyframe> m_keyframes;      ///< 所有关键帧（按快照索引升序）
+    PersistentMarkerMap m_latest;               ///< 最新状态
+    int m_changesSinceKeyframe = 0;             ///< 自上一个关键帧累计的变化数
+    int m_snapshotsSinceKeyframe = 0;           ///< 自上一个关键帧经过的快照数
+
+    qint64 m_pageBudget = kDefaultPageBudget;   ///< 常驻页的预算
+    mutable qint64 m_residentBytes = 0;         ///< 常驻页估算占用的内存
+    mutable quint64 m_useClock = 0;             ///< LRU 时钟
+    mutable std::unique_ptr<QTemporaryFile> m_spillFile;   ///< 冷页和关键帧文件（首次换出时创建）
+
+    qint64 m_keyframeBudget = kDefaultMemoryBudget;   ///< 常驻关键帧的预算
+    mutable qint64 m_keyframeBytes = 0;         ///< 常驻关键帧估算占用的内存
+    mutable int m_residentKeyframes = 0;        ///< 常驻关键帧数
+    mutable quint64 m_keyframeGeneration = 0;   ///< 最近分配的常驻实例编号
+    quint64 m_appendGeneration = 0;             ///< 最近追加的关键帧的原始实例编号（与最新状态共享结构）
+    QSet<quint32> m_strings;                    ///< 历史持有引用的字符串序号
+};
+
+#endif // SNAPSHOTHISTORY_H
@@ -0,0 +1,57 @@
+#include "compactmarker.h"
+#include "dataschema.h"
+#include <QTimeZone>
+#include <QtMath>
+
+CompactMarker CompactMarker::fromMarker(const Marker& marker) {
+    return DataSchema::toCompact<Marker, CompactMarker>(marker);
+}
+
+Marker CompactMarker::toMarker() const {
+    return DataSchema::fromCompact<Marker>(*this);
+}
+
+void CompactMarker::retainStrings() const {
+    DataSchema::retainCompact<Marker>(*this);
+}
+
+void CompactMarker::releaseStrings() const {
+    DataSchema::releaseCompact<Marker>(*this);
+}
+
+bool CompactMarker::operator==(const CompactMarker& other) const {
+    return DataSchema::compactEquals<Marker>(*this, other);
+}
+
+qint32 CompactMarker::timeOffsetOf(const QDateTime& time) {
+    // 本地时间不带时区后缀，偏移随夏令时变化，不能按固定偏移保存
+    if (!time.isValid() || time.timeSpec() == Qt::LocalTime) {
+        return kLocalTime;
+    }
+    return time.offsetFromUtc();
+}
+
+QDateTime CompactMarker::toDateTime(qint64 msecs, qint32 offset) {
+    if (msecs == kInvalidTime) {
+        return QDateTime();
+    }
+    if (offset == kLocalTime) {
+        return QDateTime::fromMSecsSinceEpoch(msecs);
+    }
+    return QDateTime::fromMSecsSinceEpoch(msecs, QTimeZone::fromSecondsAheadOfUtc(offset));
+}
+
+CompactTime CompactTime::fromDateTime(const QDateTime& time) {
+    return CompactTime{time.isValid() ? time.toMSecsSinceEpoch() : CompactMarker::kInvalidTime,
+                       CompactMarker::timeOffsetOf(time)};
+}
+
+qint32 CompactMarker::toFixed(double value) {
+    if (qIsNaN(value)) {
+        return 0;
+    }
+    const double scaled = qBound<double>(std::numeric_limits<qint32>::min(),
+                                         value * kCoordinateScale,
+                                         std::numeric_limits<qint32>::max());
+    return static_cast<qint32>(qRound64(scaled));
+}
@@ -0,0 +1,117 @@
+#ifndef COMPACTMARKER_H
+#define COMPACTMARKER_H
+
+#include <QColor>
+#include <QPointF>
+#include <QtGlobal>
+#include <limits>
+
+#include "marker.h"
+
+/**
+ * @struct CompactMarker
+ * @brief 紧凑的标记记录（40 字节，无堆内存）
+ *
+ * 与 Marker 表示同样的数据，用于历史存储和批量处理：
+ * - 字符串（ID、备注、创建者）存为全局字符串池 StringPool::markerStrings() 中的序号，
+ *   记录本身不计引用，由保存它的容器调用 retainStrings() / releaseStrings()
+ * - 坐标存为 32 位定点数（单位 1e-9），展开后输出最多 9 位小数
+ * - 颜色存为打包的 ARGB，时间存为毫秒时间戳加上与 UTC 的偏移，
+ *   展开后的时区写法（本地时间 / "Z" / "+08:00"）与原来一致
+ *
+ * Marker 仍然是对外的接口，需要时通过 toMarker() 展开。
+ * 各成员与 Marker 字段的对应关系在 Schema<Marker>（dataschema.h）中声明，
+ * 转换、比较和各种编码都由这份声明生成。
+ */
+struct CompactMarker {
+    quint32 id = 0;             ///< 标记ID的字符串序号
+    qint32 x = 0;               ///< 归一化 x 坐标（定点数）
+    qint32 y = 0;               ///< 归一化 y 坐标（定点数）
+    QRgb color = 0;             ///< 颜色（ARGB）
+    qint64 createTime = kInvalidTime;   ///< 创建时间（毫秒时间戳）
+    qint32 timeOffset = kLocalTime;     ///< 创建时间与 UTC 的偏移（秒），kLocalTime 表示本地时间
+    quint32 note = 0;           ///< 备注的字符串序号
+    quint32 createdBy = 0;      ///< 创建者的字符串序号
+
+    static constexpr qint64 kInvalidTime = std::numeric_limits<qint64>::min();  ///< 无效时间
+    static constexpr qint32 kLocalTime = std::numeric_limits<qint32>::min();     ///< 时间偏移：本地时间
+    static constexpr double kCoordinateScale = 1e9;                              ///< 定点数缩放系数
+
+    /**
+     * @brief 从 Marker 创建紧凑记录（驻留字符串）
+     * @param marker 标记
+     * @return 紧凑记录
+     */
+    static CompactMarker fromMarker(const Marker& marker);
+
+    /**
+     * @brief 展开为 Marker
+     * @return 标记对象
+     */
+    Marker toMarker() const;
+
+    /**
+     * @brief 时间对应的 UTC 偏移
+     * @return 与 UTC 的偏移（秒），本地时间返回 kLocalTime
+     */
+    static qint32 timeOffsetOf(const QDateTime& time);
+
+    /**
+     * @brief 由毫秒时间戳和 UTC 偏移还原时间
+     * @param msecs 毫秒时间戳，kInvalidTime 表示无效时间
+     * @param offset 与 UTC 的偏移（秒），kLocalTime 表示本地时间
+     */
+    static QDateTime toDateTime(qint64 msecs, qint32 offset);
+
+    /**
+     * @brief 将归一化坐标转换为定点数
+     */
+    static qint32 toFixed(double value);
+
+    /**
+     * @brief 将定点数转换为归一化坐标
+     */
+    static double fromFixed(qint32 value) { return value / kCoordinateScale; }
+
+    /**
+     * @brief 增加字符串（ID、备注、创建者）的引用计数，由长期保存记录的容器调用
+     */
+    void retainStrings() const;
+
+    /**
+     * @brief 减少字符串的引用计数，与 retainStrings() 成对调用
+     */
+    void releaseStrings() const;
+
+    /**
+     * @brief 获取归一化坐标
+     */
+    QPointF position() const { return QPointF(fromFixed(x), fromFixed(y)); }
+
+    bool operator==(const CompactMarker& other) const;
+    bool operator!=(const CompactMarker& other) const { return !(*this == other); }
+};
+
+/**
+ * @struct CompactTime
+ * @brief 紧凑的时间：毫秒时间戳 + 与 UTC 的偏移（对应 CompactMarker 的 createTime / timeOffset）
+ */
+struct CompactTime {
+    qint64 msecs = CompactMarker::kInvalidTime;     ///< 毫秒时间戳，kInvalidTime 表示无效时间
+    qint32 offset = CompactMarker::kLocalTime;      ///< 与 UTC 的偏移（秒），kLocalTime 表示本地时间
+
+    /**
+     * @brief 由时间创建
+     */
+    static CompactTime fromDateTime(const QDateTime& time);
+
+    /**
+     * @brief 还原为时间
+     */
+    QDateTime toDateTime() const { return CompactMarker::toDateTime(msecs, offset); }
+
+    bool operator==(const CompactTime& other) const { return msecs == other.msecs && offset == other.offset; }
+    bool operator!=(const CompactTime& other) const { return !(*this == other); }
+static_assert(sizeof(CompactMarker) == 40, "CompactMarker should stay 40 bytes");
+
+#endif // COMPACTMARKER_H
@@ -0,0 +1,404 @@
+#include "dataschema.h"
+#include "compactmarker.h"
+#include "stringpool.h"
+#include <QStringEncoder>
+#include <limits>
+
+namespace DataSchema {
+
+bool readCborString(QCborStreamReader& reader, QString* text) {
+    text->clear();
+    if (!reader.isString()) {
+        return reader.next();
+    }
+    auto chunk = reader.readString();
+    while (chunk.status == QCborStreamReader::Ok) {
+        text->append(chunk.data);
+        chunk = reader.readString();
+    }
+    return chunk.status == QCborStreamReader::EndOfString;
+}
+
+// ========== 紧凑二进制 ==========
+
+namespace {
+
+int varintSize(quint64 value) {
+    int size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++size;
+    }
+    return size;
+}
+
+char* writeVarint(char* out, quint64 value) {
+    while (value >= 0x80) {
+        *out++ = static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<char>(value);
+    return out;
+}
+
+quint64 zigzag(qint64 value) {
+    return (quint64(value) << 1) ^ quint64(value >> 63);
+}
+
+qint64 unzigzag(quint64 value) {
+    return qint64(value >> 1) ^ -qint64(value & 1);
+}
+
+} // namespace
+
+void writeVarint(QByteArray& out, quint64 value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+void writeString(QByteArray& out, QStringView text) {
+    // 按最坏情况（每个 UTF-16 单元 3 字节）留出空间，直接编码到输出中，
+    // 得到实际长度后写入前缀；前缀比预留的短时把文本前移
+    const qsizetype start = out.size();
+    const quint64 bound = quint64(text.size()) * 3;
+    const int prefixBound = varintSize(bound);
+    out.resize(start + prefixBound + qsizetype(bound));
+
+    char* const utf8 = out.data() + start + prefixBound;
+    QStringEncoder encoder(QStringEncoder::Utf8);
+    const qsizetype length = encoder.appendToBuffer(utf8, text) - utf8;
+
+    char* const prefixEnd = writeVarint(out.data() + start, quint64(length));
+    if (prefixEnd != utf8) {
+        std::memmove(prefixEnd, utf8, size_t(length));
+    }
+    out.resize(qsizetype(prefixEnd - out.constData()) + length);
+}
+
+bool BinaryReader::readVarint(quint64* value) {
+    quint64 result = 0;
+    for (int shift = 0; shift < 64 && pos != end; shift += 7) {
+        const uchar byte = static_cast<uchar>(*pos++);
+        result |= quint64(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BinaryReader::readBytes(qsizetype count, const char** bytes) {
+    if (count < 0 || end - pos < count) {
+        return false;
+    }
+    *bytes = pos;
+    pos += count;
+    return true;
+}
+
+// ========== QString ==========
+
+void ValueTraits<QString>::writeBinary(QByteArray& out, const QString& value) {
+    writeString(out, value);
+}
+
+bool ValueTraits<QString>::readBinary(BinaryReader& reader, QString* value) {
+    quint64 length = 0;
+    const char* bytes = nullptr;
+    if (!reader.readVarint(&length) || length > quint64(reader.end - reader.pos)
+        || !reader.readBytes(qsizetype(length), &bytes)) {
+        return false;
+    }
+    *value = QString::fromUtf8(bytes, qsizetype(length));
+    return true;
+}
+
+quint32 ValueTraits<QString>::toCompact(const QString& value) {
+    return StringPool::markerStrings().intern(value);
+}
+
+QString ValueTraits<QString>::fromCompact(quint32 value) {
+    return StringPool::markerStrings().at(value);
+}
+
+void ValueTraits<QString>::writeCompactCbor(QCborStreamWriter& writer, quint32 value) {
+    writer.append(StringPool::markerStrings().at(value));
+}
+
+void ValueTraits<QString>::writeCompactBinary(QByteArray& out, quint32 value) {
+    writeString(out, StringPool::markerStrings().at(value));
+}
+
+bool ValueTraits<QString>::readCompactBinary(BinaryReader& reader, quint32* value) {
+    QString text;
+    if (!readBinary(reader, &text)) {
+        return false;
+    }
+    *value = toCompact(text);
+    return true;
+}
+
+void ValueTraits<QString>::writeCompactDelta(QByteArray& out, quint32, quint32 after) {
+    writeVarint(out, after);
+}
+
+bool ValueTraits<QString>::readCompactDelta(BinaryReader& reader, quint32, quint32* after) {
+    quint64 index = 0;
+    if (!reader.readVarint(&index) || index > std::numeric_limits<quint32>::max()) {
+        return false;
+    }
+    *after = quint32(index);
+    return true;
+}
+
+void ValueTraits<QString>::retainCompact(quint32 value) {
+    StringPool::markerStrings().retain(value);
+}
+
+void ValueTraits<QString>::releaseCompact(quint32 value) {
+    StringPool::markerStrings().release(value);
+}
+
+// ========== double ==========
+
+bool ValueTraits<double>::readCbor(QCborStreamReader& reader, double* value) {
+    if (reader.isDouble()) {
+        *value = reader.toDouble();
+    } else if (reader.isFloat()) {
+        *value = reader.toFloat();
+    } else if (reader.isFloat16()) {
+        *value = reader.toFloat16();
+    } else if (reader.isInteger()) {
+        *value = double(reader.toInteger());
+    } else {
+        *value = 0;
+    }
+    return reader.next();
+}
+
+void ValueTraits<double>::writeBinary(QByteArray& out, double value) {
+    quint64 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    writeFixed<quint64>(out, bits);
+}
+
+bool ValueTraits<double>::readBinary(BinaryReader& reader, double* value) {
+    quint64 bits = 0;
+    if (!reader.readFixed(&bits)) {
+        return false;
+    }
+    std::memcpy(value, &bits, sizeof(bits));
+    return true;
+}
+
+bool ValueTraits<double>::readCompactBinary(BinaryReader& reader, qint32* value) {
+    double coordinate = 0;
+    if (!readBinary(reader, &coordinate)) {
+        return false;
+    }
+    *value = toCompact(coordinate);
+    return true;
+}
+
+void ValueTraits<double>::writeCompactDelta(QByteArray& out, qint32 before, qint32 after) {
+    writeVarint(out, zigzag(qint64(after) - before));
+}
+
+bool ValueTraits<double>::readCompactDelta(BinaryReader& reader, qint32 before, qint32* after) {
+    quint64 delta = 0;
+    if (!reader.readVarint(&delta)) {
+        return false;
+    }
+    *after = qint32(before + unzigzag(delta));
+    return true;
+}
+
+// ========== QColor ==========
+
+bool ValueTraits<QColor>::readCbor(QCborStreamReader& reader, QColor* value) {
+    *value = reader.isUnsignedInteger() ? QColor::fromRgba(QRgb(reader.toUnsignedInteger()))
+                                        : QColor();
+    return reader.next();
+}
+
+bool ValueTraits<QColor>::readBinary(BinaryReader& reader, QColor* value) {
+    quint32 rgba = 0;
+    if (!reader.readFixed(&rgba)) {
+        return false;
+    }
+    *value = QColor::fromRgba(rgba);
+    return true;
+}
+
+bool ValueTraits<QColor>::readCompactDelta(BinaryReader& reader, QRgb, QRgb* after) {
+    quint64 rgba = 0;
+    if (!reader.readVarint(&rgba) || rgba > std::numeric_limits<quint32>::max()) {
+        return false;
+    }
+    *after = QRgb(rgba);
+    return true;
+}
+
+// ========== QDateTime ==========
+
+void ValueTraits<QDateTime>::writeCompactCbor(QCborStreamWriter& writer, const CompactTime& value) {
+    if (value.msecs == CompactMarker::kInvalidTime) {
+        writer.append(nullptr);
+        return;
+    }
+    writer.startArray(2);
+    writer.append(value.msecs);
+    writer.append(qint64(value.offset));
+    writer.endArray();
+}
+
+bool ValueTraits<QDateTime>::readCbor(QCborStreamReader& reader, QDateTime* value) {
+    *value = QDateTime();
+    if (reader.isInteger()) {
+        // 只有毫秒时间戳：按本地时间解释
+        *value = QDateTime::fromMSecsSinceEpoch(reader.toInteger());
+        return reader.next();
+    }
+    if (!reader.isArray()) {
+        return reader.next();
+    }
+    if (!reader.enterContainer()) {
+        return false;
+    }
+
+    qint64 parts[2] = {0, CompactMarker::kLocalTime};
+    int count = 0;
+    while (reader.hasNext()) {
+        if (count < 2 && reader.isInteger()) {
+            parts[count] = reader.toInteger();
+        }
+        ++count;
+        if (!reader.next()) {
+            return false;
+        }
+    }
+    if (count >= 1 && parts[1] >= std::numeric_limits<qint32>::min()
+        && parts[1] <= std::numeric_limits<qint32>::max()) {
+        *value = CompactMarker::toDateTime(parts[0], qint32(parts[1]));
+    }
+    return reader.leaveContainer();
+}
+
+bool ValueTraits<QDateTime>::readBinary(BinaryReader& reader, QDateTime* value) {
+    CompactTime time;
+    if (!readCompactBinary(reader, &time)) {
+        return false;
+    }
+    *value = fromCompact(time);
+    return true;
+}
+
+void ValueTraits<QDateTime>::writeCompactBinary(QByteArray& out, const CompactTime& value) {
+    writeFixed<qint64>(out, value.msecs);
+    writeFixed<qint32>(out, value.offset);
+}
+
+bool ValueTraits<QDateTime>::readCompactBinary(BinaryReader& reader, CompactTime* value) {
+    return reader.readFixed(&value->msecs) && reader.readFixed(&value->offset);
+}
+
+void ValueTraits<QDateTime>::writeCompactDelta(QByteArray& out, const CompactTime& before,
+                                               const CompactTime& after) {
+    // 无效时间是 INT64_MIN，差值按无符号回绕计算
+    writeVarint(out, zigzag(qint64(quint64(after.msecs) - quint64(before.msecs))));
+    writeVarint(out, zigzag(after.offset));
+}
+
+bool ValueTraits<QDateTime>::readCompactDelta(BinaryReader& reader, const CompactTime& before,
+                                              CompactTime* after) {
+    quint64 delta = 0;
+    quint64 offset = 0;
+    if (!reader.readVarint(&delta) || !reader.readVarint(&offset)) {
+        return false;
+    }
+    const qint64 decodedOffset = unzigzag(offset);
+    if (decodedOffset < std::numeric_limits<qint32>::min()
+        || decodedOffset > std::numeric_limits<qint32>::max()) {
+        return false;
+    }
+    after->msecs = qint64(quint64(before.msecs) + quint64(unzigzag(delta)));
+    after->offset = qint32(decodedOffset);
+    return true;
+}
+
+// ========== PersistentMarkerMap ==========
+
+QJsonValue ValueTraits<PersistentMarkerMap>::toJson(const PersistentMarkerMap& value) {
+    QJsonArray array;
+    value.forEach([&array](const Marker& marker) {
+        array.append(DataSchema::toJson(marker));
+    });
+    return array;
+}
+
+PersistentMarkerMap ValueTraits<PersistentMarkerMap>::fromJson(const QJsonValue& json) {
+    PersistentMarkerMap markers;
+    for (const QJsonValue& value : json.toArray()) {
+        markers.insert(DataSchema::fromJson<Marker>(value.toObject()));
+    }
+    return markers;
+}
+
+void ValueTraits<PersistentMarkerMap>::writeCbor(QCborStreamWriter& writer,
+                                                 const PersistentMarkerMap& value) {
+    writer.startArray(quint64(value.size()));
+    value.forEachCompact([&writer](const CompactMarker& marker) {
+        DataSchema::writeCompactCbor<Marker>(writer, marker);
+    });
+    writer.endArray();
+}
+
+bool ValueTraits<PersistentMarkerMap>::readCbor(QCborStreamReader& reader,
+                                                PersistentMarkerMap* value) {
+    *value = PersistentMarkerMap();
+    if (!reader.isArray()) {
+        return reader.next();
+    }
+    if (!reader.enterContainer()) {
+        return false;
+    }
+    while (reader.hasNext()) {
+        Marker marker;
+        if (!DataSchema::readCbor(reader, &marker)) {
+            return false;
+        }
+        value->insert(marker);
+    }
+    return reader.leaveContainer();
+}
+
+void ValueTraits<PersistentMarkerMap>::writeBinary(QByteArray& out,
+                                                   const PersistentMarkerMap& value) {
+    writeVarint(out, quint64(value.size()));
+    value.forEachCompact([&out](const CompactMarker& marker) {
+        DataSchema::writeCompactBinary<Marker>(out, marker);
+    });
+}
+
+bool ValueTraits<PersistentMarkerMap>::readBinary(BinaryReader& reader,
+                                                  PersistentMarkerMap* value) {
+    quint64 count = 0;
+    if (!reader.readVarint(&count)) {
+        return false;
+    }
+    *value = PersistentMarkerMap();
+    for (quint64 i = 0; i < count; ++i) {
+        CompactMarker marker;
+        if (!DataSchema::readCompactBinary<Marker>(reader, &marker)) {
+            return false;
+        }
+        value->insert(marker);
+    }
+    return true;
+}
+
+} // namespace DataSchema
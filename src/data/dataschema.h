@@ -0,0 +1,786 @@
+#ifndef DATASCHEMA_H
+#define DATASCHEMA_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QCborStreamReader>
+#include <QCborStreamWriter>
+#include <QColor>
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QString>
+#include <QStringView>
+#include <QVector>
+#include <QtEndian>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "compactmarker.h"
+#include "marker.h"
+#include "mapsnapshot.h"
+#include "persistentmarkermap.h"
+
+/**
+ * @namespace DataSchema
+ * @brief 数据类型的字段描述与由此生成的编解码器
+ *
+ * 每个数据类型在 Schema<T>::fields() 中用一行声明一个字段（键名 + 读写函数），
+ * 下列编解码器都由这份声明生成，增删字段时无需修改编解码代码：
+ * - JSON（QJsonObject）：toJson() / fromJson()
+ * - JSON（流式）：MapJsonCodec 通过 forEachField() / findField() 分派字段
+ * - CBOR：toCbor() / fromCbor()，键名与 JSON 相同
+ * - 紧凑二进制：toBinary() / fromBinary()，按声明顺序存放字段值，不含键名
+ *
+ * 字段必须按键名升序声明（编译期检查），使流式 JSON 的输出顺序
+ * 与 QJsonObject 相同。字段值的编码由 ValueTraits<V> 提供。
+ *
+ * 用 compactField() 声明的字段还对应紧凑记录（如 CompactMarker）中的紧凑值
+ * （类型为 ValueTraits<V>::Compact），紧凑记录的以下操作同样由声明生成：
+ * 与对象互相转换、CBOR / 二进制编码（输出与对象相同）、列式存储（CompactColumns）
+ * 和字段级修改（writeCompactPatch() / applyCompactPatch()）。
+ */
+namespace DataSchema {
+
+/**
+ * @brief 字段描述：键名和读写函数
+ */
+template <typename Owner, typename Value>
+struct Field {
+    using OwnerType = Owner;
+    using ValueType = Value;
+
+    const char* name;                   ///< 键名（ASCII）
+    int nameLength;                     ///< 键名长度
+    Value (*get)(const Owner&);         ///< 读取字段值
+    void (*set)(Owner&, Value);         ///< 写入字段值
+};
+
+constexpr int nameLength(const char* name) {
+    int length = 0;
+    while (name[length] != '\0') {
+        ++length;
+    }
+    return length;
+}
+
+/**
+ * @brief 声明一个字段
+ * @param name 键名
+ * @param get 读取函数
+ * @param set 写入函数
+ */
+template <typename Owner, typename Value>
+constexpr Field<Owner, Value> field(const char* name,
+                                    Value (*get)(const Owner&),
+                                    void (*set)(Owner&, Value)) {
+    return Field<Owner, Value>{name, nameLength(name), get, set};
+}
+
+/// 声明一个直接对应成员变量的字段
+#define DATA_SCHEMA_MEMBER(Owner, Type, key, member)                        \
+    DataSchema::field<Owner, Type>(key,                                     \
+        [](const Owner& object) -> Type { return object.member; },         \
+        [](Owner& object, Type value) { object.member = std::move(value); })
+
+/**
+ * @brief 字段值的编解码（按值类型特化）
+ */
+template <typename V>
+struct ValueTraits;
+
+/// 字段值的紧凑表示
+template <typename V>
+using CompactOf = typename ValueTraits<V>::Compact;
+
+/**
+ * @brief 带紧凑表示的字段：另有读写紧凑记录中对应值的函数
+ */
+template <typename Owner, typename Value, typename Record>
+struct CompactField : Field<Owner, Value> {
+    using RecordType = Record;
+    using CompactType = CompactOf<Value>;
+
+    CompactType (*getCompact)(const Record&);   ///< 读取紧凑值
+    void (*setCompact)(Record&, CompactType);   ///< 写入紧凑值
+};
+
+/**
+ * @brief 为字段附加紧凑记录的读写函数
+ * @param base field() 声明的字段
+ * @param getCompact 从紧凑记录读取紧凑值
+ * @param setCompact 向紧凑记录写入紧凑值
+ */
+template <typename Record, typename Owner, typename Value>
+constexpr CompactField<Owner, Value, Record> compactField(
+    Field<Owner, Value> base,
+    CompactOf<Value> (*getCompact)(const Record&),
+    void (*setCompact)(Record&, CompactOf<Value>)) {
+    return CompactField<Owner, Value, Record>{base, getCompact, setCompact};
+}
+
+/// 声明一个字段，对象和紧凑记录中都直接对应成员变量
+#define DATA_SCHEMA_COMPACT_MEMBER(Owner, Type, key, member, Record, recordMember)      \
+    DataSchema::compactField<Record>(DATA_SCHEMA_MEMBER(Owner, Type, key, member),       \
+        [](const Record& record) -> DataSchema::CompactOf<Type> { return record.recordMember; }, \
+        [](Record& record, DataSchema::CompactOf<Type> value) { record.recordMember = value; })
+
+/**
+ * @brief 数据类型的字段声明（按类型特化）
+ *
+ * 特化需提供 static constexpr auto fields()，返回 field()（或 compactField()）组成的 std::tuple。
+ */
+template <typename T>
+struct Schema;
+
+// ========== 字段遍历 ==========
+
+/**
+ * @brief 按声明顺序访问类型的每个字段描述
+ * @param visitor 以字段描述为参数的函数
+ */
+template <typename T, typename Visitor>
+constexpr void forEachField(Visitor&& visitor) {
+    std::apply([&visitor](const auto&... fields) { (visitor(fields), ...); },
+               Schema<T>::fields());
+}
+
+/**
+ * @brief 字段数量
+ */
+template <typename T>
+constexpr int fieldCount() {
+    return static_cast<int>(std::tuple_size<decltype(Schema<T>::fields())>::value);
+}
+
+/**
+ * @brief 按键名查找字段
+ * @param key 键名（UTF-8）
+ * @param visitor 找到时以字段描述为参数调用
+ * @return 找到返回 true
+ */
+template <typename T, typename Visitor>
+bool findField(QByteArrayView key, Visitor&& visitor) {
+    bool found = false;
+    forEachField<T>([&](const auto& field) {
+        if (!found && key.size() == field.nameLength
+            && std::memcmp(key.data(), field.name, field.nameLength) == 0) {
+            found = true;
+            visitor(field);
+        }
+    });
+    return found;
+}
+
+/**
+ * @brief 按键名查找字段
+ * @param key 键名
+ * @param visitor 找到时以字段描述为参数调用
+ * @return 找到返回 true
+ */
+template <typename T, typename Visitor>
+bool findField(QStringView key, Visitor&& visitor) {
+    bool found = false;
+    forEachField<T>([&](const auto& field) {
+        if (!found && key.compare(QLatin1String(field.name, field.nameLength)) == 0) {
+            found = true;
+            visitor(field);
+        }
+    });
+    return found;
+}
+
+constexpr int compareNames(const char* a, const char* b) {
+    while (*a != '\0' && *a == *b) {
+        ++a;
+        ++b;
+    }
+    return static_cast<unsigned char>(*a) - static_cast<unsigned char>(*b);
+}
+
+/**
+ * @brief 字段是否按键名严格升序声明
+ */
+template <typename T>
+constexpr bool isSorted() {
+    const char* previous = nullptr;
+    bool sorted = true;
+    forEachField<T>([&](const auto& field) {
+        sorted = sorted && (previous == nullptr || compareNames(previous, field.name) < 0);
+        previous = field.name;
+    });
+    return sorted;
+}
+
+/**
+ * @brief 按键名查找字段的声明序号（编译期）
+ * @return 序号，不存在返回 -1
+ */
+template <typename T>
+constexpr int fieldIndex(const char* name) {
+    int index = 0;
+    int found = -1;
+    forEachField<T>([&](const auto& field) {
+        if (found < 0 && compareNames(name, field.name) == 0) {
+            found = index;
+        }
+        ++index;
+    });
+    return found;
+}
+
+// ========== JSON（QJsonObject） ==========
+
+template <typename T>
+QJsonObject toJson(const T& object) {
+    QJsonObject json;
+    forEachField<T>([&](const auto& field) {
+        using V = typename std::decay_t<decltype(field)>::ValueType;
+        json.insert(QLatin1String(field.name, field.nameLength),
+                    ValueTraits<V>::toJson(field.get(object)));
+    });
+    return json;
+}
+
+template <typename T>
+T fromJson(const QJsonObject& json) {
+    T object;
+    forEachField<T>([&](const auto& field) {
+        using V = typename std::decay_t<decltype(field)>::ValueType;
+        field.set(object, ValueTraits<V>::fromJson(
+                              json.value(QLatin1String(field.name, field.nameLength))));
+    });
+    return object;
+}
+
+// ========== CBOR ==========
+
+/**
+ * @brief 读取一个 CBOR 字符串（分段读取并拼接）
+ * @return 读取成功返回 true；不是字符串时跳过该元素并返回空字符串
+ */
+bool readCborString(QCborStreamReader& reader, QString* text);
+
+template <typename T>
+void writeCbor(QCborStreamWriter& writer, const T& object) {
+    writer.startMap(fieldCount<T>());
+    forEachField<T>([&](const auto& field) {
+        using V = typename std::decay_t<decltype(field)>::ValueType;
+        writer.append(QLatin1String(field.name, field.nameLength));
+        ValueTraits<V>::writeCbor(writer, field.get(object));
+    });
+    writer.endMap();
+}
+
+template <typename T>
+bool readCbor(QCborStreamReader& reader, T* object) {
+    if (!reader.isMap()) {
+        return reader.next();
+    }
+    if (!reader.enterContainer()) {
+        return false;
+    }
+    while (reader.hasNext()) {
+        QString key;
+        if (!readCborString(reader, &key)) {
+            return false;
+        }
+        bool ok = true;
+        const bool found = findField<T>(QStringView(key), [&](const auto& field) {
+            using V = typename std::decay_t<decltype(field)>::ValueType;
+            V value{};
+            ok = ValueTraits<V>::readCbor(reader, &value);
+            field.set(*object, std::move(value));
+        });
+        if (!found) {
+            ok = reader.next();    // 未知字段
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return reader.leaveContainer();
+}
+
+/**
+ * @brief 编码为 CBOR
+ * @param object 对象
+ * @return CBOR 数据
+ */
+template <typename T>
+QByteArray toCbor(const T& object) {
+    QByteArray data;
+    QCborStreamWriter writer(&data);
+    writeCbor(writer, object);
+    return data;
+}
+
+/**
+ * @brief 从 CBOR 解码
+ * @param data CBOR 数据
+ * @param object 输出的对象
+ * @return 成功返回 true
+ */
+template <typename T>
+bool fromCbor(const QByteArray& data, T* object) {
+    QCborStreamReader reader(data);
+    T result;
+    if (!readCbor(reader, &result) || reader.lastError() != QCborError::NoError) {
+        return false;
+    }
+    *object = std::move(result);
+    return true;
+}
+
+// ========== 紧凑二进制 ==========
+
+/**
+ * @brief 二进制数据读取游标（带边界检查）
+ */
+struct BinaryReader {
+    const char* pos;
+    const char* end;
+
+    bool readVarint(quint64* value);
+    bool readBytes(qsizetype count, const char** bytes);
+
+    template <typename Integer>
+    bool readFixed(Integer* value) {
+        const char* bytes = nullptr;
+        if (!readBytes(sizeof(Integer), &bytes)) {
+            return false;
+        }
+        *value = qFromLittleEndian<Integer>(bytes);
+        return true;
+    }
+};
+
+void writeVarint(QByteArray& out, quint64 value);
+
+/**
+ * @brief 写入字符串：UTF-8 字节数（变长整数）+ UTF-8 字节
+ *
+ * 直接编码到 out 中，不产生临时的 QByteArray。
+ */
+void writeString(QByteArray& out, QStringView text);
+
+template <typename Integer>
+void writeFixed(QByteArray& out, Integer value) {
+    char bytes[sizeof(Integer)];
+    qToLittleEndian(value, bytes);
+    out.append(bytes, sizeof(Integer));
+}
+
+template <typename T>
+void writeBinary(QByteArray& out, const T& object) {
+    forEachField<T>([&](const auto& field) {
+        using V = typename std::decay_t<decltype(field)>::ValueType;
+        ValueTraits<V>::writeBinary(out, field.get(object));
+    });
+}
+
+template <typename T>
+bool readBinary(BinaryReader& reader, T* object) {
+    bool ok = true;
+    forEachField<T>([&](const auto& field) {
+        using V = typename std::decay_t<decltype(field)>::ValueType;
+        if (ok) {
+            V value{};
+            ok = ValueTraits<V>::readBinary(reader, &value);
+            field.set(*object, std::move(value));
+        }
+    });
+    return ok;
+}
+
+/**
+ * @brief 编码为紧凑二进制（开头记录字段数，用于识别不兼容的数据）
+ * @param object 对象
+ * @return 二进制数据
+ */
+template <typename T>
+QByteArray toBinary(const T& object) {
+    QByteArray data;
+    writeVarint(data, fieldCount<T>());
+    writeBinary(data, object);
+    return data;
+}
+
+/**
+ * @brief 从紧凑二进制解码
+ * @param data 二进制数据
+ * @param object 输出的对象
+ * @return 成功（字段数一致且数据完整）返回 true
+ */
+template <typename T>
+bool fromBinary(const QByteArray& data, T* object) {
+    BinaryReader reader{data.constData(), data.constData() + data.size()};
+    quint64 count = 0;
+    T result;
+    if (!reader.readVarint(&count) || count != quint64(fieldCount<T>())
+        || !readBinary(reader, &result) || reader.pos != reader.end) {
+        return false;
+    }
+    *object = std::move(result);
+    return true;
+}
+
+// ========== 字段值 ==========
+
+/*
+ * 每个 ValueTraits<V> 还提供紧凑表示（Compact）上的同一套编码：
+ * toCompact() / fromCompact()、writeCompactCbor() / writeCompactBinary() / readCompactBinary()
+ * （输出与对应的 V 相同），字段级修改使用的 writeCompactDelta() / readCompactDelta()，
+ * 以及持有紧凑值时的 retainCompact() / releaseCompact()（字符串的引用计数，其他类型为空操作）。
+ */
+
+/// 字符串：紧凑表示为 StringPool::markerStrings() 中的序号
+template <>
+struct ValueTraits<QString> {
+    using Compact = quint32;
+
+    static QJsonValue toJson(const QString& value) { return value; }
+    static QString fromJson(const QJsonValue& json) { return json.toString(); }
+    static void writeCbor(QCborStreamWriter& writer, const QString& value) { writer.append(value); }
+    static bool readCbor(QCborStreamReader& reader, QString* value) { return readCborString(reader, value); }
+    static void writeBinary(QByteArray& out, const QString& value);
+    static bool readBinary(BinaryReader& reader, QString* value);
+
+    static Compact toCompact(const QString& value);
+    static QString fromCompact(Compact value);
+    static void writeCompactCbor(QCborStreamWriter& writer, Compact value);
+    static void writeCompactBinary(QByteArray& out, Compact value);
+    static bool readCompactBinary(BinaryReader& reader, Compact* value);
+    static void writeCompactDelta(QByteArray& out, Compact before, Compact after);
+    static bool readCompactDelta(BinaryReader& reader, Compact before, Compact* after);
+    static void retainCompact(Compact value);
+    static void releaseCompact(Compact value);
+};
+
+/// 归一化坐标：紧凑表示为 32 位定点数（见 CompactMarker::toFixed()）
+template <>
+struct ValueTraits<double> {
+    using Compact = qint32;
+
+    static QJsonValue toJson(double value) { return value; }
+    static double fromJson(const QJsonValue& json) { return json.toDouble(); }
+    static void writeCbor(QCborStreamWriter& writer, double value) { writer.append(value); }
+    static bool readCbor(QCborStreamReader& reader, double* value);
+    static void writeBinary(QByteArray& out, double value);
+    static bool readBinary(BinaryReader& reader, double* value);
+
+    static Compact toCompact(double value) { return CompactMarker::toFixed(value); }
+    static double fromCompact(Compact value) { return CompactMarker::fromFixed(value); }
+    static void writeCompactCbor(QCborStreamWriter& writer, Compact value) { writer.append(fromCompact(value)); }
+    static void writeCompactBinary(QByteArray& out, Compact value) { writeBinary(out, fromCompact(value)); }
+    static bool readCompactBinary(BinaryReader& reader, Compact* value);
+    static void writeCompactDelta(QByteArray& out, Compact before, Compact after);
+    static bool readCompactDelta(BinaryReader& reader, Compact before, Compact* after);
+    static void retainCompact(Compact) {}
+    static void releaseCompact(Compact) {}
+};
+
+/// 颜色：JSON 中为 "#rrggbb"，CBOR 和二进制中为 ARGB 整数；紧凑表示为 ARGB
+template <>
+struct ValueTraits<QColor> {
+    using Compact = QRgb;
+
+    static QJsonValue toJson(const QColor& value) { return value.name(); }
+    static QColor fromJson(const QJsonValue& json) { return QColor(json.toString()); }
+    static void writeCbor(QCborStreamWriter& writer, const QColor& value) { writeCompactCbor(writer, value.rgba()); }
+    static bool readCbor(QCborStreamReader& reader, QColor* value);
+    static void writeBinary(QByteArray& out, const QColor& value) { writeCompactBinary(out, value.rgba()); }
+    static bool readBinary(BinaryReader& reader, QColor* value);
+
+    static Compact toCompact(const QColor& value) { return value.rgba(); }
+    static QColor fromCompact(Compact value) { return QColor::fromRgba(value); }
+    static void writeCompactCbor(QCborStreamWriter& writer, Compact value) { writer.append(quint64(value)); }
+    static void writeCompactBinary(QByteArray& out, Compact value) { writeFixed<quint32>(out, value); }
+    static bool readCompactBinary(BinaryReader& reader, Compact* value) { return reader.readFixed<quint32>(value); }
+    static void writeCompactDelta(QByteArray& out, Compact, Compact after) { writeVarint(out, after); }
+    static bool readCompactDelta(BinaryReader& reader, Compact before, Compact* after);
+    static void retainCompact(Compact) {}
+    static void releaseCompact(Compact) {}
+};
+
+/**
+ * 时间：JSON 中为 ISO 8601；CBOR 中为 [毫秒时间戳, UTC 偏移（秒）]，无效时间为 null；
+ * 二进制中为 64 位毫秒时间戳（无效时间为 INT64_MIN）加 32 位 UTC 偏移。
+ * 紧凑表示为 CompactTime，本地时间的偏移为 CompactMarker::kLocalTime，
+ * 解码后的时区写法（本地时间 / "Z" / "+08:00"）与原来一致。
+ */
+template <>
+struct ValueTraits<QDateTime> {
+    using Compact = CompactTime;
+
+    static QJsonValue toJson(const QDateTime& value) { return value.toString(Qt::ISODate); }
+    static QDateTime fromJson(const QJsonValue& json) { return QDateTime::fromString(json.toString(), Qt::ISODate); }
+    static void writeCbor(QCborStreamWriter& writer, const QDateTime& value) { writeCompactCbor(writer, toCompact(value)); }
+    static bool readCbor(QCborStreamReader& reader, QDateTime* value);
+    static void writeBinary(QByteArray& out, const QDateTime& value) { writeCompactBinary(out, toCompact(value)); }
+    static bool readBinary(BinaryReader& reader, QDateTime* value);
+
+    static Compact toCompact(const QDateTime& value) { return CompactTime::fromDateTime(value); }
+    static QDateTime fromCompact(const Compact& value) { return value.toDateTime(); }
+    static void writeCompactCbor(QCborStreamWriter& writer, const Compact& value);
+    static void writeCompactBinary(QByteArray& out, const Compact& value);
+    static bool readCompactBinary(BinaryReader& reader, Compact* value);
+    static void writeCompactDelta(QByteArray& out, const Compact& before, const Compact& after);
+    static bool readCompactDelta(BinaryReader& reader, const Compact& before, Compact* after);
+    static void retainCompact(const Compact&) {}
+    static void releaseCompact(const Compact&) {}
+};
+
+/**
+ * 标记集合：各格式中均为 Marker 对象的数组。
+ * 编码时直接读取 CompactMarker 和字符串池，不展开为 Marker；
+ * 每个标记的编码与 toCbor() / toBinary() 对单个 Marker 的输出相同。
+ */
+template <>
+struct ValueTraits<PersistentMarkerMap> {
+    static QJsonValue toJson(const PersistentMarkerMap& value);
+    static PersistentMarkerMap fromJson(const QJsonValue& json);
+    static void writeCbor(QCborStreamWriter& writer, const PersistentMarkerMap& value);
+    static bool readCbor(QCborStreamReader& reader, PersistentMarkerMap* value);
+    static void writeBinary(QByteArray& out, const PersistentMarkerMap& value);
+    static bool readBinary(BinaryReader& reader, PersistentMarkerMap* value);
+};
+
+// ========== 紧凑记录 ==========
+
+/**
+ * @brief 由对象生成紧凑记录
+ */
+template <typename T, typename Record>
+Record toCompact(const T& object) {
+    Record record;
+    forEachField<T>([&](const auto& field) {
+        using V = typename std::decay_t<decltype(field)>::ValueType;
+        field.setCompact(record, ValueTraits<V>::toCompact(field.get(object)));
+    });
+    return record;
+}
+
+/**
+ * @brief 将紧凑记录展开为对象
+ */
+template <typename T, typename Record>
+T fromCompact(const Record& record) {
+    T object;
+    forEachField<T>([&](const auto& field) {
+        using V = typename std::decay_t<decltype(field)>::ValueType;
+        field.set(object, ValueTraits<V>::fromCompact(field.getCompact(record)));
+    });
+    return object;
+}
+
+/**
+ * @brief 两个紧凑记录的每个字段是否都相同
+ */
+template <typename T, typename Record>
+bool compactEquals(const Record& a, const Record& b) {
+    bool equal = true;
+    forEachField<T>([&](const auto& field) {
+        equal = equal && field.getCompact(a) == field.getCompact(b);
+    });
+    return equal;
+}
+
+/**
+ * @brief 持有紧凑记录：增加其中字符串的引用计数
+ */
+template <typename T, typename Record>
+void retainCompact(const Record& record) {
+    forEachField<T>([&](const auto& field) {
+        using V = typename std::decay_t<decltype(field)>::ValueType;
+        ValueTraits<V>::retainCompact(field.getCompact(record));
+    });
+}
+
+/**
+ * @brief 不再持有紧凑记录：减少其中字符串的引用计数
+ */
+template <typename T, typename Record>
+void releaseCompact(const Record& record) {
+    forEachField<T>([&](const auto& field) {
+        using V = typename std::decay_t<decltype(field)>::ValueType;
+        ValueTraits<V>::releaseCompact(field.getCompact(record));
+    });
+}
+
+/**
+ * @brief 紧凑记录的 CBOR 编码（与 writeCbor() 对展开后对象的输出相同）
+ */
+template <typename T, typename Record>
+void writeCompactCbor(QCborStreamWriter& writer, const Record& record) {
+    writer.startMap(fieldCount<T>());
+    forEachField<T>([&](const auto& field) {
+        using V = typename std::decay_t<decltype(field)>::ValueType;
+        writer.append(QLatin1String(field.name, field.nameLength));
+        ValueTraits<V>::writeCompactCbor(writer, field.getCompact(record));
+    });
+    writer.endMap();
+}
+
+/**
+ * @brief 紧凑记录的二进制编码（与 writeBinary() 对展开后对象的输出相同）
+ */
+template <typename T, typename Record>
+void writeCompactBinary(QByteArray& out, const Record& record) {
+    forEachField<T>([&](const auto& field) {
+        using V = typename std::decay_t<decltype(field)>::ValueType;
+        ValueTraits<V>::writeCompactBinary(out, field.getCompact(record));
+    });
+}
+
+/**
+ * @brief 从二进制直接解码为紧凑记录
+ */
+template <typename T, typename Record>
+bool readCompactBinary(BinaryReader& reader, Record* record) {
+    bool ok = true;
+    forEachField<T>([&](const auto& field) {
+        using V = typename std::decay_t<decltype(field)>::ValueType;
+        if (ok) {
+            CompactOf<V> value{};
+            ok = ValueTraits<V>::readCompactBinary(reader, &value);
+            field.setCompact(*record, value);
+        }
+    });
+    return ok;
+}
+
+/**
+ * @brief 写入字段级修改：变化字段的位图（变长整数，第 i 位对应第 i 个字段），
+ *        然后按声明顺序只写变化的字段（坐标和时间写差值）
+ * @param out 输出
+ * @param before 修改前
+ * @param after 修改后
+ */
+template <typename T, typename Record>
+void writeCompactPatch(QByteArray& out, const Record& before, const Record& after) {
+    static_assert(fieldCount<T>() <= 64, "Field mask must fit in 64 bits");
+    quint64 mask = 0;
+    int index = 0;
+    forEachField<T>([&](const auto& field) {
+        if (!(field.getCompact(before) == field.getCompact(after))) {
+            mask |= quint64(1) << index;
+        }
+        ++index;
+    });
+
+    writeVarint(out, mask);
+    index = 0;
+    forEachField<T>([&](const auto& field) {
+        using V = typename std::decay_t<decltype(field)>::ValueType;
+        if (mask & (quint64(1) << index++)) {
+            ValueTraits<V>::writeCompactDelta(out, field.getCompact(before), field.getCompact(after));
+        }
+    });
+}
+
+/**
+ * @brief 在紧凑记录上应用 writeCompactPatch() 写入的修改
+ * @return 数据完整返回 true
+ */
+template <typename T, typename Record>
+bool applyCompactPatch(BinaryReader& reader, Record* record) {
+    quint64 mask = 0;
+    if (!reader.readVarint(&mask) || (fieldCount<T>() < 64 && (mask >> fieldCount<T>()) != 0)) {
+        return false;
+    }
+    bool ok = true;
+    int index = 0;
+    forEachField<T>([&](const auto& field) {
+        using V = typename std::decay_t<decltype(field)>::ValueType;
+        if (ok && (mask & (quint64(1) << index))) {
+            CompactOf<V> value{};
+            ok = ValueTraits<V>::readCompactDelta(reader, field.getCompact(*record), &value);
+            field.setCompact(*record, value);
+        }
+        ++index;
+    });
+    return ok;
+}
+
+/**
+ * @brief 列式存储：每个字段一个紧凑值数组，std::tuple<QVector<Compact>...>
+ */
+template <typename Fields>
+struct CompactColumnsOf;
+
+template <typename... F>
+struct CompactColumnsOf<std::tuple<F...>> {
+    using Type = std::tuple<QVector<typename F::CompactType>...>;
+};
+
+template <typename T>
+using CompactColumns = typename CompactColumnsOf<decltype(Schema<T>::fields())>::Type;
+
+template <typename T, typename Columns, typename Visitor, std::size_t... I>
+void forEachColumnImpl(Columns& columns, Visitor& visitor, std::index_sequence<I...>) {
+    const auto fields = Schema<T>::fields();
+    (visitor(std::get<I>(fields), std::get<I>(columns)), ...);
+}
+
+/**
+ * @brief 按声明顺序访问每个字段及其列
+ * @param columns CompactColumns<T>
+ * @param visitor 以 (字段描述, 列) 为参数的函数
+ */
+template <typename T, typename Columns, typename Visitor>
+void forEachColumn(Columns& columns, Visitor&& visitor) {
+    forEachColumnImpl<T>(columns, visitor, std::make_index_sequence<std::size_t(fieldCount<T>())>());
+}
+
+// ========== 数据类型声明 ==========
+
+/**
+ * 标记的字段同时对应 CompactMarker：增加字段时在 Marker、CompactMarker 中各加成员，
+ * 再在这里加一行，JSON / CBOR / 二进制、紧凑记录、列式存储和历史增量都随之生成。
+ */
+template <>
+struct Schema<Marker> {
+    static constexpr auto fields() {
+        return std::make_tuple(
+            DATA_SCHEMA_COMPACT_MEMBER(Marker, QColor, "color", m_color, CompactMarker, color),
+            compactField<CompactMarker>(
+                DATA_SCHEMA_MEMBER(Marker, QDateTime, "createTime", m_createTime),
+                [](const CompactMarker& r) { return CompactTime{r.createTime, r.timeOffset}; },
+                [](CompactMarker& r, CompactTime time) { r.createTime = time.msecs; r.timeOffset = time.offset; }),
+            DATA_SCHEMA_COMPACT_MEMBER(Marker, QString, "createdBy", m_createdBy, CompactMarker, createdBy),
+            DATA_SCHEMA_COMPACT_MEMBER(Marker, QString, "id", m_id, CompactMarker, id),
+            DATA_SCHEMA_COMPACT_MEMBER(Marker, QString, "note", m_note, CompactMarker, note),
+            compactField<CompactMarker>(
+                field<Marker, double>("x", [](const Marker& m) { return m.m_position.x(); },
+                                      [](Marker& m, double x) { m.m_position.setX(x); }),
+                [](const CompactMarker& r) { return r.x; },
+                [](CompactMarker& r, qint32 x) { r.x = x; }),
+            compactField<CompactMarker>(
+                field<Marker, double>("y", [](const Marker& m) { return m.m_position.y(); },
+                                      [](Marker& m, double y) { m.m_position.setY(y); }),
+                [](const CompactMarker& r) { return r.y; },
+                [](CompactMarker& r, qint32 y) { r.y = y; }));
+    }
+};
+
+template <>
+struct Schema<MapSnapshot> {
+    static constexpr auto fields() {
+        return std::make_tuple(
+            DATA_SCHEMA_MEMBER(MapSnapshot, QString, "description", m_description),
+            DATA_SCHEMA_MEMBER(MapSnapshot, PersistentMarkerMap, "markers", m_markers),
+            DATA_SCHEMA_MEMBER(MapSnapshot, QString, "snapshotId", m_snapshotId),
+            DATA_SCHEMA_MEMBER(MapSnapshot, QDateTime, "timestamp", m_timestamp));
+    }
+};
+
+static_assert(isSorted<Marker>(), "Marker fields must be declared in key order");
+static_assert(isSorted<MapSnapshot>(), "MapSnapshot fields must be declared in key order");
+
+} // namespace DataSchema
+
+#endif // DATASCHEMA_H
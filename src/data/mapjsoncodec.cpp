@@ -0,0 +1,882 @@
+#include "mapjsoncodec.h"
+#include "dataschema.h"
+#include "stringpool.h"
+#include <QHash>
+#include <QLocale>
+#include <QPair>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+#include <QtConcurrentMap>
+#include <QtMath>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// 与 QJsonDocument 相同的十六进制字符（小写）
+char hexDigit(uint value) {
+    return static_cast<char>(value < 10 ? '0' + value : 'a' + value - 10);
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * @brief 追加带引号的 JSON 字符串，转义规则与 QJsonDocument 一致
+ *
+ * 只转义引号、反斜杠和控制字符，其余字符直接输出 UTF-8；
+ * 不成对的代理项输出为 \uXXXX。
+ */
+void appendString(QByteArray& out, QStringView text) {
+    out += '"';
+    const char16_t* src = text.utf16();
+    const char16_t* const end = src + text.size();
+    while (src != end) {
+        const char16_t u = *src++;
+        if (u < 0x80) {
+            if (u >= 0x20 && u != '"' && u != '\\') {
+                out += static_cast<char>(u);
+                continue;
+            }
+            out += '\\';
+            switch (u) {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '\b': out += 'b'; break;
+                case '\f': out += 'f'; break;
+                case '\n': out += 'n'; break;
+                case '\r': out += 'r'; break;
+                case '\t': out += 't'; break;
+                default:
+                    out += "u00";
+                    out += hexDigit(u >> 4);
+                    out += hexDigit(u & 0xf);
+                    break;
+            }
+        } else if (u < 0x800) {
+            out += static_cast<char>(0xc0 | (u >> 6));
+            out += static_cast<char>(0x80 | (u & 0x3f));
+        } else if (!QChar::isSurrogate(u)) {
+            out += static_cast<char>(0xe0 | (u >> 12));
+            out += static_cast<char>(0x80 | ((u >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (u & 0x3f));
+        } else if (QChar::isHighSurrogate(u) && src != end && QChar::isLowSurrogate(*src)) {
+            const char32_t ucs4 = QChar::surrogateToUcs4(u, *src++);
+            out += static_cast<char>(0xf0 | (ucs4 >> 18));
+            out += static_cast<char>(0x80 | ((ucs4 >> 12) & 0x3f));
+            out += static_cast<char>(0x80 | ((ucs4 >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (ucs4 & 0x3f));
+        } else {
+            out += "\\u";
+            out += hexDigit((u >> 12) & 0xf);
+            out += hexDigit((u >> 8) & 0xf);
+            out += hexDigit((u >> 4) & 0xf);
+            out += hexDigit(u & 0xf);
+        }
+    }
+    out += '"';
+}
+
+// 与 QJsonDocument 相同的数字格式：最短往返表示，非有限值输出 null
+void appendNumber(QByteArray& out, double value) {
+    if (qIsFinite(value)) {
+        out += QByteArray::number(value, 'g', QLocale::FloatingPointShortest);
+    } else {
+        out += "null";
+    }
+}
+
+// 与 QColor::name() 相同："#rrggbb"，小写，忽略透明度
+void appendColor(QByteArray& out, QRgb rgb) {
+    out += "\"#";
+    for (int shift = 20; shift >= 0; shift -= 4) {
+        out += hexDigit((rgb >> shift) & 0xf);
+    }
+    out += '"';
+}
+
+bool readDigits(const char* text, int count, int* value) {
+    int result = 0;
+    for (int i = 0; i < count; ++i) {
+        if (text[i] < '0' || text[i] > '9') {
+            return false;
+        }
+        result = result * 10 + (text[i] - '0');
+    }
+    *value = result;
+    return true;
+}
+
+/**
+ * @brief 解析本地时间 "yyyy-MM-ddTHH:mm:ss[.zzz]"
+ *
+ * 这是 QDateTime::toString(Qt::ISODate) 对本地时间的输出格式。
+ * 带时区后缀等其他写法交给 QDateTime::fromString 处理。
+ */
+QDateTime parseDateTime(const QString& text) {
+    const qsizetype length = text.size();
+    if (length == 19 || (length == 23 && text[19] == u'.')) {
+        char buffer[23];
+        bool ascii = true;
+        for (qsizetype i = 0; i < length; ++i) {
+            const char16_t c = text[i].unicode();
+            ascii = ascii && c < 0x80;
+            buffer[i] = static_cast<char>(c);
+        }
+
+        int year, month, day, hour, minute, second, msec = 0;
+        if (ascii && buffer[4] == '-' && buffer[7] == '-' && buffer[10] == 'T'
+            && buffer[13] == ':' && buffer[16] == ':'
+            && readDigits(buffer, 4, &year) && readDigits(buffer + 5, 2, &month)
+            && readDigits(buffer + 8, 2, &day) && readDigits(buffer + 11, 2, &hour)
+            && readDigits(buffer + 14, 2, &minute) && readDigits(buffer + 17, 2, &second)
+            && (length == 19 || readDigits(buffer + 20, 3, &msec))) {
+            const QDate date(year, month, day);
+            const QTime time(hour, minute, second, msec);
+            if (date.isValid() && time.isValid()) {
+                return QDateTime(date, time);
+            }
+        }
+    }
+    return QDateTime::fromString(text, Qt::ISODate);
+}
+
+// 解析 "#rrggbb"，其他写法（颜色名、#rgb、#aarrggbb）交给 QColor
+QColor parseColor(const QString& text) {
+    if (text.size() == 7 && text[0] == u'#') {
+        int rgb = 0;
+        bool valid = true;
+        for (int i = 1; i < 7 && valid; ++i) {
+            const char16_t c = text[i].unicode();
+            const int digit = c < 0x80 ? hexValue(static_cast<char>(c)) : -1;
+            valid = digit >= 0;
+            rgb = (rgb << 4) | digit;
+        }
+        if (valid) {
+            return QColor((rgb >> 16) & 0xff, (rgb >> 8) & 0xff, rgb & 0xff);
+        }
+    }
+    return QColor(text);
+}
+
+} // namespace
+
+// ========== Writer ==========
+
+/**
+ * @brief 按 QJsonDocument::toJson() 的缩进规则输出对象和数组
+ *
+ * 缩进格式：每层 4 个空格，键值之间为 ": "，元素之间为 ",\n"，
+ * 空容器输出为 "{\n<缩进>}"。对象的字段由 DataSchema 的声明生成，
+ * 声明按键名排序，与 QJsonObject 的输出顺序相同。
+ */
+class MapJsonCodec::Writer {
+public:
+    Writer(QByteArray& out, bool compact) : m_out(out), m_compact(compact) {}
+
+    void beginObject() { begin(m_compact ? "{" : "{\n"); }
+    void endObject() { end('}'); }
+    void beginArray() { begin(m_compact ? "[" : "[\n"); }
+    void endArray() { end(']'); }
+
+    void key(const char* name) {
+        separate();
+        m_out += '"';
+        m_out += name;
+        m_out += m_compact ? "\":" : "\": ";
+    }
+
+    void element() { separate(); }
+
+    void endDocument() {
+        if (!m_compact) {
+            m_out += '\n';
+        }
+    }
+
+    template <typename T>
+    void writeObject(const T& object) {
+        beginObject();
+        DataSchema::forEachField<T>([&](const auto& field) {
+            key(field.name);
+            writeValue(field.get(object));
+        });
+        endObject();
+    }
+
+    void writeValue(const QString& value) { appendString(m_out, value); }
+    void writeValue(double value) { appendNumber(m_out, value); }
+    void writeValue(const QColor& value) { appendColor(m_out, value.rgba()); }
+    void writeValue(const QDateTime& value) { appendString(m_out, value.toString(Qt::ISODate)); }
+    void writeValue(const PersistentMarkerMap& markers);
+
+    // 快照中的标记：按 Schema<Marker> 直接从紧凑记录输出（带编码缓存）
+    void writeMarker(const CompactMarker& marker) {
+        beginObject();
+        DataSchema::forEachField<Marker>([&](const auto& field) {
+            using V = typename std::decay_t<decltype(field)>::ValueType;
+            key(field.name);
+            writeCompact(static_cast<const V*>(nullptr), field.getCompact(marker));
+        });
+        endObject();
+    }
+
+private:
+    void begin(const char* token) {
+        m_out += token;
+        m_first.push_back(true);
+    }
+
+    void end(char token) {
+        const bool empty = m_first.back();
+        m_first.pop_back();
+        if (!m_compact) {
+            if (!empty) {
+                m_out += '\n';
+            }
+            m_out.append(4 * qsizetype(m_first.size()), ' ');
+        }
+        m_out += token;
+    }
+
+    void separate() {
+        if (!m_first.back()) {
+            m_out += m_compact ? "," : ",\n";
+        }
+        m_first.back() = false;
+        if (!m_compact) {
+            m_out.append(4 * qsizetype(m_first.size()), ' ');
+        }
+    }
+
+    // 紧凑值的输出，与对应的 writeValue() 相同（第一个参数只用于按值类型选择重载）
+    void writeCompact(const QString*, quint32 index) { m_out += cachedString(index); }
+    void writeCompact(const double*, qint32 value) { appendNumber(m_out, CompactMarker::fromFixed(value)); }
+    void writeCompact(const QColor*, QRgb rgb) { appendColor(m_out, rgb); }
+    void writeCompact(const QDateTime*, const CompactTime& time) { m_out += cachedTime(time); }
+
+    const QByteArray& cachedString(quint32 index);
+    const QByteArray& cachedTime(const CompactTime& time);
+
+    QByteArray& m_out;
+    bool m_compact;
+    std::vector<bool> m_first;                  ///< 每层容器是否还没有输出元素
+    QHash<quint32, QByteArray> m_strings;       ///< 字符串序号 -> 已编码的字符串
+    QHash<QPair<qint64, qint32>, QByteArray> m_times;  ///< (毫秒时间戳, UTC 偏移) -> 已编码的时间
+};
+
+const QByteArray& MapJsonCodec::Writer::cachedString(quint32 index) {
+    auto it = m_strings.find(index);
+    if (it == m_strings.end()) {
+        QByteArray encoded;
+        appendString(encoded, StringPool::markerStrings().at(index));
+        it = m_strings.insert(index, encoded);
+    }
+    return it.value();
+}
+
+const QByteArray& MapJsonCodec::Writer::cachedTime(const CompactTime& time) {
+    const QPair<qint64, qint32> key(time.msecs, time.offset);
+    auto it = m_times.find(key);
+    if (it == m_times.end()) {
+        // 与 CompactMarker::toMarker() 展开后的 QDateTime 输出相同（保留时区写法）
+        QByteArray encoded;
+        appendString(encoded, time.toDateTime().toString(Qt::ISODate));
+        it = m_times.insert(key, encoded);
+    }
+    return it.value();
+}
+
+void MapJsonCodec::Writer::writeValue(const PersistentMarkerMap& markers) {
+    beginArray();
+    markers.forEachCompact([this](const CompactMarker& marker) {
+        element();
+        writeMarker(marker);
+    });
+    endArray();
+}
+
+QByteArray MapJsonCodec::writeSnapshots(const QList<MapSnapshot>& snapshots,
+                                        QJsonDocument::JsonFormat format) {
+    QByteArray out;
+    qsizetype markerCount = 0;
+    for (const MapSnapshot& snapshot : snapshots) {
+        markerCount += snapshot.markerCount();
+    }
+    out.reserve(markerCount * 160 + snapshots.size() * 160);
+
+    Writer writer(out, format == QJsonDocument::Compact);
+    writer.beginArray();
+    for (const MapSnapshot& snapshot : snapshots) {
+        writer.element();
+        writer.writeObject(snapshot);
+    }
+    writer.endArray();
+    writer.endDocument();
+    return out;
+}
+
+QByteArray MapJsonCodec::writeMarker(const Marker& marker) {
+    QByteArray out;
+    out.reserve(192);
+    Writer writer(out, true);
+    writer.writeObject(marker);
+    return out;
+}
+
+// ========== Reader ==========
+
+/**
+ * @brief 顺序扫描的 JSON 读取器
+ *
+ * 不构建中间的 DOM：字段名按 DataSchema 的声明分派后直接写入目标对象，
+ * 未知字段跳过。字段类型不符时按 QJsonValue 的转换规则取默认值
+ * （字符串为空，数字为 0）。
+ */
+class MapJsonCodec::Reader {
+public:
+    /// 数组元素在文本中的字节范围 [first, second)
+    using Range = QPair<const char*, const char*>;
+
+    explicit Reader(const QByteArray& json)
+        : m_begin(json.constData()), m_pos(json.constData()), m_end(json.constData() + json.size()) {}
+
+    /// 只读取 json 中的一段（错误位置仍相对于整个文本）
+    Reader(const QByteArray& json, const Range& range)
+        : m_begin(json.constData()), m_pos(range.first), m_end(range.second) {}
+
+    bool readSnapshotArray(QList<MapSnapshot>* snapshots);
+    bool readSnapshotElement(MapSnapshot* snapshot);
+    bool splitArray(QVector<Range>* elements);
+    bool readSnapshot(MapSnapshot* snapshot);
+    bool readMarker(Marker* marker);
+
+    bool finish() {
+        skipWhitespace();
+        return m_pos == m_end || fail("unexpected data after document");
+    }
+
+    QString errorMessage() const { return m_error; }
+
+private:
+    template <typename Handler>
+    bool readObject(Handler&& handler);
+
+    template <typename Handler>
+    bool readArray(Handler&& handler);
+
+    template <typename T>
+    bool readFields(T* object);
+
+    bool readValue(QString* text) { return readStringField(text); }
+    bool readValue(double* value) { return readNumberField(value); }
+    bool readValue(QColor* color);
+    bool readValue(QDateTime* time);
+    bool readValue(PersistentMarkerMap* markers);
+
+    bool readKey(QByteArrayView* key);
+    bool readString(QString* text);
+    bool readNumber(double* value);
+    bool readStringField(QString* text);
+    bool readNumberField(double* value);
+    bool skipString();
+    bool skipValue();
+    bool expectLiteral(const char* literal);
+
+    void skipWhitespace() {
+        while (m_pos != m_end && (*m_pos == ' ' || *m_pos == '\n' || *m_pos == '\r' || *m_pos == '\t')) {
+            ++m_pos;
+        }
+    }
+
+    char peek() {
+        skipWhitespace();
+        return m_pos == m_end ? '\0' : *m_pos;
+    }
+
+    bool consume(char c) {
+        if (peek() == c) {
+            ++m_pos;
+            return true;
+        }
+        return false;
+    }
+
+    bool fail(const char* message) {
+        if (m_error.isEmpty()) {
+            m_error = QString("%1 at offset %2")
+                          .arg(QString::fromLatin1(message))
+                          .arg(m_pos - m_begin);
+        }
+        return false;
+    }
+
+    const char* m_begin;
+    const char* m_pos;
+    const char* m_end;
+    QByteArray m_keyBuffer;     ///< 含转义字符的键名解码后的存放位置
+    QString m_error;
+};
+
+template <typename Handler>
+bool MapJsonCodec::Reader::readObject(Handler&& handler) {
+    if (!consume('{')) {
+        return fail("expected object");
+    }
+    if (consume('}')) {
+        return true;
+    }
+    for (;;) {
+        QByteArrayView key;
+        if (!readKey(&key)) {
+            return false;
+        }
+        if (!consume(':')) {
+            return fail("expected ':'");
+        }
+        if (!handler(key)) {
+            return false;
+        }
+        if (consume(',')) {
+            continue;
+        }
+        if (consume('}')) {
+            return true;
+        }
+        return fail("expected ',' or '}'");
+    }
+}
+
+template <typename Handler>
+bool MapJsonCodec::Reader::readArray(Handler&& handler) {
+    if (!consume('[')) {
+        return fail("expected array");
+    }
+    if (consume(']')) {
+        return true;
+    }
+    for (;;) {
+        skipWhitespace();
+        if (!handler()) {
+            return false;
+        }
+        if (consume(',')) {
+            continue;
+        }
+        if (consume(']')) {
+            return true;
+        }
+        return fail("expected ',' or ']'");
+    }
+}
+
+bool MapJsonCodec::Reader::readKey(QByteArrayView* key) {
+    if (peek() != '"') {
+        return fail("expected key");
+    }
+
+    // 常见情况：键名不含转义，直接引用原始字节
+    const char* start = m_pos + 1;
+    const char* p = start;
+    while (p != m_end && *p != '"' && *p != '\\') {
+        ++p;
+    }
+    if (p != m_end && *p == '"') {
+        *key = QByteArrayView(start, p - start);
+        m_pos = p + 1;
+        return true;
+    }
+
+    QString text;
+    if (!readString(&text)) {
+        return false;
+    }
+    m_keyBuffer = text.toUtf8();
+    *key = QByteArrayView(m_keyBuffer);
+    return true;
+}
+
+bool MapJsonCodec::Reader::readString(QString* text) {
+    if (peek() != '"') {
+        return fail("expected string");
+    }
+    ++m_pos;
+
+    // 常见情况：没有转义字符，整段解码
+    const char* start = m_pos;
+    while (m_pos != m_end && *m_pos != '"' && *m_pos != '\\') {
+        ++m_pos;
+    }
+    if (m_pos == m_end) {
+        return fail("unterminated string");
+    }
+    *text = QString::fromUtf8(start, m_pos - start);
+    if (*m_pos == '"') {
+        ++m_pos;
+        return true;
+    }
+
+    // 含转义：逐段追加（转义符和引号都是 ASCII，不会截断 UTF-8 序列）
+    for (;;) {
+        if (m_pos == m_end) {
+            return fail("unterminated string");
+        }
+        if (*m_pos == '"') {
+            ++m_pos;
+            return true;
+        }
+        if (*m_pos != '\\') {
+            start = m_pos;
+            while (m_pos != m_end && *m_pos != '"' && *m_pos != '\\') {
+                ++m_pos;
+            }
+            text->append(QString::fromUtf8(start, m_pos - start));
+            continue;
+        }
+
+        if (m_end - m_pos < 2) {
+            return fail("unterminated string");
+        }
+        const char escape = m_pos[1];
+        m_pos += 2;
+        switch (escape) {
+            case '"': text->append(u'"'); break;
+            case '\\': text->append(u'\\'); break;
+            case '/': text->append(u'/'); break;
+            case 'b': text->append(u'\b'); break;
+            case 'f': text->append(u'\f'); break;
+            case 'n': text->append(u'\n'); break;
+            case 'r': text->append(u'\r'); break;
+            case 't': text->append(u'\t'); break;
+            case 'u': {
+                if (m_end - m_pos < 4) {
+                    return fail("invalid unicode escape");
+                }
+                int code = 0;
+                for (int i = 0; i < 4; ++i) {
+                    const int digit = hexValue(m_pos[i]);
+                    if (digit < 0) {
+                        return fail("invalid unicode escape");
+                    }
+                    code = (code << 4) | digit;
+                }
+                m_pos += 4;
+                // 代理对由相邻的两个 \u 依次追加组成
+                text->append(QChar(static_cast<char16_t>(code)));
+                break;
+            }
+            default:
+                return fail("invalid escape sequence");
+        }
+    }
+}
+
+bool MapJsonCodec::Reader::readNumber(double* value) {
+    skipWhitespace();
+    const char* start = m_pos;
+    while (m_pos != m_end) {
+        const char c = *m_pos;
+        if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E') {
+            ++m_pos;
+        } else {
+            break;
+        }
+    }
+    if (m_pos == start) {
+        return fail("expected number");
+    }
+
+    bool ok = false;
+    *value = QByteArray::fromRawData(start, m_pos - start).toDouble(&ok);
+    return ok || fail("invalid number");
+}
+
+bool MapJsonCodec::Reader::readStringField(QString* text) {
+    if (peek() == '"') {
+        return readString(text);
+    }
+    text->clear();
+    return skipValue();
+}
+
+bool MapJsonCodec::Reader::readNumberField(double* value) {
+    const char c = peek();
+    if (c == '-' || (c >= '0' && c <= '9')) {
+        return readNumber(value);
+    }
+    *value = 0;
+    return skipValue();
+}
+
+bool MapJsonCodec::Reader::skipString() {
+    ++m_pos;
+    while (m_pos != m_end) {
+        if (*m_pos == '\\') {
+            if (m_end - m_pos < 2) {
+                break;
+            }
+            m_pos += 2;
+            continue;
+        }
+        if (*m_pos++ == '"') {
+            return true;
+        }
+    }
+    m_pos = m_end;
+    return fail("unterminated string");
+}
+
+bool MapJsonCodec::Reader::expectLiteral(const char* literal) {
+    const qsizetype length = qsizetype(std::strlen(literal));
+    if (m_end - m_pos < length || std::memcmp(m_pos, literal, length) != 0) {
+        return fail("invalid literal");
+    }
+    m_pos += length;
+    return true;
+}
+
+bool MapJsonCodec::Reader::skipValue() {
+    switch (peek()) {
+        case '"':
+            return skipString();
+        case '{':
+            return readObject([this](QByteArrayView) { return skipValue(); });
+        case '[':
+            return readArray([this]() { return skipValue(); });
+        case 't':
+            return expectLiteral("true");
+        case 'f':
+            return expectLiteral("false");
+        case 'n':
+            return expectLiteral("null");
+        default: {
+            double ignored;
+            return readNumber(&ignored);
+        }
+    }
+}
+
+template <typename T>
+bool MapJsonCodec::Reader::readFields(T* object) {
+    return readObject([&](QByteArrayView key) {
+        bool ok = true;
+        const bool found = DataSchema::findField<T>(key, [&](const auto& field) {
+            using V = typename std::decay_t<decltype(field)>::ValueType;
+            V value{};
+            ok = readValue(&value);
+            field.set(*object, std::move(value));
+        });
+        return found ? ok : skipValue();
+    });
+}
+
+bool MapJsonCodec::Reader::readValue(QColor* color) {
+    QString text;
+    if (!readStringField(&text)) {
+        return false;
+    }
+    *color = parseColor(text);
+    return true;
+}
+
+bool MapJsonCodec::Reader::readValue(QDateTime* time) {
+    QString text;
+    if (!readStringField(&text)) {
+        return false;
+    }
+    *time = parseDateTime(text);
+    return true;
+}
+
+bool MapJsonCodec::Reader::readValue(PersistentMarkerMap* markers) {
+    if (peek() != '[') {
+        return skipValue();
+    }
+    return readArray([&]() {
+        // 非对象元素与 Marker::fromJson(QJsonObject()) 的结果相同
+        Marker marker;
+        if (peek() == '{') {
+            if (!readMarker(&marker)) return false;
+        } else if (!skipValue()) {
+            return false;
+        }
+        markers->insert(marker);
+        return true;
+    });
+}
+
+bool MapJsonCodec::Reader::readMarker(Marker* marker) {
+    return readFields(marker);
+}
+
+bool MapJsonCodec::Reader::readSnapshot(MapSnapshot* snapshot) {
+    return readFields(snapshot);
+}
+
+bool MapJsonCodec::Reader::readSnapshotElement(MapSnapshot* snapshot) {
+    // 非对象元素与 MapSnapshot::fromJson(QJsonObject()) 的结果相同
+    if (peek() == '{') {
+        return readSnapshot(snapshot);
+    }
+    return skipValue();
+}
+
+bool MapJsonCodec::Reader::readSnapshotArray(QList<MapSnapshot>* snapshots) {
+    return readArray([&]() {
+        MapSnapshot snapshot;
+        if (!readSnapshotElement(&snapshot)) {
+            return false;
+        }
+        snapshots->append(snapshot);
+        return true;
+    });
+}
+
+bool MapJsonCodec::Reader::splitArray(QVector<Range>* elements) {
+    return readArray([&]() {
+        const char* start = m_pos;
+        if (!skipValue()) {
+            return false;
+        }
+        elements->append(Range(start, m_pos));
+        return true;
+    });
+}
+
+// ========== 并行解码 ==========
+
+namespace {
+
+std::atomic<int> g_maxDecodeThreads{0};    // <= 0：按 CPU 核数
+
+QThreadPool* decodePool() {
+    // 专用线程池，不占用 QThreadPool::globalInstance() 中的其他任务。
+    // 大小只在创建时设置一次；多个解码可能同时进行，每次调用的并发数由调用方限制
+    static QThreadPool* pool = []() {
+        auto* created = new QThreadPool();
+        created->setMaxThreadCount(QThread::idealThreadCount());
+        return created;
+    }();
+    return pool;
+}
+
+} // namespace
+
+void MapJsonCodec::setMaxDecodeThreads(int count) {
+    g_maxDecodeThreads.store(count, std::memory_order_relaxed);
+}
+
+int MapJsonCodec::maxDecodeThreads() {
+    const int count = g_maxDecodeThreads.load(std::memory_order_relaxed);
+    return count > 0 ? count : QThread::idealThreadCount();
+}
+
+bool MapJsonCodec::readSnapshotsParallel(const QByteArray& json, QList<MapSnapshot>* snapshots,
+                                         QString* errorMessage, int threadCount) {
+    // 第一遍：只扫描语法，记录每个快照的字节范围
+    Reader scanner(json);
+    QVector<Reader::Range> elements;
+    if (!scanner.splitArray(&elements) || !scanner.finish()) {
+        if (errorMessage) {
+            *errorMessage = scanner.errorMessage();
+        }
+        return false;
+    }
+
+    // 按字节数切成若干连续的块（块数多于线程数，平衡各快照大小的差异）
+    struct Chunk {
+        int first = 0;
+        int last = 0;
+        QList<MapSnapshot> snapshots;
+        QString error;
+    };
+    QVector<Chunk> chunks;
+    const qsizetype chunkBytes = qMax<qsizetype>(1, json.size() / (threadCount * 4));
+    for (int i = 0; i < elements.size();) {
+        Chunk chunk;
+        chunk.first = i;
+        const char* chunkStart = elements[i].first;
+        while (i < elements.size() && elements[i].second - chunkStart < chunkBytes) {
+            ++i;
+        }
+        chunk.last = qMax(i, chunk.first + 1);
+        i = chunk.last;
+        chunks.append(chunk);
+    }
+
+    // 第二遍：各块独立解码（字符串池是线程安全的）。
+    // 线程池是共用的，不修改其大小：只提交 threadCount 个任务，各自领取下一个块
+    auto decodeChunk = [&json, &elements](Chunk& chunk) {
+        chunk.snapshots.reserve(chunk.last - chunk.first);
+        for (int i = chunk.first; i < chunk.last; ++i) {
+            Reader reader(json, elements[i]);
+            MapSnapshot snapshot;
+            if (!reader.readSnapshotElement(&snapshot) || !reader.finish()) {
+                chunk.error = reader.errorMessage();
+                return;
+            }
+            chunk.snapshots.append(snapshot);
+        }
+    };
+    QVector<int> lanes(qMin(threadCount, int(chunks.size())));
+    std::atomic<int> nextChunk{0};
+    QtConcurrent::blockingMap(decodePool(), lanes, [&chunks, &nextChunk, &decodeChunk](int&) {
+        for (int i = nextChunk.fetch_add(1); i < chunks.size(); i = nextChunk.fetch_add(1)) {
+            decodeChunk(chunks[i]);
+        }
+    });
+
+    // 按原顺序合并
+    QList<MapSnapshot> result;
+    result.reserve(elements.size());
+    for (const Chunk& chunk : chunks) {
+        if (!chunk.error.isEmpty()) {
+            if (errorMessage) {
+                *errorMessage = chunk.error;
+            }
+            return false;
+        }
+        result.append(chunk.snapshots);
+    }
+    *snapshots = result;
+    return true;
+}
+
+bool MapJsonCodec::readSnapshots(const QByteArray& json, QList<MapSnapshot>* snapshots,
+                                 QString* errorMessage) {
+    const int threadCount = maxDecodeThreads();
+    if (threadCount > 1 && json.size() >= kParallelDecodeThreshold) {
+        return readSnapshotsParallel(json, snapshots, errorMessage, threadCount);
+    }
+
+    Reader reader(json);
+    QList<MapSnapshot> result;
+    if (!reader.readSnapshotArray(&result) || !reader.finish()) {
+        if (errorMessage) {
+            *errorMessage = reader.errorMessage();
+        }
+        return false;
+    }
+    *snapshots = result;
+    return true;
+}
+
+bool MapJsonCodec::readMarker(const QByteArray& json, Marker* marker,
+                              QString* errorMessage) {
+    Reader reader(json);
+    Marker result;
+    if (!reader.readMarker(&result) || !reader.finish()) {
+        if (errorMessage) {
+            *errorMessage = reader.errorMessage();
+        }
+        return false;
+    }
+    *marker = result;
+    return true;
+}
@@ -0,0 +1,90 @@
+#ifndef MAPJSONCODEC_H
+#define MAPJSONCODEC_H
+
+#include <QByteArray>
+#include <QJsonDocument>
+#include <QList>
+#include <QString>
+
+#include "marker.h"
+#include "mapsnapshot.h"
+
+/**
+ * @class MapJsonCodec
+ * @brief Marker / MapSnapshot 专用的流式 JSON 编解码器
+ *
+ * 不经过 QJsonDocument / QJsonObject：
+ * - 读取：顺序扫描字节流，按字段名直接写入对象，
+ *   ISO 8601 时间和 #rrggbb 颜色使用专门的快速解析（其他格式回退到 Qt 解析）
+ * - 写入：直接追加到 QByteArray，字段顺序、数字和字符串转义规则与
+ *   QJsonDocument::toJson() 完全一致，输出逐字节相同
+ *
+ * 写入快照时按字符串序号和时间戳缓存已编码的片段，
+ * 历史中反复出现的同一标记只编码一次。
+ *
+ * 快照数组超过 kParallelDecodeThreshold 字节时并行解码：
+ * 先扫描出每个快照的字节范围，再分块交给专用线程池，最后按原顺序合并。
+ */
+class MapJsonCodec {
+public:
+    /**
+     * @brief 将快照列表编码为 JSON 数组
+     * @param snapshots 快照列表
+     * @param format 输出格式（与 QJsonDocument::toJson 相同）
+     * @return JSON 文本（UTF-8）
+     */
+    static QByteArray writeSnapshots(const QList<MapSnapshot>& snapshots,
+                                     QJsonDocument::JsonFormat format = QJsonDocument::Indented);
+
+    /**
+     * @brief 将标记编码为 JSON 对象（紧凑格式）
+     * @param marker 标记
+     * @return JSON 文本（UTF-8）
+     */
+    static QByteArray writeMarker(const Marker& marker);
+
+    /// 启用并行解码的最小数据量（字节）
+    static constexpr qsizetype kParallelDecodeThreshold = 1024 * 1024;
+
+    /**
+     * @brief 设置解码快照数组时使用的最大线程数
+     * @param count 线程数，<= 0 表示按 CPU 核数，1 表示始终串行解码
+     *
+     * 线程安全；只影响之后开始的解码，同时进行的解码共用一个线程池。
+     */
+    static void setMaxDecodeThreads(int count);
+
+    /**
+     * @brief 获取解码快照数组时使用的最大线程数
+     */
+    static int maxDecodeThreads();
+
+    /**
+     * @brief 解码快照数组
+     * @param json JSON 文本
+     * @param snapshots 输出的快照列表
+     * @param errorMessage 出错时的错误描述（可选）
+     * @return 成功返回 true
+     */
+    static bool readSnapshots(const QByteArray& json, QList<MapSnapshot>* snapshots,
+                              QString* errorMessage = nullptr);
+
+    /**
+     * @brief 解码单个标记对象
+     * @param json JSON 文本
+     * @param marker 输出的标记
+     * @param errorMessage 出错时的错误描述（可选）
+     * @return 成功返回 true
+     */
+    static bool readMarker(const QByteArray& json, Marker* marker,
+                           QString* errorMessage = nullptr);
+
+private:
+    class Reader;
+    class Writer;
+
+    static bool readSnapshotsParallel(const QByteArray& json, QList<MapSnapshot>* snapshots,
+                                      QString* errorMessage, int threadCount);
+};
+
+#endif // MAPJSONCODEC_H
@@ -5,13 +5,18 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include "marker.h"
+#include "persistentmarkermap.h"
+
+namespace DataSchema { template <typename T> struct Schema; }
 
 /**
  * @class MapSnapshot
  * @brief 地图历史快照数据结构
  *
  * 表示某个时间点的地图完整状态，包含该时刻所有标记的完整数据。
- * 类似 Git 的 commit，每次快照保存完整的标记列表，支持回溯到任意历史状态。
+ * 类似 Git 的 commit，每次快照保存完整的标记集合，支持回溯到任意历史状态。
+ * 标记集合使用结构共享的 PersistentMarkerMap，相邻快照共享未变化的部分，
+ * 创建和复制快照的代价与变化量而不是标记总数成正比。
  */
 class MapSnapshot {
 public:
@@ -30,6 +35,16 @@ public:
                 const QList<Marker>& markers,
                 const QString& description = QString());
 
+    /**
+     * @brief 以持久化标记集合构造（O(1)，与传入集合共享结构）
+     * @param timestamp 快照时间戳
+     * @param markers 该时刻的标记集合
+     * @param description 快照描述（可选）
+     */
+    MapSnapshot(const QDateTime& timestamp,
+                const PersistentMarkerMap& markers,
+                const QString& description = QString());
+
     // ========== Getters ==========
     /**
      * @brief 获取快照唯一标识符
@@ -45,9 +60,21 @@ public:
 
     /**
      * @brief 获取该时刻的所有标记
-     * @return 标记列表（const引用）
+     * @return 标记列表（按需展开，O(n)）
+     */
+    QList<Marker> markers() const { return m_markers.values(); }
+
+    /**
+     * @brief 获取该时刻的标记集合
+     * @return 持久化标记集合（const引用）
      */
-    const QList<Marker>& markers() const { return m_markers; }
+    const PersistentMarkerMap& markerMap() const { return m_markers; }
+
+    /**
+     * @brief 获取该时刻的标记数量
+     * @return 标记数量（O(1)）
+     */
+    int markerCount() const { return m_markers.size(); }
 
     /**
      * @brief 获取快照描述
@@ -62,6 +89,21 @@ public:
      */
     void setDescription(const QString& description) { m_description = description; }
 
+    /**
+     * @brief 设置标记集合
+     * @param markers 新的标记集合（O(1)，与传入集合共享结构）
+     */
+    void setMarkers(const PersistentMarkerMap& markers) { m_markers = markers; }
+
+    /**
+     * @brief 与前一个快照重新建立结构共享
+     * @param previous 前一个快照
+     *
+     * 从 JSON 加载的快照彼此独立，调用后未变化的标记与 previous 共享节点，
+     * 内容不变。
+     */
+    void shareMarkersWith(const MapSnapshot& previous);
+
     // ========== JSON 序列化 ==========
     /**
      * @brief 将快照数据转换为 JSON 对象
@@ -84,9 +126,12 @@ public:
     static QString generateId(const QDateTime& timestamp);
 
 private:
+    friend class MapJsonCodec;
+    template <typename T> friend struct DataSchema::Schema;
+
     QString m_snapshotId;           ///< 唯一标识符
     QDateTime m_timestamp;          ///< 快照时间戳
-    QList<Marker> m_markers;        ///< 该时刻的所有标记（完整数据）
+    PersistentMarkerMap m_markers;  ///< 该时刻的所有标记（结构共享）
     QString m_description;          ///< 快照描述（可选）
 };
 
@@ -1,4 +1,5 @@
 #include "marker.h"
+#include "dataschema.h"
 #include <QRandomGenerator>
 
 Marker::Marker(const QPointF& position,
@@ -22,25 +23,20 @@ QString Marker::generateId() {
         .arg(QRandomGenerator::global()->bounded(10000));
 }
 
+bool Marker::operator==(const Marker& other) const {
+    return m_id == other.m_id
+        && m_position == other.m_position
+        && m_note == other.m_note
+        && m_color == other.m_color
+        && m_createTime == other.m_createTime
+        && m_createdBy == other.m_createdBy;
+}
+
 QJsonObject Marker::toJson() const {
-    QJsonObject obj;
-    obj["id"] = m_id;
-    obj["x"] = m_position.x();
-    obj["y"] = m_position.y();
-    obj["note"] = m_note;
-    obj["color"] = m_color.name();
-    obj["createTime"] = m_createTime.toString(Qt::ISODate);
-    obj["createdBy"] = m_createdBy;
-    return obj;
+    // 字段声明见 DataSchema::Schema<Marker>
+    return DataSchema::toJson(*this);
 }
 
 Marker Marker::fromJson(const QJsonObject& json) {
-    Marker marker;
-    marker.m_id = json["id"].toString();
-    marker.m_position = QPointF(json["x"].toDouble(), json["y"].toDouble());
-    marker.m_note = json["note"].toString();
-    marker.m_color = QColor(json["color"].toString());
-    marker.m_createTime = QDateTime::fromString(json["createTime"].toString(), Qt::ISODate);
-    marker.m_createdBy = json["createdBy"].toString();
-    return marker;
+    return DataSchema::fromJson<Marker>(json);
 }
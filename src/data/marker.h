@@ -7,6 +7,8 @@
 #include <QDateTime>
 #include <QJsonObject>
 
+namespace DataSchema { template <typename T> struct Schema; }
+
 /**
  * @class Marker
  * @brief 地图标记点数据结构
@@ -91,6 +93,19 @@ public:
      */
     void setColor(const QColor& color) { m_color = color; }
 
+    // ========== 比较 ==========
+    /**
+     * @brief 判断两个标记的全部字段是否相同
+     * @param other 另一个标记
+     * @return 所有字段都相等返回 true
+     */
+    bool operator==(const Marker& other) const;
+
+    /**
+     * @brief 判断两个标记是否存在字段差异
+     */
+    bool operator!=(const Marker& other) const { return !(*this == other); }
+
     // ========== JSON 序列化 ==========
     /**
      * @brief 将标记数据转换为 JSON 对象
@@ -112,6 +127,10 @@ public:
     static QString generateId();
 
 private:
+    friend struct CompactMarker;
+    friend class MapJsonCodec;
+    template <typename T> friend struct DataSchema::Schema;
+
     QString m_id;              ///< 唯一标识符
     QPointF m_position;        ///< 归一化坐标 (0.0-1.0)
     QString m_note;            ///< 备注信息
@@ -0,0 +1,37 @@
+#include "markerdiff.h"
+#include <QHash>
+
+MarkerDiff MarkerDiff::between(const QList<Marker>& from, const QList<Marker>& to) {
+    MarkerDiff diff;
+
+    // 以ID建立旧状态的索引
+    QHash<QString, int> fromIndex;
+    fromIndex.reserve(from.size());
+    for (int i = 0; i < from.size(); ++i) {
+        fromIndex.insert(from[i].id(), i);
+    }
+
+    // 遍历新状态：找出新增和修改的标记，匹配过的旧标记从索引中移除
+    for (const Marker& marker : to) {
+        auto it = fromIndex.find(marker.id());
+        if (it == fromIndex.end()) {
+            diff.added.append(marker);
+            continue;
+        }
+        if (from[it.value()] != marker) {
+            diff.updated.append(marker);
+        }
+        fromIndex.erase(it);
+    }
+
+    // 剩下未匹配的旧标记即为被删除的标记（按原顺序输出）
+    if (!fromIndex.isEmpty()) {
+        for (const Marker& marker : from) {
+            if (fromIndex.contains(marker.id())) {
+                diff.removed.append(marker);
+            }
+        }
+    }
+
+    return diff;
+}
@@ -0,0 +1,40 @@
+#ifndef MARKERDIFF_H
+#define MARKERDIFF_H
+
+#include <QList>
+#include "marker.h"
+
+/**
+ * @struct MarkerDiff
+ * @brief 两个标记状态之间的差异
+ *
+ * 以标记ID为键比较前后两个状态，记录新增、删除以及内容发生变化的标记。
+ * 后端索引维护和客户端增量刷新都基于它完成。
+ */
+struct MarkerDiff {
+    QList<Marker> added;      ///< 新增的标记
+    QList<Marker> removed;    ///< 被删除的标记（删除前的数据）
+    QList<Marker> updated;    ///< 内容发生变化的标记（变化后的数据）
+
+    /**
+     * @brief 是否没有任何变化
+     * @return 无变化返回 true
+     */
+    bool isEmpty() const { return added.isEmpty() && removed.isEmpty() && updated.isEmpty(); }
+
+    /**
+     * @brief 变化的标记总数
+     * @return 新增、删除、修改数量之和
+     */
+    int changeCount() const { return added.size() + removed.size() + updated.size(); }
+
+    /**
+     * @brief 计算两个标记列表之间的差异
+     * @param from 变化前的标记列表
+     * @param to 变化后的标记列表
+     * @return 差异结果
+     */
+    static MarkerDiff between(const QList<Marker>& from, const QList<Marker>& to);
+};
+
+#endif // MARKERDIFF_H
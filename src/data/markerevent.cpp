@@ -0,0 +1,50 @@
+#include "markerevent.h"
+
+QJsonObject MarkerEvent::toJson() const {
+    QJsonObject obj;
+    obj["type"] = typeName(type);
+    obj["snapshotIndex"] = snapshotIndex;
+    obj["snapshotId"] = snapshotId;
+    obj["timestamp"] = timestamp.toString(Qt::ISODate);
+    obj["operator"] = operatorName;
+    obj["marker"] = marker.toJson();
+    return obj;
+}
+
+MarkerEvent MarkerEvent::fromJson(const QJsonObject& json) {
+    MarkerEvent event;
+    const QString type = json["type"].toString();
+    if (type == "updated") {
+        event.type = Updated;
+    } else if (type == "deleted") {
+        event.type = Deleted;
+    } else {
+        event.type = Added;
+    }
+    event.snapshotIndex = json["snapshotIndex"].toInt(-1);
+    event.snapshotId = json["snapshotId"].toString();
+    event.timestamp = QDateTime::fromString(json["timestamp"].toString(), Qt::ISODate);
+    event.operatorName = json["operator"].toString();
+    event.marker = Marker::fromJson(json["marker"].toObject());
+    return event;
+}
+
+QString MarkerEvent::typeName(Type type) {
+    switch (type) {
+        case Added: return "added";
+        case Updated: return "updated";
+        case Deleted: return "deleted";
+    }
+    return QString();
+}
+
+QString MarkerEvent::operatorFromDescription(const QString& description) {
+    // 与 MarkerManager / HttpServer 生成描述时使用的格式一致
+    const QString prefix = " (操作者: ";
+    int start = description.lastIndexOf(prefix);
+    if (start < 0 || !description.endsWith(')')) {
+        return QString();
+    }
+    start += prefix.length();
+    return description.mid(start, description.length() - start - 1);
+}
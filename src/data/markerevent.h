@@ -0,0 +1,61 @@
+#ifndef MARKEREVENT_H
+#define MARKEREVENT_H
+
+#include <QDateTime>
+#include <QJsonObject>
+#include <QString>
+#include "marker.h"
+
+/**
+ * @struct MarkerEvent
+ * @brief 标记生命周期中的一次事件
+ *
+ * 记录标记在哪个快照中被添加、修改或删除，以及操作者。
+ * 后端的标记历史索引和客户端的历史查看共用此结构。
+ */
+struct MarkerEvent {
+    /**
+     * @brief 事件类型
+     */
+    enum Type {
+        Added,      ///< 标记被添加
+        Updated,    ///< 标记内容被修改
+        Deleted     ///< 标记被删除
+    };
+
+    Type type = Added;          ///< 事件类型
+    int snapshotIndex = -1;     ///< 发生事件的快照序号
+    QString snapshotId;         ///< 发生事件的快照ID
+    QDateTime timestamp;        ///< 事件时间（即快照时间）
+    QString operatorName;       ///< 操作者（未知时为空）
+    Marker marker;              ///< 事件发生后的标记数据（删除事件为删除前的数据）
+
+    /**
+     * @brief 将事件转换为 JSON 对象
+     * @return JSON 对象
+     */
+    QJsonObject toJson() const;
+
+    /**
+     * @brief 从 JSON 对象创建事件
+     * @param json JSON 对象
+     * @return 事件对象
+     */
+    static MarkerEvent fromJson(const QJsonObject& json);
+
+    /**
+     * @brief 获取事件类型名称
+     * @param type 事件类型
+     * @return "added" / "updated" / "deleted"
+     */
+    static QString typeName(Type type);
+
+    /**
+     * @brief 从快照描述中提取操作者
+     * @param description 快照描述（形如 "添加标记: xxx (操作者: yyy)"）
+     * @return 操作者名称，没有则返回空字符串
+     */
+    static QString operatorFromDescription(const QString& description);
+};
+
+#endif // MARKEREVENT_H
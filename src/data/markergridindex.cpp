@@ -0,0 +1,45 @@
+#include "markergridindex.h"
+
+void MarkerGridIndex::reset(int columns, int rows) {
+    m_columns = qMax(1, columns);
+    m_rows = qMax(1, rows);
+    m_size = 0;
+    m_cells = QVector<QVector<Entry>>(m_columns * m_rows);
+}
+
+void MarkerGridIndex::clear() {
+    for (QVector<Entry>& cell : m_cells) {
+        cell.clear();
+    }
+    m_size = 0;
+}
+
+void MarkerGridIndex::insert(quint32 id, qint32 x, qint32 y) {
+    cellAt(x, y).append(Entry{id, x, y});
+    ++m_size;
+}
+
+bool MarkerGridIndex::remove(quint32 id, qint32 x, qint32 y) {
+    QVector<Entry>& cell = cellAt(x, y);
+    for (int i = 0; i < cell.size(); ++i) {
+        if (cell[i].id != id) {
+            continue;
+        }
+        // 网格内不要求顺序：与末项交换后删除
+        cell[i] = cell.last();
+        cell.removeLast();
+        --m_size;
+        return true;
+    }
+    return false;
+}
+
+int MarkerGridIndex::columnOf(qint32 x) const {
+    const qint64 column = qint64(x) * m_columns / qint64(CompactMarker::kCoordinateScale);
+    return int(qBound<qint64>(0, column, m_columns - 1));
+}
+
+int MarkerGridIndex::rowOf(qint32 y) const {
+    const qint64 row = qint64(y) * m_rows / qint64(CompactMarker::kCoordinateScale);
+    return int(qBound<qint64>(0, row, m_rows - 1));
+}
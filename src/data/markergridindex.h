@@ -0,0 +1,119 @@
+#ifndef MARKERGRIDINDEX_H
+#define MARKERGRIDINDEX_H
+
+#include <QRect>
+#include <QRectF>
+#include <QVector>
+
+#include "compactmarker.h"
+
+/**
+ * @class MarkerGridIndex
+ * @brief 标记位置的均匀网格索引
+ *
+ * 把归一化坐标空间 [0, 1] x [0, 1] 划分为 columns x rows 个网格，
+ * 每个网格保存落在其中的标记（ID 序号 + 定点坐标）。
+ * 超出范围的坐标归入边缘的网格，查询结果仍按精确坐标过滤。
+ *
+ * 范围查询只访问与矩形相交的网格，代价与矩形面积内的标记数有关，
+ * 与标记总数无关；插入为 O(1)，删除为所在网格内的线性查找。
+ *
+ * 以 ID 序号而不是 MarkerTable 行号索引：表删除时行号会变化。
+ */
+class MarkerGridIndex {
+public:
+    /**
+     * @brief 构造单个网格的空索引
+     */
+    MarkerGridIndex() { reset(1, 1); }
+
+    /**
+     * @brief 重新划分网格（清空所有标记）
+     * @param columns 列数（至少为 1）
+     * @param rows 行数（至少为 1）
+     */
+    void reset(int columns, int rows);
+
+    /**
+     * @brief 清空所有标记（保留网格划分）
+     */
+    void clear();
+
+    int columns() const { return m_columns; }
+    int rows() const { return m_rows; }
+
+    /**
+     * @brief 标记数量
+     */
+    int size() const { return m_size; }
+
+    /**
+     * @brief 加入一个标记
+     * @param id 标记ID序号
+     * @param x 定点 x 坐标
+     * @param y 定点 y 坐标
+     */
+    void insert(quint32 id, qint32 x, qint32 y);
+
+    /**
+     * @brief 移除一个标记
+     * @param id 标记ID序号
+     * @param x 加入时的定点 x 坐标（用于定位网格）
+     * @param y 加入时的定点 y 坐标
+     * @return 找到并移除返回 true
+     */
+    bool remove(quint32 id, qint32 x, qint32 y);
+
+    /**
+     * @brief 遍历归一化矩形内（含边界）的标记
+     * @param normalizedRect 归一化矩形
+     * @param visit 参数为 (ID序号, 定点 x, 定点 y)
+     */
+    template <typename Visit>
+    void forEachInRect(const QRectF& normalizedRect, const Visit& visit) const;
+
+private:
+    /**
+     * @brief 一个标记的索引项
+     */
+    struct Entry {
+        quint32 id;
+        qint32 x;
+        qint32 y;
+    };
+
+    int columnOf(qint32 x) const;
+    int rowOf(qint32 y) const;
+    QVector<Entry>& cellAt(qint32 x, qint32 y) { return m_cells[rowOf(y) * m_columns + columnOf(x)]; }
+
+private:
+    int m_columns = 1;
+    int m_rows = 1;
+    int m_size = 0;
+    QVector<QVector<Entry>> m_cells;    ///< 网格（按行存放）
+};
+
+template <typename Visit>
+void MarkerGridIndex::forEachInRect(const QRectF& normalizedRect, const Visit& visit) const {
+    const QRectF rect = normalizedRect.normalized();
+    const qint32 left = CompactMarker::toFixed(rect.left());
+    const qint32 right = CompactMarker::toFixed(rect.right());
+    const qint32 top = CompactMarker::toFixed(rect.top());
+    const qint32 bottom = CompactMarker::toFixed(rect.bottom());
+
+    const int firstColumn = columnOf(left);
+    const int lastColumn = columnOf(right);
+    const int lastRow = rowOf(bottom);
+    for (int row = rowOf(top); row <= lastRow; ++row) {
+        const QVector<Entry>* cell = m_cells.constData() + row * m_columns + firstColumn;
+        for (int column = firstColumn; column <= lastColumn; ++column, ++cell) {
+            for (const Entry& entry : *cell) {
+                if (entry.x >= left && entry.x <= right && entry.y >= top && entry.y <= bottom) {
+                    visit(entry.id, entry.x, entry.y);
+                }
+            }
+        }
+    }
+}
+
+#endif // MARKERGRIDINDEX_H
@@ -0,0 +1,102 @@
+#include "markerpatch.h"
+#include <QStringList>
+
+#include "dataschema.h"
+
+Marker MarkerPatch::applyTo(const Marker& marker) const {
+    Marker result = marker;
+    if (fields & Position) {
+        result.setPosition(position);
+    }
+    if (fields & Note) {
+        result.setNote(note);
+    }
+    if (fields & Color) {
+        result.setColor(color);
+    }
+    return result;
+}
+
+MarkerPatch MarkerPatch::between(const Marker& from, const Marker& to) {
+    MarkerPatch patch;
+    patch.markerId = to.id();
+    if (from.position() != to.position()) {
+        patch.fields |= Position;
+        patch.position = to.position();
+    }
+    if (from.note() != to.note()) {
+        patch.fields |= Note;
+        patch.note = to.note();
+    }
+    if (from.color() != to.color()) {
+        patch.fields |= Color;
+        patch.color = to.color();
+    }
+    return patch;
+}
+
+QJsonObject MarkerPatch::toJson() const {
+    // 字段编码与 Marker 的 JSON 一致
+    QJsonObject obj;
+    if (fields & Position) {
+        obj["x"] = DataSchema::ValueTraits<double>::toJson(position.x());
+        obj["y"] = DataSchema::ValueTraits<double>::toJson(position.y());
+    }
+    if (fields & Note) {
+        obj["note"] = DataSchema::ValueTraits<QString>::toJson(note);
+    }
+    if (fields & Color) {
+        obj["color"] = DataSchema::ValueTraits<QColor>::toJson(color);
+    }
+    return obj;
+}
+
+bool MarkerPatch::fromJson(const QString& markerId, const QJsonObject& json, MarkerPatch* patch) {
+    MarkerPatch result;
+    result.markerId = markerId;
+
+    const bool hasX = json.contains("x");
+    const bool hasY = json.contains("y");
+    if (hasX != hasY) {
+        return false;
+    }
+    if (hasX) {
+        if (!json["x"].isDouble() || !json["y"].isDouble()) {
+            return false;
+        }
+        result.fields |= Position;
+        result.position = QPointF(DataSchema::ValueTraits<double>::fromJson(json["x"]),
+                                  DataSchema::ValueTraits<double>::fromJson(json["y"]));
+    }
+    if (json.contains("note")) {
+        if (!json["note"].isString()) {
+            return false;
+        }
+        result.fields |= Note;
+        result.note = DataSchema::ValueTraits<QString>::fromJson(json["note"]);
+    }
+    if (json.contains("color")) {
+        result.color = DataSchema::ValueTraits<QColor>::fromJson(json["color"]);
+        if (!result.color.isValid()) {
+            return false;
+        }
+        result.fields |= Color;
+    }
+
+    *patch = result;
+    return true;
+}
+
+QString MarkerPatch::describe(const QString& note) const {
+    QStringList names;
+    if (fields & Position) {
+        names << "位置";
+    }
+    if (fields & Note) {
+        names << "备注";
+    }
+    if (fields & Color) {
+        names << "颜色";
+    }
+    return QString("修改标记: %1 [%2]").arg(note.left(20), names.join(", "));
+}
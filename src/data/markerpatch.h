@@ -0,0 +1,83 @@
+#ifndef MARKERPATCH_H
+#define MARKERPATCH_H
+
+#include <QColor>
+#include <QJsonObject>
+#include <QPointF>
+#include <QString>
+#include "marker.h"
+
+/**
+ * @struct MarkerPatch
+ * @brief 对一个标记的字段级修改
+ *
+ * 只携带发生变化的字段（位置、备注、颜色），ID、创建时间和创建者不可修改。
+ * 客户端的修改操作、PATCH /api/map/markers/{id} 的请求体都使用它，
+ * 拖动标记时只传输新的坐标。
+ */
+struct MarkerPatch {
+    /**
+     * @brief 可修改的字段
+     */
+    enum Field {
+        Position = 0x1,     ///< 位置
+        Note = 0x2,         ///< 备注
+        Color = 0x4         ///< 颜色
+    };
+    Q_DECLARE_FLAGS(Fields, Field)
+
+    QString markerId;       ///< 被修改的标记ID
+    Fields fields;          ///< 发生变化的字段
+    QPointF position;       ///< 新位置（fields 含 Position 时有效）
+    QString note;           ///< 新备注（fields 含 Note 时有效）
+    QColor color;           ///< 新颜色（fields 含 Color 时有效）
+
+    /**
+     * @brief 是否没有修改任何字段
+     */
+    bool isEmpty() const { return fields == Fields(); }
+
+    /**
+     * @brief 应用到标记上
+     * @param marker 修改前的标记
+     * @return 修改后的标记
+     */
+    Marker applyTo(const Marker& marker) const;
+
+    /**
+     * @brief 计算两个版本之间的修改
+     * @param from 修改前的标记
+     * @param to 修改后的标记
+     * @return 只包含变化字段的修改
+     */
+    static MarkerPatch between(const Marker& from, const Marker& to);
+
+    /**
+     * @brief 转换为 JSON 对象（只包含变化的字段，字段名与 Marker 一致）
+     * @return JSON 对象
+     */
+    QJsonObject toJson() const;
+
+    /**
+     * @brief 从 JSON 对象读取修改
+     * @param markerId 被修改的标记ID（来自请求路径）
+     * @param json JSON 对象（x 和 y 必须同时出现）
+     * @param patch 输出的修改
+     * @return 格式正确返回 true
+     */
+    static bool fromJson(const QString& markerId, const QJsonObject& json, MarkerPatch* patch);
+
+    /**
+     * @brief 生成修改描述（形如 "修改标记: xxx [位置, 备注]"）
+     *
+     * 字段列表用方括号，避免与调用方追加的 " (操作者: …)" 后缀混淆
+     * （见 MarkerEvent::operatorFromDescription()）。
+     * @param note 标记备注
+     * @return 描述文本
+     */
+    QString describe(const QString& note) const;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(MarkerPatch::Fields)
+
+#endif // MARKERPATCH_H
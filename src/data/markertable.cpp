@@ -0,0 +1,168 @@
+#include "markertable.h"
+#include "persistentmarkermap.h"
+#include "stringpool.h"
+#include <utility>
+
+MarkerTable::MarkerTable(const MarkerTable& other)
+    : m_columns(other.m_columns), m_rows(other.m_rows) {
+    for (int row = 0; row < size(); ++row) {
+        record(row).retainStrings();
+    }
+}
+
+MarkerTable& MarkerTable::operator=(const MarkerTable& other) {
+    if (this != &other) {
+        MarkerTable copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+MarkerTable::MarkerTable(MarkerTable&& other) noexcept {
+    std::swap(m_columns, other.m_columns);
+    std::swap(m_rows, other.m_rows);
+}
+
+MarkerTable& MarkerTable::operator=(MarkerTable&& other) noexcept {
+    std::swap(m_columns, other.m_columns);
+    std::swap(m_rows, other.m_rows);
+    other.clear();
+    return *this;
+}
+
+MarkerTable::~MarkerTable() {
+    clear();
+}
+
+MarkerTable MarkerTable::fromList(const QList<Marker>& markers) {
+    MarkerTable table;
+    table.reserve(markers.size());
+    for (const Marker& marker : markers) {
+        table.insert(marker);
+    }
+    return table;
+}
+
+MarkerTable MarkerTable::fromMap(const PersistentMarkerMap& markers) {
+    MarkerTable table;
+    table.reserve(markers.size());
+    markers.forEachCompact([&table](const CompactMarker& marker) {
+        table.insert(marker);
+    });
+    return table;
+}
+
+void MarkerTable::clear() {
+    for (int row = 0; row < size(); ++row) {
+        record(row).releaseStrings();
+    }
+    DataSchema::forEachColumn<Marker>(m_columns, [](const auto&, auto& column) {
+        column.clear();
+    });
+    m_rows.clear();
+}
+
+void MarkerTable::reserve(int count) {
+    DataSchema::forEachColumn<Marker>(m_columns, [count](const auto&, auto& column) {
+        column.reserve(count);
+    });
+    m_rows.reserve(count);
+}
+
+int MarkerTable::insert(const CompactMarker& marker) {
+    int row = rowOf(marker.id);
+    if (row < 0) {
+        row = size();
+        marker.retainStrings();
+        DataSchema::forEachColumn<Marker>(m_columns, [&marker](const auto& field, auto& column) {
+            column.append(field.getCompact(marker));
+        });
+        m_rows.insert(marker.id, row);
+        return row;
+    }
+
+    marker.retainStrings();
+    record(row).releaseStrings();
+    DataSchema::forEachColumn<Marker>(m_columns, [&marker, row](const auto& field, auto& column) {
+        column[row] = field.getCompact(marker);
+    });
+    return row;
+}
+
+void MarkerTable::removeAt(int row) {
+    const int last = size() - 1;
+    record(row).releaseStrings();
+    m_rows.remove(idAt(row));
+
+    // 末行移动到被删除的位置，保持数组紧凑
+    DataSchema::forEachColumn<Marker>(m_columns, [row, last](const auto&, auto& column) {
+        if (row != last) {
+            column[row] = column[last];
+        }
+        column.removeLast();
+    });
+    if (row != last) {
+        m_rows[idAt(row)] = row;
+    }
+}
+
+bool MarkerTable::remove(const QString& markerId) {
+    const int row = rowOf(markerId);
+    if (row < 0) {
+        return false;
+    }
+    removeAt(row);
+    return true;
+}
+
+int MarkerTable::rowOf(const QString& markerId) const {
+    const qint64 id = StringPool::markerStrings().indexOf(markerId);
+    return id < 0 ? -1 : rowOf(static_cast<quint32>(id));
+}
+
+CompactMarker MarkerTable::record(int row) const {
+    CompactMarker marker;
+    DataSchema::forEachColumn<Marker>(m_columns, [&marker, row](const auto& field, const auto& column) {
+        field.setCompact(marker, column[row]);
+    });
+    return marker;
+}
+
+QList<Marker> MarkerTable::markers() const {
+    QList<Marker> result;
+    result.reserve(size());
+    for (int row = 0; row < size(); ++row) {
+        result.append(marker(row));
+    }
+    return result;
+}
+
+MarkerTable::Diff MarkerTable::diff(const MarkerTable& from, const MarkerTable& to) {
+    Diff result;
+
+    for (int row = 0; row < to.size(); ++row) {
+        const int fromRow = from.rowOf(to.idAt(row));
+        if (fromRow < 0) {
+            result.added.append(row);
+        } else if (from.record(fromRow) != to.record(row)) {
+            result.updated.append(row);
+        }
+    }
+
+    for (int row = 0; row < from.size(); ++row) {
+        if (to.rowOf(from.idAt(row)) < 0) {
+            result.removed.append(row);
+        }
+    }
+
+    return result;
+}
+
+qint64 MarkerTable::memoryUsage() const {
+    qint64 bytes = 0;
+    DataSchema::forEachColumn<Marker>(m_columns, [&bytes](const auto&, const auto& column) {
+        bytes += column.capacity() * qint64(sizeof(column.front()));
+    });
+    bytes += m_rows.capacity() * qint64(sizeof(quint32) + sizeof(int) + sizeof(void*));
+    return bytes;
+}
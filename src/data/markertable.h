@@ -0,0 +1,195 @@
+#ifndef MARKERTABLE_H
+#define MARKERTABLE_H
+
+#include <QHash>
+#include <QList>
+#include <QPointF>
+#include <QVector>
+
+#include "compactmarker.h"
+#include "dataschema.h"
+#include "marker.h"
+
+/**
+ * @class MarkerTable
+ * @brief 列式（struct-of-arrays）标记表
+ *
+ * 每个字段单独存放在连续数组中，适合只关心部分字段的批量操作：
+ * 绘制（坐标 + 颜色）、差异比较（ID + 记录）。
+ * 列由 Schema<Marker> 的声明生成（DataSchema::CompactColumns），每个字段一列，
+ * 存放该字段在 CompactMarker 中的紧凑值；字符串字段保存 StringPool::markerStrings() 中的序号，
+ * 需要完整数据时通过 marker() 展开为 Marker。每一行持有其字符串的引用。
+ *
+ * 删除采用"与末行交换"的方式，行号在删除后可能变化。
+ */
+class MarkerTable {
+public:
+    /**
+     * @brief 两张表之间的差异（以行号表示）
+     */
+    struct Diff {
+        QVector<int> added;     ///< 新表中新增的行
+        QVector<int> removed;   ///< 旧表中被删除的行
+        QVector<int> updated;   ///< 新表中内容变化的行
+    };
+
+    /**
+     * @brief 构造空表
+     */
+    MarkerTable() = default;
+
+    /**
+     * @brief 复制（各行的字符串引用计数随之增加）
+     */
+    MarkerTable(const MarkerTable& other);
+    MarkerTable& operator=(const MarkerTable& other);
+    MarkerTable(MarkerTable&& other) noexcept;
+    MarkerTable& operator=(MarkerTable&& other) noexcept;
+
+    /**
+     * @brief 析构函数（释放各行的字符串引用）
+     */
+    ~MarkerTable();
+
+    /**
+     * @brief 从标记列表构建
+     * @param markers 标记列表
+     * @return 标记表
+     */
+    static MarkerTable fromList(const QList<Marker>& markers);
+
+    /**
+     * @brief 从持久化标记集合构建（不展开字符串）
+     * @param markers 标记集合
+     * @return 标记表
+     */
+    static MarkerTable fromMap(const PersistentMarkerMap& markers);
+
+    /**
+     * @brief 行数
+     */
+    int size() const { return static_cast<int>(column<kId>().size()); }
+
+    /**
+     * @brief 是否为空
+     */
+    bool isEmpty() const { return column<kId>().isEmpty(); }
+
+    /**
+     * @brief 清空
+     */
+    void clear();
+
+    /**
+     * @brief 预留容量
+     * @param count 行数
+     */
+    void reserve(int count);
+
+    /**
+     * @brief 追加或替换一行（ID 已存在时原地替换）
+     * @param marker 紧凑记录
+     * @return 行号
+     */
+    int insert(const CompactMarker& marker);
+
+    /**
+     * @brief 追加或替换一行
+     * @param marker 标记
+     * @return 行号
+     */
+    int insert(const Marker& marker) { return insert(CompactMarker::fromMarker(marker)); }
+
+    /**
+     * @brief 删除一行（与末行交换后删除）
+     * @param row 行号
+     */
+    void removeAt(int row);
+
+    /**
+     * @brief 按ID删除
+     * @param markerId 标记ID
+     * @return 存在并被删除返回 true
+     */
+    bool remove(const QString& markerId);
+
+    /**
+     * @brief 按ID序号查找行号
+     * @param id 标记ID的字符串序号
+     * @return 行号，不存在返回 -1
+     */
+    int rowOf(quint32 id) const { return m_rows.value(id, -1); }
+
+    /**
+     * @brief 按ID查找行号
+     * @param markerId 标记ID
+     * @return 行号，不存在返回 -1
+     */
+    int rowOf(const QString& markerId) const;
+
+    // ========== 列访问 ==========
+    quint32 idAt(int row) const { return column<kId>()[row]; }
+    QPointF positionAt(int row) const {
+        return QPointF(CompactMarker::fromFixed(column<kX>()[row]), CompactMarker::fromFixed(column<kY>()[row]));
+    }
+    QRgb colorAt(int row) const { return column<kColor>()[row]; }
+    CompactTime createTimeAt(int row) const { return column<kCreateTime>()[row]; }
+    quint32 noteAt(int row) const { return column<kNote>()[row]; }
+    quint32 createdByAt(int row) const { return column<kCreatedBy>()[row]; }
+
+    /**
+     * @brief 获取一行的紧凑记录
+     * @param row 行号
+     */
+    CompactMarker record(int row) const;
+
+    /**
+     * @brief 获取一行的 Marker 视图
+     * @param row 行号
+     * @return 展开后的标记
+     */
+    Marker marker(int row) const { return record(row).toMarker(); }
+
+    /**
+     * @brief 获取全部标记
+     * @return 标记列表（按行顺序）
+     */
+    QList<Marker> markers() const;
+
+    /**
+     * @brief 比较两张表
+     * @param from 变化前
+     * @param to 变化后
+     * @return 以行号表示的差异
+     */
+    static Diff diff(const MarkerTable& from, const MarkerTable& to);
+
+    /**
+     * @brief 估算占用的内存（不含字符串池）
+     * @return 字节数
+     */
+    qint64 memoryUsage() const;
+
+private:
+    using Columns = DataSchema::CompactColumns<Marker>;
+
+    // 各字段的列号（即在 Schema<Marker> 中的声明序号）
+    static constexpr int kColor = DataSchema::fieldIndex<Marker>("color");
+    static constexpr int kCreateTime = DataSchema::fieldIndex<Marker>("createTime");
+    static constexpr int kCreatedBy = DataSchema::fieldIndex<Marker>("createdBy");
+    static constexpr int kId = DataSchema::fieldIndex<Marker>("id");
+    static constexpr int kNote = DataSchema::fieldIndex<Marker>("note");
+    static constexpr int kX = DataSchema::fieldIndex<Marker>("x");
+    static constexpr int kY = DataSchema::fieldIndex<Marker>("y");
+    static_assert(kColor >= 0 && kCreateTime >= 0 && kCreatedBy >= 0 && kId >= 0 && kNote >= 0
+                      && kX >= 0 && kY >= 0,
+                  "MarkerTable column is missing from Schema<Marker>");
+
+    template <int I>
+    const auto& column() const { return std::get<I>(m_columns); }
+
+    Columns m_columns;              ///< 每个字段一列（按 Schema<Marker> 的声明顺序）
+    QHash<quint32, int> m_rows;     ///< ID 序号 -> 行号
+};
+
+#endif // MARKERTABLE_H
@@ -0,0 +1,453 @@
+#include "persistentmarkermap.h"
+#include "stringpool.h"
+#include <QtAlgorithms>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr int kBitsPerLevel = 5;        ///< 每层使用的哈希位数（32 路分支）
+constexpr quint32 kLevelMask = 0x1f;    ///< 取一层槽位的掩码
+
+/**
+ * @brief ID序号的哈希（MurmurHash3 的 fmix32，可逆，不同序号的哈希必然不同）
+ */
+quint32 idHash(quint32 id) {
+    id ^= id >> 16;
+    id *= 0x85ebca6bu;
+    id ^= id >> 13;
+    id *= 0xc2b2ae35u;
+    id ^= id >> 16;
+    return id;
+}
+
+/**
+ * @brief 紧凑形式的差异（内部使用，最后再展开为 MarkerDiff）
+ */
+struct CompactDiff {
+    std::vector<CompactMarker> added;
+    std::vector<CompactMarker> removed;
+    std::vector<CompactMarker> updated;
+};
+
+} // namespace
+
+/**
+ * @brief 字典树节点（创建后不可变）
+ *
+ * 用位图记录被占用的槽位，entries 只按顺序保存被占用的槽。
+ */
+struct PersistentMarkerMap::Node {
+    /**
+     * 叶子持有记录中字符串的引用（每个副本各计一次），
+     * 节点释放时一并释放，不再被任何版本引用的字符串随后由字符串池回收。
+     */
+    struct Entry {
+        NodePtr child;          ///< 非空表示子节点，否则为叶子
+        CompactMarker marker;   ///< 叶子数据（子节点项为空记录）
+
+        Entry() = default;
+        Entry(NodePtr childNode, const CompactMarker& leaf) : child(std::move(childNode)), marker(leaf) {
+            marker.retainStrings();
+        }
+        Entry(const Entry& other) : child(other.child), marker(other.marker) {
+            marker.retainStrings();
+        }
+        Entry(Entry&& other) noexcept : child(std::move(other.child)), marker(other.marker) {
+            other.marker = CompactMarker();
+        }
+        Entry& operator=(Entry other) noexcept {
+            std::swap(child, other.child);
+            std::swap(marker, other.marker);
+            return *this;
+        }
+        ~Entry() { marker.releaseStrings(); }
+    };
+
+    quint32 bitmap = 0;             ///< 槽位占用位图
+    std::vector<Entry> entries;     ///< 被占用的槽位（按槽位顺序）
+};
+
+/**
+ * @brief 字典树的递归操作
+ */
+struct PersistentMarkerMap::Ops {
+    using Entry = Node::Entry;
+
+    static int slotOf(quint32 hash, int shift) {
+        return static_cast<int>((hash >> shift) & kLevelMask);
+    }
+
+    static int positionOf(quint32 bitmap, quint32 bit) {
+        return static_cast<int>(qPopulationCount(bitmap & (bit - 1)));
+    }
+
+    static Entry childEntry(const NodePtr& child) {
+        return Entry{child, CompactMarker()};
+    }
+
+    static NodePtr makePair(int shift, const Entry& a, const Entry& b) {
+        // 哈希可逆，两个不同ID的哈希至少有一位不同，最迟在第 7 层（位移 30）分开
+        Q_ASSERT(shift < 32);
+
+        auto node = std::make_shared<Node>();
+        const int slotA = slotOf(idHash(a.marker.id), shift);
+        const int slotB = slotOf(idHash(b.marker.id), shift);
+        if (slotA == slotB) {
+            // 本层仍然冲突，继续向下分裂
+            node->bitmap = 1u << slotA;
+            node->entries.push_back(childEntry(makePair(shift + kBitsPerLevel, a, b)));
+        } else {
+            node->bitmap = (1u << slotA) | (1u << slotB);
+            if (slotA < slotB) {
+                node->entries = {a, b};
+            } else {
+                node->entries = {b, a};
+            }
+        }
+        return node;
+    }
+
+    static NodePtr insert(const NodePtr& node, int shift, quint32 hash,
+                          const Entry& leaf, bool& added) {
+        if (!node) {
+            auto created = std::make_shared<Node>();
+            created->bitmap = 1u << slotOf(hash, shift);
+            created->entries.push_back(leaf);
+            added = true;
+            return created;
+        }
+
+        const quint32 bit = 1u << slotOf(hash, shift);
+        const int pos = positionOf(node->bitmap, bit);
+
+        // 空槽位：直接放入叶子
+        if (!(node->bitmap & bit)) {
+            auto copy = std::make_shared<Node>(*node);
+            copy->bitmap |= bit;
+            copy->entries.insert(copy->entries.begin() + pos, leaf);
+            added = true;
+            return copy;
+        }
+
+        const Entry& existing = node->entries[pos];
+        Entry replacement;
+        if (existing.child) {
+            NodePtr child = insert(existing.child, shift + kBitsPerLevel, hash, leaf, added);
+            if (child == existing.child) {
+                return node;
+            }
+            replacement = childEntry(child);
+        } else if (existing.marker.id == leaf.marker.id) {
+            if (existing.marker == leaf.marker) {
+                return node;  // 内容未变，保持共享
+            }
+            replacement = leaf;
+        } else {
+            // 槽位被另一个叶子占用：分裂为子节点
+            replacement = childEntry(makePair(shift + kBitsPerLevel, existing, leaf));
+            added = true;
+        }
+
+        auto copy = std::make_shared<Node>(*node);
+        copy->entries[pos] = replacement;
+        return copy;
+    }
+
+    static NodePtr remove(const NodePtr& node, int shift, quint32 hash,
+                          quint32 id, bool& removed) {
+        if (!node) {
+            return node;
+        }
+
+        const quint32 bit = 1u << slotOf(hash, shift);
+        if (!(node->bitmap & bit)) {
+            return node;
+        }
+        const int pos = positionOf(node->bitmap, bit);
+        const Entry& existing = node->entries[pos];
+
+        if (existing.child) {
+            NodePtr child = remove(existing.child, shift + kBitsPerLevel, hash, id, removed);
+            if (child == existing.child) {
+                return node;
+            }
+            if (child) {
+                auto copy = std::make_shared<Node>(*node);
+                // 子节点只剩一个叶子时上提，保持结构紧凑
+                if (child->entries.size() == 1 && !child->entries.front().child) {
+                    copy->entries[pos] = child->entries.front();
+                } else {
+                    copy->entries[pos] = childEntry(child);
+                }
+                return copy;
+            }
+            // 子节点已空：删除该槽位
+        } else if (existing.marker.id != id) {
+            return node;
+        } else {
+            removed = true;
+        }
+
+        if (node->entries.size() == 1) {
+            return nullptr;
+        }
+        auto copy = std::make_shared<Node>(*node);
+        copy->bitmap &= ~bit;
+        copy->entries.erase(copy->entries.begin() + pos);
+        return copy;
+    }
+
+    template <typename Visitor>
+    static void visit(const Node* node, Visitor&& visitor) {
+        for (const Entry& entry : node->entries) {
+            if (entry.child) {
+                visit(entry.child.get(), visitor);
+            } else {
+                visitor(entry.marker);
+            }
+        }
+    }
+
+    static void collectEntry(const Entry& entry, std::vector<CompactMarker>& out) {
+        if (entry.child) {
+            visit(entry.child.get(), [&out](const CompactMarker& marker) { out.push_back(marker); });
+        } else {
+            out.push_back(entry.marker);
+        }
+    }
+
+    /**
+     * @brief 单个叶子与一棵子树比较
+     * @param leaf 叶子
+     * @param subtree 子树中的全部记录
+     * @param leafIsFrom 叶子是否属于变化前的版本
+     */
+    static void diffLeafWithSubtree(const CompactMarker& leaf,
+                                    const std::vector<CompactMarker>& subtree,
+                                    bool leafIsFrom, CompactDiff& diff) {
+        std::vector<CompactMarker>& others = leafIsFrom ? diff.added : diff.removed;
+        bool matched = false;
+        for (const CompactMarker& marker : subtree) {
+            if (marker.id != leaf.id) {
+                others.push_back(marker);
+                continue;
+            }
+            matched = true;
+            if (marker != leaf) {
+                diff.updated.push_back(leafIsFrom ? marker : leaf);
+            }
+        }
+        if (!matched) {
+            (leafIsFrom ? diff.removed : diff.added).push_back(leaf);
+        }
+    }
+
+    static void diffEntries(const Entry& a, const Entry& b, int shift, CompactDiff& diff) {
+        if (a.child && b.child) {
+            diffNodes(a.child, b.child, shift + kBitsPerLevel, diff);
+            return;
+        }
+
+        if (!a.child && !b.child) {
+            if (a.marker.id == b.marker.id) {
+                if (a.marker != b.marker) {
+                    diff.updated.push_back(b.marker);
+                }
+            } else {
+                diff.removed.push_back(a.marker);
+                diff.added.push_back(b.marker);
+            }
+            return;
+        }
+
+        // 一侧是叶子、另一侧是子树：展开子树后按ID比较
+        std::vector<CompactMarker> subtree;
+        if (a.child) {
+            collectEntry(a, subtree);
+            diffLeafWithSubtree(b.marker, subtree, false, diff);
+        } else {
+            collectEntry(b, subtree);
+            diffLeafWithSubtree(a.marker, subtree, true, diff);
+        }
+    }
+
+    static void diffNodes(const NodePtr& a, const NodePtr& b, int shift, CompactDiff& diff) {
+        if (a == b) {
+            return;  // 共享子树，没有变化
+        }
+        if (!a) {
+            visit(b.get(), [&diff](const CompactMarker& marker) { diff.added.push_back(marker); });
+            return;
+        }
+        if (!b) {
+            visit(a.get(), [&diff](const CompactMarker& marker) { diff.removed.push_back(marker); });
+            return;
+        }
+
+        quint32 slots = a->bitmap | b->bitmap;
+        while (slots) {
+            const quint32 bit = slots & (~slots + 1);  // 最低位的槽位
+            slots &= slots - 1;
+
+            const bool inA = a->bitmap & bit;
+            const bool inB = b->bitmap & bit;
+            if (inA && inB) {
+                diffEntries(a->entries[positionOf(a->bitmap, bit)],
+                            b->entries[positionOf(b->bitmap, bit)], shift, diff);
+            } else if (inA) {
+                collectEntry(a->entries[positionOf(a->bitmap, bit)], diff.removed);
+            } else {
+                collectEntry(b->entries[positionOf(b->bitmap, bit)], diff.added);
+            }
+        }
+    }
+};
+
+PersistentMarkerMap PersistentMarkerMap::fromList(const QList<Marker>& markers) {
+    PersistentMarkerMap map;
+    for (const Marker& marker : markers) {
+        map.insert(marker);
+    }
+    return map;
+}
+
+const CompactMarker* PersistentMarkerMap::find(quint32 id) const {
+    const quint32 hash = idHash(id);
+    const Node* node = m_root.get();
+    int shift = 0;
+
+    while (node) {
+        const quint32 bit = 1u << Ops::slotOf(hash, shift);
+        if (!(node->bitmap & bit)) {
+            return nullptr;
+        }
+        const Node::Entry& entry = node->entries[Ops::positionOf(node->bitmap, bit)];
+        if (!entry.child) {
+            return entry.marker.id == id ? &entry.marker : nullptr;
+        }
+        node = entry.child.get();
+        shift += kBitsPerLevel;
+    }
+
+    return nullptr;
+}
+
+const CompactMarker* PersistentMarkerMap::find(const QString& markerId) const {
+    // 从未驻留过的ID不可能在任何集合中
+    const qint64 id = StringPool::markerStrings().indexOf(markerId);
+    return id < 0 ? nullptr : find(static_cast<quint32>(id));
+}
+
+Marker PersistentMarkerMap::value(const QString& markerId) const {
+    const CompactMarker* marker = find(markerId);
+    return marker ? marker->toMarker() : Marker();
+}
+
+void PersistentMarkerMap::insert(const Marker& marker) {
+    insert(CompactMarker::fromMarker(marker));
+}
+
+void PersistentMarkerMap::insert(const CompactMarker& marker) {
+    bool added = false;
+    m_root = Ops::insert(m_root, 0, idHash(marker.id), Node::Entry{nullptr, marker}, added);
+    if (added) {
+        ++m_size;
+    }
+}
+
+bool PersistentMarkerMap::remove(const QString& markerId) {
+    const qint64 id = StringPool::markerStrings().indexOf(markerId);
+    return id >= 0 && remove(static_cast<quint32>(id));
+}
+
+bool PersistentMarkerMap::remove(quint32 id) {
+    bool removed = false;
+    m_root = Ops::remove(m_root, 0, idHash(id), id, removed);
+    if (removed) {
+        --m_size;
+    }
+    return removed;
+}
+
+void PersistentMarkerMap::apply(const MarkerDiff& diff) {
+    for (const Marker& marker : diff.removed) {
+        remove(marker.id());
+    }
+    for (const Marker& marker : diff.updated) {
+        insert(marker);
+    }
+    for (const Marker& marker : diff.added) {
+        insert(marker);
+    }
+}
+
+QList<Marker> PersistentMarkerMap::values() const {
+    QList<Marker> markers;
+    markers.reserve(m_size);
+    forEachCompact([&markers](const CompactMarker& marker) {
+        markers.append(marker.toMarker());
+    });
+    return markers;
+}
+
+void PersistentMarkerMap::forEach(const std::function<void(const Marker&)>& visitor) const {
+    forEachCompact([&visitor](const CompactMarker& marker) {
+        visitor(marker.toMarker());
+    });
+}
+
+void PersistentMarkerMap::forEachCompact(const std::function<void(const CompactMarker&)>& visitor) const {
+    if (m_root) {
+        Ops::visit(m_root.get(), visitor);
+    }
+}
+
+PersistentMarkerMap PersistentMarkerMap::rebasedOn(const PersistentMarkerMap& base) const {
+    CompactDiff changes;
+    Ops::diffNodes(base.m_root, m_root, 0, changes);
+
+    PersistentMarkerMap result = base;
+    for (const CompactMarker& marker : changes.removed) {
+        result.remove(marker.id);
+    }
+    for (const CompactMarker& marker : changes.updated) {
+        result.insert(marker);
+    }
+    for (const CompactMarker& marker : changes.added) {
+        result.insert(marker);
+    }
+    return result;
+}
+
+MarkerDiff PersistentMarkerMap::diff(const PersistentMarkerMap& from, const PersistentMarkerMap& to) {
+    CompactDiff changes;
+    Ops::diffNodes(from.m_root, to.m_root, 0, changes);
+
+    MarkerDiff result;
+    for (const CompactMarker& marker : changes.added) {
+        result.added.append(marker.toMarker());
+    }
+    for (const CompactMarker& marker : changes.removed) {
+        result.removed.append(marker.toMarker());
+    }
+    for (const CompactMarker& marker : changes.updated) {
+        result.updated.append(marker.toMarker());
+    }
+    return result;
+}
+
+void PersistentMarkerMap::diffCompact(const PersistentMarkerMap& from, const PersistentMarkerMap& to,
+                                      std::vector<CompactMarker>* upserts,
+                                      std::vector<quint32>* removedIds) {
+    CompactDiff changes;
+    Ops::diffNodes(from.m_root, to.m_root, 0, changes);
+
+    removedIds->reserve(removedIds->size() + changes.removed.size());
+    for (const CompactMarker& marker : changes.removed) {
+        removedIds->push_back(marker.id);
+    }
+    upserts->reserve(upserts->size() + changes.updated.size() + changes.added.size());
+    upserts->insert(upserts->end(), changes.updated.begin(), changes.updated.end());
+    upserts->insert(upserts->end(), changes.added.begin(), changes.added.end());
+}
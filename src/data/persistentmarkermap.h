@@ -0,0 +1,176 @@
+#ifndef PERSISTENTMARKERMAP_H
+#define PERSISTENTMARKERMAP_H
+
+#include <QList>
+#include <QString>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "compactmarker.h"
+#include "marker.h"
+#include "markerdiff.h"
+
+/**
+ * @class PersistentMarkerMap
+ * @brief 持久化（结构共享）的标记集合：标记ID -> 标记
+ *
+ * 基于哈希数组映射字典树（HAMT）实现，每层按哈希值的 5 位分出 32 路。
+ * 修改操作只复制从根到目标叶子的路径，其余节点与旧版本共享，因此：
+ * - 复制整个集合是 O(1)（只复制根指针）
+ * - 插入/删除是 O(log n) 的时间和内存
+ * - 比较两个共享结构的版本时会跳过相同的子树，代价与变化量成正比
+ *
+ * 叶子保存 40 字节的 CompactMarker，键是ID的字符串序号，
+ * 经过可逆的整数哈希后分布到各层，不会出现哈希冲突。
+ * 节点创建后不再修改，不同线程可以安全地同时读取同一个版本。
+ */
+class PersistentMarkerMap {
+public:
+    /**
+     * @brief 构造空集合
+     */
+    PersistentMarkerMap() = default;
+
+    /**
+     * @brief 从标记列表构建集合
+     * @param markers 标记列表（ID 重复时后者覆盖前者）
+     * @return 新集合
+     */
+    static PersistentMarkerMap fromList(const QList<Marker>& markers);
+
+    /**
+     * @brief 获取标记数量
+     */
+    int size() const { return m_size; }
+
+    /**
+     * @brief 是否为空
+     */
+    bool isEmpty() const { return m_size == 0; }
+
+    /**
+     * @brief 判断是否包含指定标记
+     * @param markerId 标记ID
+     */
+    bool contains(const QString& markerId) const { return find(markerId) != nullptr; }
+
+    /**
+     * @brief 按ID序号查找紧凑记录
+     * @param id 标记ID在 StringPool::markerStrings() 中的序号
+     * @return 指向记录的指针，在集合（或共享该节点的任一版本）存活期间有效；未找到返回 nullptr
+     */
+    const CompactMarker* find(quint32 id) const;
+
+    /**
+     * @brief 按ID查找紧凑记录
+     * @param markerId 标记ID
+     * @return 指向记录的指针；未找到返回 nullptr
+     */
+    const CompactMarker* find(const QString& markerId) const;
+
+    /**
+     * @brief 获取标记
+     * @param markerId 标记ID
+     * @return 标记对象，未找到返回无效标记
+     */
+    Marker value(const QString& markerId) const;
+
+    /**
+     * @brief 插入或替换标记
+     * @param marker 标记数据
+     *
+     * 只复制受影响的路径，其他版本不受影响。
+     */
+    void insert(const Marker& marker);
+
+    /**
+     * @brief 插入或替换紧凑记录
+     * @param marker 紧凑记录
+     */
+    void insert(const CompactMarker& marker);
+
+    /**
+     * @brief 删除标记
+     * @param markerId 标记ID
+     * @return 标记存在并被删除返回 true
+     */
+    bool remove(const QString& markerId);
+
+    /**
+     * @brief 按ID序号删除标记
+     * @param id 标记ID的字符串序号
+     * @return 标记存在并被删除返回 true
+     */
+    bool remove(quint32 id);
+
+    /**
+     * @brief 应用一组差异
+     * @param diff 差异（删除 -> 修改 -> 新增的顺序应用）
+     */
+    void apply(const MarkerDiff& diff);
+
+    /**
+     * @brief 获取所有标记
+     * @return 标记列表（按哈希顺序，顺序稳定但不保证与插入顺序一致）
+     */
+    QList<Marker> values() const;
+
+    /**
+     * @brief 依次访问所有标记
+     * @param visitor 访问函数
+     */
+    void forEach(const std::function<void(const Marker&)>& visitor) const;
+
+    /**
+     * @brief 依次访问所有紧凑记录（不展开字符串）
+     * @param visitor 访问函数
+     */
+    void forEachCompact(const std::function<void(const CompactMarker&)>& visitor) const;
+
+    /**
+     * @brief 判断两个版本是否为同一结构（O(1)）
+     */
+    bool isSharedWith(const PersistentMarkerMap& other) const { return m_root == other.m_root; }
+
+    /**
+     * @brief 在另一版本的基础上重建当前内容
+     * @param base 基础版本
+     * @return 内容与当前集合相同、但尽可能与 base 共享节点的新集合
+     *
+     * 用于从 JSON 等外部来源加载的快照：相邻快照之间重新建立结构共享。
+     */
+    PersistentMarkerMap rebasedOn(const PersistentMarkerMap& base) const;
+
+    /**
+     * @brief 计算两个版本之间的差异
+     * @param from 变化前的版本
+     * @param to 变化后的版本
+     * @return 差异结果
+     *
+     * 共享的子树直接跳过，代价与变化量（而不是标记总数）成正比。
+     */
+    static MarkerDiff diff(const PersistentMarkerMap& from, const PersistentMarkerMap& to);
+
+    /**
+     * @brief 以紧凑记录形式计算差异（不展开字符串）
+     * @param from 变化前的版本
+     * @param to 变化后的版本
+     * @param upserts 输出：新增和修改后的记录
+     * @param removedIds 输出：被删除标记的ID序号
+     *
+     * 按 removedIds -> upserts 的顺序应用到 from 即得到 to。
+     */
+    static void diffCompact(const PersistentMarkerMap& from, const PersistentMarkerMap& to,
+                            std::vector<CompactMarker>* upserts, std::vector<quint32>* removedIds);
+
+private:
+    struct Node;
+    struct Ops;
+    using NodePtr = std::shared_ptr<const Node>;
+
+    NodePtr m_root;     ///< 根节点（空集合为 nullptr）
+    int m_size = 0;     ///< 标记数量
+};
+
+#endif // PERSISTENTMARKERMAP_H
@@ -0,0 +1,167 @@
+#include "stringpool.h"
+#include <QtAlgorithms>
+
+StringPool::StringPool() {
+    allocate(QString());
+}
+
+StringPool::~StringPool() {
+    for (QAtomicPointer<Slot>& chunk : m_chunks) {
+        delete[] chunk.loadRelaxed();
+    }
+}
+
+int StringPool::chunkOf(quint32 index, quint32* offset) {
+    // 第 c 块有 1024 << c 个槽位，起始序号为 1024 * (2^c - 1)
+    const quint32 block = (index >> kFirstChunkBits) + 1;
+    const int chunk = 31 - int(qCountLeadingZeroBits(block));
+    *offset = index - (((quint32(1) << chunk) - 1) << kFirstChunkBits);
+    return chunk;
+}
+
+StringPool::Slot& StringPool::slot(quint32 index) const {
+    quint32 offset = 0;
+    const int chunk = chunkOf(index, &offset);
+    return m_chunks[chunk].loadAcquire()[offset];
+}
+
+quint32 StringPool::intern(const QString& text) {
+    if (text.isEmpty()) {
+        return 0;
+    }
+
+    {
+        QReadLocker locker(&m_lock);
+        auto it = m_indices.constFind(text);
+        if (it != m_indices.cend()) {
+            slot(it.value()).epoch.storeRelaxed(m_epoch.loadRelaxed());
+            return it.value();
+        }
+    }
+
+    // 写锁下再检查一次，其他线程可能已经驻留了同样的字符串
+    QWriteLocker locker(&m_lock);
+    auto it = m_indices.constFind(text);
+    if (it != m_indices.cend()) {
+        slot(it.value()).epoch.storeRelaxed(m_epoch.loadRelaxed());
+        return it.value();
+    }
+
+    // 待回收的字符串足够多时先回收，再分配（优先复用空闲槽位）
+    if (m_released.loadRelaxed() >= qMax(kMinCollectThreshold, int(m_indices.size() / 2))) {
+        collectLocked();
+    }
+    return allocate(text);
+}
+
+qint64 StringPool::indexOf(const QString& text) const {
+    QReadLocker locker(&m_lock);
+    auto it = m_indices.constFind(text);
+    return it != m_indices.cend() ? static_cast<qint64>(it.value()) : -1;
+}
+
+QString StringPool::at(quint32 index) const {
+    if (index >= m_slotCount.loadAcquire()) {
+        return QString();
+    }
+    return slot(index).text;
+}
+
+void StringPool::retain(quint32 index) {
+    if (index != 0) {
+        slot(index).references.ref();
+    }
+}
+
+void StringPool::release(quint32 index) {
+    if (index == 0) {
+        return;
+    }
+    Slot& target = slot(index);
+    Q_ASSERT(target.references.loadRelaxed() > 0);
+    if (!target.references.deref()) {
+        m_released.ref();
+    }
+}
+
+int StringPool::collect() {
+    QWriteLocker locker(&m_lock);
+    return collectLocked();
+}
+
+int StringPool::collectLocked() {
+    const quint32 epoch = m_epoch.loadRelaxed();
+    const quint32 count = m_slotCount.loadRelaxed();
+    int collected = 0;
+
+    // 序号 0（空字符串）始终保留
+    for (quint32 index = 1; index < count; ++index) {
+        Slot& target = slot(index);
+        if (target.free || target.references.loadAcquire() != 0
+            || target.epoch.loadRelaxed() == epoch) {
+            continue;
+        }
+        m_indices.remove(target.text);
+        target.text = QString();
+        target.free = true;
+        m_freeSlots.append(index);
+        ++collected;
+    }
+
+    m_released.storeRelaxed(0);
+    m_epoch.storeRelaxed(epoch + 1);
+    return collected;
+}
+
+quint32 StringPool::allocate(const QString& text) {
+    quint32 index = 0;
+    if (!m_freeSlots.isEmpty()) {
+        index = m_freeSlots.takeLast();
+    } else {
+        index = m_slotCount.loadRelaxed();
+        quint32 offset = 0;
+        const int chunk = chunkOf(index, &offset);
+        if (!m_chunks[chunk].loadRelaxed()) {
+            m_chunks[chunk].storeRelease(new Slot[qsizetype(1) << (kFirstChunkBits + chunk)]);
+        }
+    }
+
+    Slot& target = slot(index);
+    target.text = text;
+    target.references.storeRelaxed(0);
+    target.epoch.storeRelaxed(m_epoch.loadRelaxed());
+    target.free = false;
+    m_indices.insert(text, index);
+
+    // 槽位内容写好后再发布新的槽位数，at() 据此判断序号是否有效
+    if (index >= m_slotCount.loadRelaxed()) {
+        m_slotCount.storeRelease(index + 1);
+    }
+    return index;
+}
+
+int StringPool::size() const {
+    QReadLocker locker(&m_lock);
+    return static_cast<int>(m_indices.size());
+}
+
+qint64 StringPool::memoryUsage() const {
+    QReadLocker locker(&m_lock);
+    const quint32 count = m_slotCount.loadRelaxed();
+    qint64 bytes = 0;
+    for (int chunk = 0; chunk < kMaxChunks && m_chunks[chunk].loadRelaxed(); ++chunk) {
+        bytes += (qint64(1) << (kFirstChunkBits + chunk)) * qint64(sizeof(Slot));
+    }
+    for (quint32 index = 0; index < count; ++index) {
+        bytes += slot(index).text.capacity() * qint64(sizeof(QChar));
+    }
+    bytes += m_freeSlots.capacity() * qint64(sizeof(quint32));
+    // 哈希表：每项一个键（与槽位共享数据）和一个值，外加桶开销
+    bytes += m_indices.size() * qint64(sizeof(QString) + sizeof(quint32) + sizeof(void*));
+    return bytes;
+}
+
+StringPool& StringPool::markerStrings() {
+    static StringPool pool;
+    return pool;
+}
@@ -0,0 +1,127 @@
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#include <QAtomicInteger>
+#include <QAtomicPointer>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QString>
+#include <QVector>
+
+/**
+ * @class StringPool
+ * @brief 字符串驻留池
+ *
+ * 为每个不同的字符串分配一个整数序号，相同内容只保存一份。
+ * 序号 0 固定表示空字符串。
+ *
+ * 字符串按引用计数回收：长期保存序号的持有者（PersistentMarkerMap 的节点、
+ * SnapshotHistory、MarkerTable）通过 retain() / release() 计数，
+ * 计数归零的字符串在之后驻留新字符串时批量回收（collect()），序号随后可被重新分配。
+ * 刚驻留（或刚被 intern() 命中）的字符串至少保留到下一次回收之后，
+ * 因此临时的紧凑记录只要在此之前交给持有者即可。
+ *
+ * 所有方法都是线程安全的。at() 不加锁：字符串存放在只追加的分块数组中，
+ * 块一旦分配就不再移动；驻留和回收在写锁下修改哈希表与空闲列表。
+ */
+class StringPool {
+public:
+    /**
+     * @brief 构造函数（预置空字符串）
+     */
+    StringPool();
+
+    /**
+     * @brief 析构函数
+     */
+    ~StringPool();
+
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+
+    /**
+     * @brief 驻留字符串
+     * @param text 字符串
+     * @return 字符串序号（已存在时返回原序号）
+     */
+    quint32 intern(const QString& text);
+
+    /**
+     * @brief 查找字符串序号（不驻留）
+     * @param text 字符串
+     * @return 字符串序号，不存在返回 -1
+     */
+    qint64 indexOf(const QString& text) const;
+
+    /**
+     * @brief 获取序号对应的字符串（不加锁）
+     * @param index 字符串序号（调用方需持有引用或刚驻留）
+     * @return 字符串（隐式共享，不复制内容）；序号无效时返回空字符串
+     */
+    QString at(quint32 index) const;
+
+    /**
+     * @brief 增加引用计数
+     * @param index 字符串序号（0 忽略）
+     */
+    void retain(quint32 index);
+
+    /**
+     * @brief 减少引用计数（归零后在下一次回收时释放）
+     * @param index 字符串序号（0 忽略）
+     */
+    void release(quint32 index);
+
+    /**
+     * @brief 回收引用计数为零、且自上一次回收以来未被驻留的字符串
+     * @return 回收的字符串数
+     */
+    int collect();
+
+    /**
+     * @brief 获取当前驻留的字符串数量（含空字符串）
+     */
+    int size() const;
+
+    /**
+     * @brief 估算池占用的内存
+     * @return 字节数
+     */
+    qint64 memoryUsage() const;
+
+    /**
+     * @brief 标记数据共用的全局字符串池
+     * @return 全局实例（ID、备注、创建者）
+     */
+    static StringPool& markerStrings();
+
+private:
+    /**
+     * @brief 一个字符串槽位
+     */
+    struct Slot {
+        QString text;                           ///< 字符串（写锁下修改）
+        QAtomicInt references;                  ///< 引用计数
+        QAtomicInteger<quint32> epoch;          ///< 最近一次驻留或命中时的回收轮次
+        bool free = false;                      ///< 是否在空闲列表中（写锁下修改）
+    };
+
+    static constexpr int kFirstChunkBits = 10;                  ///< 第一块 1024 个槽位，之后每块翻倍
+    static constexpr int kMaxChunks = 33 - kFirstChunkBits;     ///< 块数上限（覆盖全部 32 位序号）
+    static constexpr int kMinCollectThreshold = 4096;           ///< 触发回收的最少待回收数
+
+    static int chunkOf(quint32 index, quint32* offset);
+    Slot& slot(quint32 index) const;
+    quint32 allocate(const QString& text);
+    int collectLocked();
+
+    mutable QReadWriteLock m_lock;              ///< 保护哈希表、空闲列表和槽位分配
+    QHash<QString, quint32> m_indices;          ///< 字符串 -> 序号
+    QAtomicPointer<Slot> m_chunks[kMaxChunks];  ///< 分块的槽位数组（只追加）
+    QAtomicInteger<quint32> m_slotCount;        ///< 已分配的槽位数
+    QVector<quint32> m_freeSlots;               ///< 已回收、可重新分配的槽位
+    QAtomicInt m_released;                      ///< 自上一次回收以来引用计数归零的次数
+    QAtomicInteger<quint32> m_epoch;            ///< 当前回收轮次
+};
+
+#endif // STRINGPOOL_H
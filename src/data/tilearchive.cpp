@@ -0,0 +1,223 @@
+#include "tilearchive.h"
+#include <QDebug>
+#include <QtEndian>
+#include <cstring>
+
+namespace {
+
+const char kMagic[4] = {'L', 'M', 'T', 'A'};
+constexpr int kFormatLength = 8;
+
+/// 每级第一个瓦片在索引中的序号（最后一项为瓦片总数）
+QVector<qint64> levelStarts(const TileArchive::Header& header) {
+    QVector<qint64> starts;
+    starts.reserve(header.levelCount + 1);
+    qint64 total = 0;
+    for (int level = 0; level < header.levelCount; ++level) {
+        starts.append(total);
+        const QSize grid = TileArchive::gridSizeFor(header.imageSize, header.tileSize, level);
+        total += qint64(grid.width()) * grid.height();
+    }
+    starts.append(total);
+    return starts;
+}
+
+} // namespace
+
+// ========== TileArchive ==========
+
+int TileArchive::levelCountFor(const QSize& imageSize, int tileSize) {
+    const int extent = qMax(imageSize.width(), imageSize.height());
+    int levels = 1;
+    while ((qint64(tileSize) << (levels - 1)) < extent) {
+        ++levels;
+    }
+    return levels;
+}
+
+QSize TileArchive::gridSizeFor(const QSize& imageSize, int tileSize, int level) {
+    const qint64 span = qint64(tileSize) << level;
+    return QSize(int((imageSize.width() + span - 1) / span), int((imageSize.height() + span - 1) / span));
+}
+
+TileArchive::~TileArchive() {
+    close();
+}
+
+bool TileArchive::open(const QString& fileName) {
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+
+    m_size = m_file.size();
+    if (m_size < kHeaderSize) {
+        m_error = QStringLiteral("文件过短");
+        close();
+        return false;
+    }
+
+    m_data = m_file.map(0, m_size);
+    if (!m_data) {
+        m_error = QStringLiteral("无法映射文件: %1").arg(m_file.errorString());
+        close();
+        return false;
+    }
+
+    if (std::memcmp(m_data, kMagic, sizeof(kMagic)) != 0) {
+        m_error = QStringLiteral("不是瓦片归档文件");
+        close();
+        return false;
+    }
+    const quint32 version = qFromLittleEndian<quint32>(m_data + 4);
+    if (version != kVersion) {
+        m_error = QStringLiteral("不支持的归档版本: %1").arg(version);
+        close();
+        return false;
+    }
+
+    m_header.imageSize = QSize(int(qFromLittleEndian<quint32>(m_data + 8)),
+                               int(qFromLittleEndian<quint32>(m_data + 12)));
+    m_header.tileSize = int(qFromLittleEndian<quint32>(m_data + 16));
+    m_header.levelCount = int(qFromLittleEndian<quint32>(m_data + 20));
+    m_header.format = QByteArray(reinterpret_cast<const char*>(m_data + 24),
+                                 int(qstrnlen(reinterpret_cast<const char*>(m_data + 24), kFormatLength)));
+
+    if (m_header.imageSize.isEmpty() || m_header.tileSize <= 0
+        || m_header.levelCount != levelCountFor(m_header.imageSize, m_header.tileSize)) {
+        m_error = QStringLiteral("文件头无效");
+        close();
+        return false;
+    }
+
+    m_levelStart = levelStarts(m_header);
+    if (kHeaderSize + m_levelStart.last() * kIndexEntrySize > m_size) {
+        m_error = QStringLiteral("索引不完整");
+        close();
+        return false;
+    }
+
+    m_error.clear();
+    return true;
+}
+
+void TileArchive::close() {
+    if (m_data) {
+        m_file.unmap(const_cast<uchar*>(m_data));
+        m_data = nullptr;
+    }
+    m_file.close();
+    m_size = 0;
+    m_header = Header();
+    m_levelStart.clear();
+}
+
+QByteArray TileArchive::tileData(int level, int column, int row) const {
+    if (!m_data || level < 0 || level >= m_header.levelCount) {
+        return QByteArray();
+    }
+    const QSize grid = gridSizeFor(m_header.imageSize, m_header.tileSize, level);
+    if (column < 0 || row < 0 || column >= grid.width() || row >= grid.height()) {
+        return QByteArray();
+    }
+
+    const qint64 index = m_levelStart[level] + qint64(row) * grid.width() + column;
+    const uchar* entry = m_data + kHeaderSize + index * kIndexEntrySize;
+    const quint64 offset = qFromLittleEndian<quint64>(entry);
+    const quint32 length = qFromLittleEndian<quint32>(entry + 8);
+    if (length == 0) {
+        return QByteArray();
+    }
+    if (offset > quint64(m_size) || length > quint64(m_size) - offset) {
+        qWarning() << "Tile archive entry out of range:" << level << column << row;
+        return QByteArray();
+    }
+    return QByteArray::fromRawData(reinterpret_cast<const char*>(m_data + offset), int(length));
+}
+
+// ========== TileArchiveWriter ==========
+
+TileArchiveWriter::TileArchiveWriter(const QString& fileName)
+    : m_file(fileName)
+{
+}
+
+bool TileArchiveWriter::begin(const TileArchive::Header& header) {
+    if (header.imageSize.isEmpty() || header.tileSize <= 0 || header.format.size() >= kFormatLength
+        || header.levelCount != TileArchive::levelCountFor(header.imageSize, header.tileSize)) {
+        m_error = QStringLiteral("金字塔参数无效");
+        return false;
+    }
+    if (!m_file.open(QIODevice::WriteOnly)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+
+    m_header = header;
+    m_levelStart = levelStarts(header);
+    m_index = QByteArray(int(m_levelStart.last() * TileArchive::kIndexEntrySize), '\0');
+
+    uchar head[TileArchive::kHeaderSize] = {};
+    std::memcpy(head, kMagic, sizeof(kMagic));
+    qToLittleEndian<quint32>(TileArchive::kVersion, head + 4);
+    qToLittleEndian<quint32>(quint32(header.imageSize.width()), head + 8);
+    qToLittleEndian<quint32>(quint32(header.imageSize.height()), head + 12);
+    qToLittleEndian<quint32>(quint32(header.tileSize), head + 16);
+    qToLittleEndian<quint32>(quint32(header.levelCount), head + 20);
+    std::memcpy(head + 24, header.format.constData(), size_t(header.format.size()));
+
+    // 索引先写入占位，finish() 时回填
+    if (m_file.write(reinterpret_cast<const char*>(head), sizeof(head)) != qint64(sizeof(head))
+        || m_file.write(m_index) != m_index.size()) {
+        m_error = m_file.errorString();
+        m_file.cancelWriting();
+        return false;
+    }
+    return true;
+}
+
+bool TileArchiveWriter::writeTile(int level, int column, int row, const QByteArray& data) {
+    const qint64 index = indexOf(level, column, row);
+    if (index < 0) {
+        m_error = QStringLiteral("瓦片越界: %1/%2/%3").arg(level).arg(column).arg(row);
+        return false;
+    }
+
+    const qint64 offset = m_file.pos();
+    if (m_file.write(data) != data.size()) {
+        m_error = m_file.errorString();
+        return false;
+    }
+
+    uchar* entry = reinterpret_cast<uchar*>(m_index.data()) + index * TileArchive::kIndexEntrySize;
+    qToLittleEndian<quint64>(quint64(offset), entry);
+    qToLittleEndian<quint32>(quint32(data.size()), entry + 8);
+    return true;
+}
+
+bool TileArchiveWriter::finish() {
+    if (!m_file.seek(TileArchive::kHeaderSize) || m_file.write(m_index) != m_index.size()) {
+        m_error = m_file.errorString();
+        m_file.cancelWriting();
+        return false;
+    }
+    if (!m_file.commit()) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    return true;
+}
+
+qint64 TileArchiveWriter::indexOf(int level, int column, int row) const {
+    if (level < 0 || level >= m_header.levelCount) {
+        return -1;
+    }
+    const QSize grid = TileArchive::gridSizeFor(m_header.imageSize, m_header.tileSize, level);
+    if (column < 0 || row < 0 || column >= grid.width() || row >= grid.height()) {
+        return -1;
+    }
+    return m_levelStart[level] + qint64(row) * grid.width() + column;
+}
@@ -0,0 +1,150 @@
+#ifndef TILEARCHIVE_H
+#define TILEARCHIVE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QSaveFile>
+#include <QSize>
+#include <QString>
+#include <QVector>
+
+/**
+ * @class TileArchive
+ * @brief 预先切好的地图瓦片金字塔（单文件、带索引，可内存映射）
+ *
+ * 金字塔的约定与 TileSource 相同：第 0 级为原始分辨率，每升一级长宽减半，
+ * 最高一级整张图放得进一个瓦片；第 level 级的一个瓦片覆盖原图中
+ * (tileSize << level) 像素见方的区域，边缘瓦片按实际大小缩小。
+ *
+ * 文件格式（整数均为小端）：
+ * - 文件头 32 字节：魔数 "LMTA"、版本 u32、原图宽 u32、原图高 u32、
+ *   瓦片边长 u32、级数 u32、瓦片图片格式（8 字节，以 0 填充，如 "jpg"）
+ * - 索引：按级别从 0 开始、每级按行优先排列，每个瓦片 12 字节：偏移 u64、长度 u32
+ *   （长度为 0 表示瓦片缺失）
+ * - 瓦片数据：编码后的图片，顺序任意
+ *
+ * 读取时整个文件映射到内存，tileData() 不复制数据，可以在多个线程中并发调用。
+ */
+class TileArchive {
+public:
+    static constexpr quint32 kVersion = 1;          ///< 当前格式版本
+    static constexpr int kHeaderSize = 32;          ///< 文件头长度（字节）
+    static constexpr int kIndexEntrySize = 12;      ///< 每个索引项的长度（字节）
+
+    /**
+     * @brief 文件头描述的金字塔参数
+     */
+    struct Header {
+        QSize imageSize;        ///< 原图尺寸（像素）
+        int tileSize = 256;     ///< 瓦片边长（像素）
+        int levelCount = 0;     ///< 级数
+        QByteArray format;      ///< 瓦片图片格式（QImageReader 的格式名）
+    };
+
+    /**
+     * @brief 给定原图尺寸和瓦片边长时的级数
+     */
+    static int levelCountFor(const QSize& imageSize, int tileSize);
+
+    /**
+     * @brief 指定级别的列数和行数
+     */
+    static QSize gridSizeFor(const QSize& imageSize, int tileSize, int level);
+
+    TileArchive() = default;
+    ~TileArchive();
+
+    TileArchive(const TileArchive&) = delete;
+    TileArchive& operator=(const TileArchive&) = delete;
+
+    /**
+     * @brief 打开并映射归档文件
+     * @param fileName 文件路径
+     * @return 成功返回 true，失败时 errorString() 说明原因
+     */
+    bool open(const QString& fileName);
+
+    /**
+     * @brief 关闭文件（之前返回的 tileData() 随之失效）
+     */
+    void close();
+
+    bool isOpen() const { return m_data != nullptr; }
+    const Header& header() const { return m_header; }
+    QString errorString() const { return m_error; }
+
+    /**
+     * @brief 获取编码后的瓦片数据
+     * @param level 金字塔级别
+     * @param column 列号
+     * @param row 行号
+     * @return 指向映射内存的数据（不复制，归档关闭前有效），缺失或越界返回空
+     */
+    QByteArray tileData(int level, int column, int row) const;
+
+private:
+    QFile m_file;                   ///< 映射中的文件
+    const uchar* m_data = nullptr;  ///< 映射的起始地址
+    qint64 m_size = 0;              ///< 文件长度
+    Header m_header;                ///< 文件头
+    QVector<qint64> m_levelStart;   ///< 每级第一个瓦片在索引中的序号
+    QString m_error;                ///< 最近的错误
+};
+
+/**
+ * @class TileArchiveWriter
+ * @brief 写出 TileArchive 文件
+ *
+ * begin() 写入文件头并预留索引，writeTile() 追加瓦片（任意顺序），
+ * finish() 回填索引后原子地替换目标文件，未完成的归档不会被客户端读到。
+ */
+class TileArchiveWriter {
+public:
+    /**
+     * @brief 构造函数
+     * @param fileName 输出路径
+     */
+    explicit TileArchiveWriter(const QString& fileName);
+
+    /**
+     * @brief 开始写入
+     * @param header 金字塔参数（levelCount 必须与 levelCountFor() 一致）
+     * @return 成功返回 true
+     */
+    bool begin(const TileArchive::Header& header);
+
+    /**
+     * @brief 追加一个瓦片
+     * @param data 编码后的图片
+     * @return 成功返回 true
+     */
+    bool writeTile(int level, int column, int row, const QByteArray& data);
+
+    /**
+     * @brief 写入索引并提交文件
+     * @return 成功返回 true
+     */
+    bool finish();
+
+    /**
+     * @brief 已写入的总字节数
+     */
+    qint64 bytesWritten() const { return m_file.pos(); }
+
+    QString errorString() const { return m_error; }
+
+private:
+    /**
+     * @brief 瓦片在索引中的序号，越界返回 -1
+     */
+    qint64 indexOf(int level, int column, int row) const;
+
+private:
+    QSaveFile m_file;               ///< 输出文件（提交前写入临时文件）
+    TileArchive::Header m_header;   ///< 金字塔参数
+    QVector<qint64> m_levelStart;   ///< 每级第一个瓦片在索引中的序号
+    QByteArray m_index;             ///< 索引（finish() 时写回）
+    QString m_error;                ///< 最近的错误
+};
+
+#endif // TILEARCHIVE_H
@@ -3,6 +3,21 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QNetworkRequest>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+
+#include "../data/mapjsoncodec.h"
+
+namespace {
+
+/// 线程池中解码快照列表的结果
+struct SnapshotsDecodeResult {
+    bool ok = false;
+    QList<MapSnapshot> snapshots;
+    QString errorMessage;
+};
+
+} // namespace
 
 ApiClient::ApiClient(QObject* parent)
     : QObject(parent)
@@ -43,18 +58,8 @@ void ApiClient::addMarker(const Marker& marker) {
         request.setRawHeader("X-User", m_username.toUtf8());
     }
 
-    // 发送完整的标记数据（包含 id, x, y 字段，与后端 Marker::fromJson 格式匹配）
-    QJsonObject json;
-    json["id"] = marker.id();
-    json["x"] = marker.position().x();
-    json["y"] = marker.position().y();
-    json["note"] = marker.note();
-    json["color"] = marker.color().name();
-    json["createTime"] = marker.createTime().toString(Qt::ISODate);
-    json["createdBy"] = marker.createdBy();
-
-    QJsonDocument doc(json);
-    m_networkManager->post(request, doc.toJson());
+    // 发送完整的标记数据（字段由 DataSchema::Schema<Marker> 生成，与后端解码一致）
+    m_networkManager->post(request, MapJsonCodec::writeMarker(marker));
 
     qDebug() << "Adding marker:" << marker.id() << "at" << marker.position();
 }
@@ -71,22 +76,43 @@ void ApiClient::deleteMarker(const QString& markerId) {
     qDebug() << "Deleting marker:" << markerId;
 }
 
-void ApiClient::uploadSnapshots(const QList<MapSnapshot>& snapshots) {
-    QNetworkRequest request(buildUrl("/map/snapshots/batch"));
+void ApiClient::updateMarker(const MarkerPatch& patch) {
+    QString endpoint = QString("/map/markers/%1").arg(patch.markerId);
+    QNetworkRequest request(buildUrl(endpoint));
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
 
     if (!m_username.isEmpty()) {
         request.setRawHeader("X-User", m_username.toUtf8());
     }
 
-    // 构建JSON数组
-    QJsonArray snapshotArray;
-    for (const MapSnapshot& snapshot : snapshots) {
-        snapshotArray.append(snapshot.toJson());
+    // 只发送变化的字段（拖动时只有坐标）
+    m_networkManager->sendCustomRequest(request, "PATCH",
+                                        QJsonDocument(patch.toJson()).toJson(QJsonDocument::Compact));
+    qDebug() << "Updating marker:" << patch.markerId << "fields:" << int(patch.fields);
+}
+
+void ApiClient::fetchMarkerHistory(const QString& markerId) {
+    QString endpoint = QString("/map/markers/%1/history").arg(markerId);
+    QNetworkRequest request(buildUrl(endpoint));
+
+    if (!m_username.isEmpty()) {
+        request.setRawHeader("X-User", m_username.toUtf8());
+    }
+
+    m_networkManager->get(request);
+    qDebug() << "Fetching history of marker:" << markerId;
+}
+
+void ApiClient::uploadSnapshots(const QList<MapSnapshot>& snapshots) {
+    QNetworkRequest request(buildUrl("/map/snapshots/batch"));
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+
+    if (!m_username.isEmpty()) {
+        request.setRawHeader("X-User", m_username.toUtf8());
     }
 
-    QJsonDocument doc(snapshotArray);
-    m_networkManager->post(request, doc.toJson());
+    // 编码快照数组
+    m_networkManager->post(request, MapJsonCodec::writeSnapshots(snapshots));
 
     qDebug() << "Uploading" << snapshots.size() << "snapshots";
 }
@@ -103,6 +129,17 @@ void ApiClient::onNetworkReply(QNetworkReply* reply) {
 
     // 获取响应数据
     QByteArray data = reply->readAll();
+
+    // 根据请求的URL判断响应类型并处理
+    QString urlPath = reply->url().path();
+
+    // 处理获取快照列表的响应（数据量最大，使用流式解码，不构建 QJsonDocument，且不在界面线程中解码）
+    if (urlPath.contains("/map/snapshots") && reply->operation() == QNetworkAccessManager::GetOperation) {
+        decodeSnapshots(data);
+        reply->deleteLater();
+        return;
+    }
+
     QJsonDocument doc = QJsonDocument::fromJson(data);
 
     if (doc.isNull()) {
@@ -113,18 +150,16 @@ void ApiClient::onNetworkReply(QNetworkReply* reply) {
         return;
     }
 
-    // 根据请求的URL判断响应类型并处理
-    QString urlPath = reply->url().path();
-
-    // 处理获取快照列表的响应
-    if (urlPath.contains("/map/snapshots") && reply->operation() == QNetworkAccessManager::GetOperation) {
-        QJsonArray snapshotArray = doc.array();
-        QList<MapSnapshot> snapshots;
-        for (const QJsonValue& value : snapshotArray) {
-            snapshots.append(MapSnapshot::fromJson(value.toObject()));
+    // 处理获取标记历史的响应
+    if (urlPath.endsWith("/history") && reply->operation() == QNetworkAccessManager::GetOperation) {
+        QJsonObject json = doc.object();
+        QList<MarkerEvent> events;
+        for (const QJsonValue& value : json["events"].toArray()) {
+            events.append(MarkerEvent::fromJson(value.toObject()));
         }
-        qDebug() << "Fetched" << snapshots.size() << "snapshots";
-        emit snapshotsFetched(snapshots);
+        QString markerId = json["markerId"].toString();
+        qDebug() << "Fetched" << events.size() << "history events of" << markerId;
+        emit markerHistoryFetched(markerId, events);
     }
 
     // 处理添加标记的响应
@@ -135,6 +170,14 @@ void ApiClient::onNetworkReply(QNetworkReply* reply) {
         emit markerAdded(marker);
     }
 
+    // 处理修改标记的响应
+    else if (urlPath.contains("/map/markers/") && reply->operation() == QNetworkAccessManager::CustomOperation
+             && reply->request().attribute(QNetworkRequest::CustomVerbAttribute).toByteArray() == "PATCH") {
+        Marker marker = Marker::fromJson(doc.object());
+        qDebug() << "Marker updated successfully:" << marker.id();
+        emit markerUpdated(marker);
+    }
+
     // 处理删除标记的响应
     else if (urlPath.contains("/map/markers/") && reply->operation() == QNetworkAccessManager::DeleteOperation) {
         QString markerId = reply->url().fileName();  // 从URL提取markerId
@@ -148,3 +191,34 @@ void ApiClient::onNetworkReply(QNetworkReply* reply) {
 QString ApiClient::buildUrl(const QString& endpoint) const {
     return m_baseUrl + endpoint;
 }
+
+void ApiClient::decodeSnapshots(const QByteArray& data) {
+    const quint64 decodeId = ++m_snapshotsDecodeId;
+
+    auto* watcher = new QFutureWatcher<SnapshotsDecodeResult>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, decodeId]() {
+        const SnapshotsDecodeResult result = watcher->result();
+        watcher->deleteLater();
+
+        // 之后又收到了新的快照列表，丢弃过时的结果
+        if (decodeId != m_snapshotsDecodeId) {
+            return;
+        }
+
+        if (!result.ok) {
+            QString errorMsg = QString("Invalid JSON response: %1").arg(result.errorMessage);
+            qWarning() << errorMsg;
+            emit errorOccurred(errorMsg);
+            return;
+        }
+        qDebug() << "Fetched" << result.snapshots.size() << "snapshots";
+        emit snapshotsFetched(result.snapshots);
+    });
+
+    // 字符串驻留池是线程安全的，可以在线程池中解码
+    watcher->setFuture(QtConcurrent::run([data]() {
+        SnapshotsDecodeResult result;
+        result.ok = MapJsonCodec::readSnapshots(data, &result.snapshots, &result.errorMessage);
+        return result;
+    }));
+}
@@ -8,6 +8,8 @@
 
 #include "../data/marker.h"
 #include "../data/mapsnapshot.h"
+#include "../data/markerevent.h"
+#include "../data/markerpatch.h"
 
 /**
  * @class ApiClient
@@ -16,7 +18,7 @@
  * 负责与后端服务器进行HTTP通信：
  * - 同步标记数据
  * - 同步快照数据
- * - 发送添加/删除标记请求
+ * - 发送添加/删除/修改标记请求
  *
  * 设计为可扩展，后端API地址可配置。
  */
@@ -80,6 +82,22 @@ public:
      */
     void deleteMarker(const QString& markerId);
 
+    /**
+     * @brief 请求修改标记（PATCH，只发送变化的字段）
+     * @param patch 字段级修改
+     *
+     * 请求成功后触发 markerUpdated 信号。
+     */
+    void updateMarker(const MarkerPatch& patch);
+
+    /**
+     * @brief 请求获取标记的历史事件
+     * @param markerId 标记ID
+     *
+     * 请求成功后触发 markerHistoryFetched 信号。
+     */
+    void fetchMarkerHistory(const QString& markerId);
+
     /**
      * @brief 上传本地快照到服务器
      * @param snapshots 快照列表
@@ -107,6 +125,19 @@ signals:
      */
     void markerDeleted(const QString& markerId);
 
+    /**
+     * @brief 标记修改成功信号
+     * @param marker 修改后的标记
+     */
+    void markerUpdated(const Marker& marker);
+
+    /**
+     * @brief 标记历史获取成功信号
+     * @param markerId 标记ID
+     * @param events 事件列表（按时间顺序）
+     */
+    void markerHistoryFetched(const QString& markerId, const QList<MarkerEvent>& events);
+
     /**
      * @brief 网络错误信号
      * @param error 错误描述
@@ -128,10 +159,19 @@ private:
      */
     QString buildUrl(const QString& endpoint) const;
 
+    /**
+     * @brief 在线程池中解码快照列表，完成后发出 snapshotsFetched
+     * @param data 响应数据
+     *
+     * 只发布最新一次响应的结果，之前尚未完成的解码结果被丢弃。
+     */
+    void decodeSnapshots(const QByteArray& data);
+
 private:
     QNetworkAccessManager* m_networkManager;  ///< 网络管理器
     QString m_baseUrl;                        ///< 后端API基础URL
     QString m_username;                       ///< 当前用户名
+    quint64 m_snapshotsDecodeId = 0;          ///< 最近一次快照解码的序号
 };
 
 #endif // APICLIENT_H
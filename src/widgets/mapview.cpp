@@ -1,4 +1,6 @@
 #include "mapview.h"
+#include "markerlayeritem.h"
+#include "tiledmapitem.h"
 #include <QApplication>
 #include <QMenu>
 #include <QMessageBox>
@@ -9,6 +11,7 @@ MapView::MapView(QWidget* parent)
     : QGraphicsView(parent)
     , m_scene(nullptr)
     , m_mapItem(nullptr)
+    , m_markerLayer(nullptr)
     , m_isDragging(false)
     , m_lastDragPos(QPoint())
     , m_zoomLevel(1.0)
@@ -16,6 +19,7 @@ MapView::MapView(QWidget* parent)
     , m_maxZoom(10.0)
     , m_addMarkerMode(false)
     , m_mapSize(800, 600)  // 默认地图尺寸
+    , m_tileCacheLimit(TiledMapItem::kDefaultCacheLimitMB)
 {
     // 创建并设置场景
     m_scene = new QGraphicsScene(this);
@@ -48,6 +52,12 @@ MapView::MapView(QWidget* parent)
     m_mapItem = m_scene->addPixmap(placeholderPixmap);
     m_mapItem->setZValue(-1);  // 设置为最底层
     m_mapItem->setPos(0, 0);
+
+    // 所有标记由一个图层绘制
+    m_markerLayer = new MarkerLayerItem();
+    m_markerLayer->setMapSize(QSizeF(m_mapSize.x(), m_mapSize.y()));
+    m_markerLayer->setMinimumViewScale(m_minZoom);
+    m_scene->addItem(m_markerLayer);
 }
 
 void MapView::setMapPixmap(const QPixmap& pixmap) {
@@ -55,83 +65,124 @@ void MapView::setMapPixmap(const QPixmap& pixmap) {
         return;
     }
 
+    replaceMapItem(new QGraphicsPixmapItem(pixmap), QSizeF(pixmap.size()));
+}
+
+bool MapView::setMapImageFile(const QString& fileName) {
+    auto source = std::make_shared<ImageFileTileSource>(fileName);
+    if (!source->isValid()) {
+        return false;
+    }
+    setMapTileSource(std::move(source));
+    return true;
+}
+
+bool MapView::setMapTileArchive(const QString& fileName) {
+    auto source = std::make_shared<ArchiveTileSource>(fileName);
+    if (!source->isValid()) {
+        return false;
+    }
+    setMapTileSource(std::move(source));
+    return true;
+}
+
+void MapView::setMapTileSource(std::shared_ptr<const TileSource> source) {
+    if (!m_mapItem || !source) {
+        return;
+    }
+
+    const QSizeF size(source->imageSize());
+    auto* item = new TiledMapItem(std::move(source));
+    item->setCacheLimit(m_tileCacheLimit);
+    connect(item, &TiledMapItem::previewReady, this, &MapView::mapPreviewReady);
+    connect(item, &TiledMapItem::visibleTilesReady, this, &MapView::mapTilesReady);
+    replaceMapItem(item, size);
+}
+
+void MapView::setTileCacheLimit(int megabytes) {
+    m_tileCacheLimit = megabytes;
+    if (auto* tiled = dynamic_cast<TiledMapItem*>(m_mapItem)) {
+        tiled->setCacheLimit(megabytes);
+    }
+}
+
+void MapView::replaceMapItem(QGraphicsItem* item, const QSizeF& size) {
     // 移除旧地图
     m_scene->removeItem(m_mapItem);
     delete m_mapItem;
 
     // 更新地图尺寸
-    m_mapSize = QPointF(pixmap.width(), pixmap.height());
+    m_mapSize = QPointF(size.width(), size.height());
     m_scene->setSceneRect(0, 0, m_mapSize.x(), m_mapSize.y());
 
+    // 标记按归一化坐标绘制，随地图尺寸自动更新
+    m_markerLayer->setMapSize(size);
+
     // 添加新地图
-    m_mapItem = m_scene->addPixmap(pixmap);
+    m_mapItem = item;
     m_mapItem->setZValue(-1);
     m_mapItem->setPos(0, 0);
-
-    // 重新添加所有标记（因为它们可能在旧地图上）
-    // 注意：这里简化处理，实际可能需要重新计算标记位置
+    m_scene->addItem(m_mapItem);
 }
 
 void MapView::clearMarkers() {
-    // 移除所有标记图形项
-    for (QGraphicsEllipseItem* item : m_markerItems) {
-        m_scene->removeItem(item);
-        delete item;
-    }
-    m_markerItems.clear();
+    m_markerLayer->clear();
+    m_draggedMarkerId.clear();
 }
 
 void MapView::addMarker(const Marker& marker) {
-    // 将归一化坐标转换为像素坐标
-    QPointF pixelPos = normalizedToPixel(marker.position());
-
-    // 计算标记点的大小（根据缩放级别调整，保持视觉大小一致）
-    const double baseRadius = 10.0;  // 基础半径
-    double visualRadius = baseRadius / m_zoomLevel;
-
-    // 创建标记图形项（圆形）
-    QGraphicsEllipseItem* markerItem = m_scene->addEllipse(
-        pixelPos.x() - visualRadius,
-        pixelPos.y() - visualRadius,
-        visualRadius * 2,
-        visualRadius * 2,
-        QPen(Qt::black, 1 / m_zoomLevel),  // 边框
-        QBrush(marker.color())             // 填充颜色
-    );
-
-    // 存储标记ID（用于点击识别）
-    markerItem->setData(0, marker.id());  // data(0) 存储 markerId
-    markerItem->setData(1, marker.note()); // data(1) 存储备注信息
-    markerItem->setData(2, marker.createTime().toString(Qt::ISODate)); // data(2) 存储创建时间
-
-    // 设置可点击标志
-    markerItem->setFlag(QGraphicsItem::ItemIsSelectable);
-
-    // 添加到映射表
-    m_markerItems[marker.id()] = markerItem;
-
-    qDebug() << "Marker added:" << marker.id() << "at" << pixelPos;
+    m_markerLayer->insert({marker});
+    qDebug() << "Marker added:" << marker.id() << "at" << normalizedToPixel(marker.position());
 }
 
 void MapView::addMarkers(const QList<Marker>& markers) {
-    for (const Marker& marker : markers) {
-        addMarker(marker);
-    }
+    m_markerLayer->insert(markers);
 }
 
 void MapView::removeMarker(const QString& markerId) {
-    if (!m_markerItems.contains(markerId)) {
+    if (!m_markerLayer->contains(markerId)) {
         qWarning() << "Marker not found:" << markerId;
         return;
     }
 
-    QGraphicsEllipseItem* item = m_markerItems.take(markerId);
-    m_scene->removeItem(item);
-    delete item;
+    if (markerId == m_draggedMarkerId) {
+        m_markerLayer->setDragOffset(QString(), QPointF());
+        m_draggedMarkerId.clear();
+    }
+    m_markerLayer->remove({markerId});
 
     qDebug() << "Marker removed:" << markerId;
 }
 
+void MapView::removeMarkers(const QList<Marker>& markers) {
+    QStringList markerIds;
+    markerIds.reserve(markers.size());
+    for (const Marker& marker : markers) {
+        if (marker.id() == m_draggedMarkerId) {
+            m_markerLayer->setDragOffset(QString(), QPointF());
+            m_draggedMarkerId.clear();
+        }
+        markerIds.append(marker.id());
+    }
+    m_markerLayer->remove(markerIds);
+}
+
+void MapView::updateMarkers(const QList<Marker>& markers) {
+    // 位置、颜色和备注都可能变化，直接替换图层中的记录
+    m_markerLayer->insert(markers);
+}
+
+void MapView::setMarkers(const QList<Marker>& markers) {
+    const int changes = m_markerLayer->setMarkers(markers);
+
+    // 拖动中的标记已不在新集合中
+    if (!m_draggedMarkerId.isEmpty() && !m_markerLayer->contains(m_draggedMarkerId)) {
+        m_draggedMarkerId.clear();
+    }
+
+    qDebug() << "Markers set:" << markers.size() << "changed:" << changes;
+}
+
 QPointF MapView::pixelToNormalized(const QPointF& pixelPos) const {
     return QPointF(
         pixelPos.x() / m_mapSize.x(),
@@ -178,8 +229,7 @@ void MapView::wheelEvent(QWheelEvent* event) {
     scale(scaleChange, scaleChange);
     m_zoomLevel = newZoom;
 
-    // 更新标记外观
-    updateMarkerAppearance();
+    // 标记在屏幕坐标中绘制，缩放不需要逐个更新
 
     // 发射信号
     emit zoomChanged(m_zoomLevel);
@@ -194,26 +244,39 @@ void MapView::mousePressEvent(QMouseEvent* event) {
     }
 
     // 检查是否点击了标记
-    QGraphicsItem* item = scene()->itemAt(mapToScene(event->pos()), transform());
-    QGraphicsEllipseItem* markerItem = dynamic_cast<QGraphicsEllipseItem*>(item);
+    const QString markerId = m_markerLayer->markerAt(mapToScene(event->pos()), transform());
 
-    if (markerItem) {
+    if (!markerId.isEmpty()) {
         // 点击了标记，获取标记信息
-        QString markerId = markerItem->data(0).toString();
-        QString note = markerItem->data(1).toString();
+        const QString note = m_markerLayer->marker(markerId).note();
 
         qDebug() << "Marker clicked:" << markerId << "Note:" << note;
 
         if (event->button() == Qt::RightButton) {
             // 右键点击，显示上下文菜单
             showMarkerContextMenu(event->pos(), markerId, note);
-        } else {
-            // 左键点击，发射信号
-            emit markerClicked(markerId);
+        } else if (event->button() == Qt::LeftButton) {
+            // 左键按下：松开时根据移动距离判断是点击还是拖动
+            m_draggedMarkerId = markerId;
+            m_markerPressPos = event->pos();
+            m_markerPressScenePos = mapToScene(event->pos());
         }
         return;
     }
 
+    if (event->button() == Qt::LeftButton && !m_addMarkerMode) {
+        QPointF clusterCenter;
+        if (m_markerLayer->clusterAt(mapToScene(event->pos()), transform(), &clusterCenter)) {
+            // 点击聚合气泡：放大一倍并以气泡为中心
+            const double newZoom = qBound(m_minZoom, m_zoomLevel * 2.0, m_maxZoom);
+            scale(newZoom / m_zoomLevel, newZoom / m_zoomLevel);
+            m_zoomLevel = newZoom;
+            centerOn(clusterCenter);
+            emit zoomChanged(m_zoomLevel);
+            return;
+        }
+    }
+
     if (event->button() == Qt::LeftButton) {
         if (m_addMarkerMode) {
             // 添加标记模式：获取点击位置并发射信号
@@ -234,6 +297,12 @@ void MapView::mousePressEvent(QMouseEvent* event) {
 }
 
 void MapView::mouseMoveEvent(QMouseEvent* event) {
+    if (!m_draggedMarkerId.isEmpty() && (event->buttons() & Qt::LeftButton)) {
+        // 拖动标记：只移动显示位置，松开后再提交
+        m_markerLayer->setDragOffset(m_draggedMarkerId, mapToScene(event->pos()) - m_markerPressScenePos);
+        return;
+    }
+
     if (m_isDragging && (event->buttons() & Qt::LeftButton)) {
         // 计算拖拽偏移
         QPoint delta = event->pos() - m_lastDragPos;
@@ -248,6 +317,24 @@ void MapView::mouseMoveEvent(QMouseEvent* event) {
 }
 
 void MapView::mouseReleaseEvent(QMouseEvent* event) {
+    if (event->button() == Qt::LeftButton && !m_draggedMarkerId.isEmpty()) {
+        const QString markerId = m_draggedMarkerId;
+        m_draggedMarkerId.clear();
+
+        const QPointF center = normalizedToPixel(m_markerLayer->marker(markerId).position())
+                               + mapToScene(event->pos()) - m_markerPressScenePos;
+        m_markerLayer->setDragOffset(QString(), QPointF());
+
+        if ((event->pos() - m_markerPressPos).manhattanLength() < QApplication::startDragDistance()) {
+            emit markerClicked(markerId);
+        } else {
+            // 标记先回到原位，修改被接受时由 updateMarkers() 移到新位置
+            qDebug() << "Marker move requested:" << markerId << "to" << pixelToNormalized(center);
+            emit markerMoveRequested(markerId, pixelToNormalized(center));
+        }
+        return;
+    }
+
     if (event->button() == Qt::LeftButton && m_isDragging) {
         m_isDragging = false;
         setCursor(m_addMarkerMode ? Qt::CrossCursor : Qt::ArrowCursor);
@@ -263,14 +350,11 @@ void MapView::contextMenuEvent(QContextMenuEvent* event) {
     }
 
     // 检查是否右键点击了标记
-    QGraphicsItem* item = scene()->itemAt(mapToScene(event->pos()), transform());
-    QGraphicsEllipseItem* markerItem = dynamic_cast<QGraphicsEllipseItem*>(item);
+    const QString markerId = m_markerLayer->markerAt(mapToScene(event->pos()), transform());
 
-    if (markerItem) {
+    if (!markerId.isEmpty()) {
         // 右键点击了标记，显示上下文菜单
-        QString markerId = markerItem->data(0).toString();
-        QString note = markerItem->data(1).toString();
-        showMarkerContextMenu(event->pos(), markerId, note);
+        showMarkerContextMenu(event->pos(), markerId, m_markerLayer->marker(markerId).note());
     }
 
     QGraphicsView::contextMenuEvent(event);
@@ -285,6 +369,12 @@ void MapView::showMarkerContextMenu(const QPoint& pos, const QString& markerId,
         QMessageBox::information(this, "标记备注", note.isEmpty() ? "无备注" : note);
     });
 
+    // 查看历史（添加/修改/删除记录）
+    QAction* historyAction = menu.addAction("查看历史");
+    connect(historyAction, &QAction::triggered, this, [this, markerId]() {
+        emit markerHistoryRequested(markerId);
+    });
+
     menu.addSeparator();
 
     // 删除标记（管理员权限功能）
@@ -307,27 +397,3 @@ void MapView::showMarkerContextMenu(const QPoint& pos, const QString& markerId,
     // 在鼠标位置显示菜单
     menu.exec(mapToGlobal(pos));
 }
-
-void MapView::updateMarkerAppearance() {
-    // 更新所有标记的大小，使其在视觉上保持一致
-    const double baseRadius = 10.0;
-    const double basePenWidth = 1.0;
-
-    for (QGraphicsEllipseItem* item : m_markerItems) {
-        double visualRadius = baseRadius / m_zoomLevel;
-        double visualPenWidth = basePenWidth / m_zoomLevel;
-
-        // 更新椭圆大小
-        QRectF rect = item->rect();
-        QPointF center = rect.center();
-        item->setRect(
-            center.x() - visualRadius,
-            center.y() - visualRadius,
-            visualRadius * 2,
-            visualRadius * 2
-        );
-
-        // 更新边框宽度
-        item->setPen(QPen(Qt::black, visualPenWidth));
-    }
-}
@@ -4,15 +4,18 @@
 #include <QGraphicsView>
 #include <QGraphicsScene>
 #include <QGraphicsPixmapItem>
-#include <QGraphicsEllipseItem>
 #include <QWheelEvent>
 #include <QMouseEvent>
 #include <QContextMenuEvent>
 #include <QPointF>
 #include <QMenu>
+#include <memory>
 
 #include "../data/marker.h"
 
+class MarkerLayerItem;
+class TileSource;
+
 /**
  * @class MapView
  * @brief 地图显示组件
@@ -47,6 +50,34 @@ public:
      */
     void setMapPixmap(const QPixmap& pixmap);
 
+    /**
+     * @brief 从图片文件分块加载地图
+     * @param fileName 图片路径
+     * @return 文件可读返回 true，否则保留当前地图
+     *
+     * 不会把整张图解码进内存：按当前缩放只解码可见区域的瓦片（见 TiledMapItem）。
+     */
+    bool setMapImageFile(const QString& fileName);
+
+    /**
+     * @brief 从预先切好的瓦片归档加载地图
+     * @param fileName 归档路径（由 MapTileGen 生成）
+     * @return 归档可读返回 true，否则保留当前地图
+     */
+    bool setMapTileArchive(const QString& fileName);
+
+    /**
+     * @brief 使用指定的瓦片数据源显示地图
+     * @param source 瓦片数据源
+     */
+    void setMapTileSource(std::shared_ptr<const TileSource> source);
+
+    /**
+     * @brief 设置地图瓦片缓存上限（只对分块地图有效）
+     * @param megabytes 上限（MB）
+     */
+    void setTileCacheLimit(int megabytes);
+
     /**
      * @brief 清除所有标记点
      */
@@ -70,6 +101,29 @@ public:
      */
     void removeMarker(const QString& markerId);
 
+    /**
+     * @brief 批量移除标记点
+     * @param markers 要移除的标记（按ID匹配）
+     */
+    void removeMarkers(const QList<Marker>& markers);
+
+    /**
+     * @brief 更新已有标记点的位置、颜色和备注
+     * @param markers 变化后的标记
+     *
+     * 只处理变化的标记，只重绘它们所在的区域。
+     */
+    void updateMarkers(const QList<Marker>& markers);
+
+    /**
+     * @brief 显示一组完整的标记集合
+     * @param markers 新的标记集合
+     *
+     * 按ID与当前显示的标记比较，只处理新增、删除和变化的标记，
+     * 相邻快照之间切换时代价与变化的标记数成正比。
+     */
+    void setMarkers(const QList<Marker>& markers);
+
     /**
      * @brief 将像素坐标转换为归一化坐标
      * @param pixelPos 场景中的像素坐标
@@ -115,12 +169,31 @@ signals:
      */
     void markerClicked(const QString& markerId);
 
+    /**
+     * @brief 请求移动标记信号
+     * @param markerId 标记ID
+     * @param normalizedPos 新的归一化坐标
+     *
+     * 用户用左键拖动标记并松开时触发。标记在地图上的位置由之后的 updateMarkers() 更新。
+     */
+    void markerMoveRequested(const QString& markerId, const QPointF& normalizedPos);
+
     /**
      * @brief 缩放级别改变信号
      * @param zoomLevel 新的缩放因子
      */
     void zoomChanged(double zoomLevel);
 
+    /**
+     * @brief 分块地图的低分辨率预览已显示
+     */
+    void mapPreviewReady();
+
+    /**
+     * @brief 分块地图在当前视野内已以完整分辨率显示
+     */
+    void mapTilesReady();
+
     /**
      * @brief 请求删除标记信号
      * @param markerId 要删除的标记ID
@@ -129,6 +202,14 @@ signals:
      */
     void deleteMarkerRequested(const QString& markerId);
 
+    /**
+     * @brief 请求查看标记历史信号
+     * @param markerId 标记ID
+     *
+     * 用户通过右键菜单查看标记历史时触发。
+     */
+    void markerHistoryRequested(const QString& markerId);
+
 protected:
     /**
      * @brief 鼠标滚轮事件处理（实现缩放）
@@ -157,11 +238,11 @@ protected:
 
 private:
     /**
-     * @brief 更新标记显示
-     *
-     * 根据当前缩放级别调整标记点的大小。
+     * @brief 用新的图形项替换地图图层
+     * @param item 新的地图图层（由场景接管）
+     * @param size 地图尺寸（像素）
      */
-    void updateMarkerAppearance();
+    void replaceMapItem(QGraphicsItem* item, const QSizeF& size);
 
     /**
      * @brief 显示标记的右键上下文菜单
@@ -173,17 +254,21 @@ private:
 
 private:
     QGraphicsScene* m_scene;                ///< 图形场景
-    QGraphicsPixmapItem* m_mapItem;         ///< 地图图片项
-    QMap<QString, QGraphicsEllipseItem*> m_markerItems;  ///< 标记图形项映射 (ID -> Item)
+    QGraphicsItem* m_mapItem;               ///< 地图图层（图片或分块地图）
+    MarkerLayerItem* m_markerLayer;         ///< 标记图层（所有标记）
 
     // 交互状态
     bool m_isDragging;                      ///< 是否正在拖拽
     QPoint m_lastDragPos;                   ///< 上次拖拽位置
+    QString m_draggedMarkerId;              ///< 正在拖动的标记ID
+    QPoint m_markerPressPos;                ///< 按下标记时的视图坐标
+    QPointF m_markerPressScenePos;          ///< 按下标记时的场景坐标
     double m_zoomLevel;                     ///< 当前缩放级别
     double m_minZoom;                       ///< 最小缩放级别
     double m_maxZoom;                       ///< 最大缩放级别
     bool m_addMarkerMode;                   ///< 是否处于添加标记模式
     QPointF m_mapSize;                      ///< 地图尺寸（像素）
+    int m_tileCacheLimit;                   ///< 分块地图的瓦片缓存上限（MB）
 };
 
 #endif // MAPVIEW_H
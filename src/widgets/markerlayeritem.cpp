@@ -0,0 +1,498 @@
+#include "markerlayeritem.h"
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <algorithm>
+#include <cmath>
+
+#include "../data/stringpool.h"
+
+namespace {
+
+/// 一次修改超过这么多标记时整体重绘，否则只重绘各标记所在的区域
+constexpr int kPartialUpdateLimit = 64;
+
+/// 空间索引的网格边长（地图像素）：原图分辨率下一屏约 20x13 个网格
+constexpr qreal kIndexCellSize = 64.0;
+
+/// 点击检测的容差（屏幕像素）：没有点中任何标记时，取容差范围内最近的一个
+constexpr qreal kPickTolerance = 4.0;
+
+/// 聚合气泡的最大半径（屏幕像素）
+constexpr qreal kMaxBubbleRadius = 26.0;
+
+/// 聚合气泡的填充色和边框色
+const QColor kBubbleColor(52, 152, 219, 220);
+const QColor kBubbleBorderColor(255, 255, 255);
+
+} // namespace
+
+template <typename Visit>
+void MarkerLayerItem::forEachCluster(const QRectF& sceneRect, qreal scale, const Visit& visit) const {
+    if (m_mapSize.isEmpty()) {
+        return;
+    }
+
+    const int level = clusterLevel(scale);
+    const ClusterGrid& grid = clusterGrid(level);
+    const qreal size = std::ldexp(1.0, level);
+
+    // 标记中心可能在网格边缘，气泡会伸出网格：按最大气泡半径扩展
+    const qreal margin = (kMaxBubbleRadius + 1.0) / scale;
+    const QRectF area = sceneRect.normalized().adjusted(-margin, -margin, margin, margin);
+    const qint32 left = qint32(std::floor(area.left() / size));
+    const qint32 right = qint32(std::floor(area.right() / size));
+    const qint32 top = qint32(std::floor(area.top() / size));
+    const qint32 bottom = qint32(std::floor(area.bottom() / size));
+
+    // 遍历的网格数只与屏幕面积有关
+    for (qint32 row = top; row <= bottom; ++row) {
+        for (qint32 column = left; column <= right; ++column) {
+            const auto it = grid.constFind((quint64(quint32(column)) << 32) | quint32(row));
+            if (it != grid.constEnd() && !visit(it.value())) {
+                return;
+            }
+        }
+    }
+}
+
+MarkerLayerItem::MarkerLayerItem(QGraphicsItem* parent)
+    : QGraphicsItem(parent)
+    , m_sprites(kMarkerRadius)
+{
+    // 需要准确的 exposedRect，只绘制重绘区域内的标记
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+    // 点击检测由 markerAt() 完成，图层不拦截鼠标事件
+    setAcceptedMouseButtons(Qt::NoButton);
+}
+
+void MarkerLayerItem::setMapSize(const QSizeF& size) {
+    if (size == m_mapSize) {
+        return;
+    }
+    prepareGeometryChange();
+    m_mapSize = size;
+    // 网格以地图像素划分，尺寸变化后重新统计
+    m_clusterGrids.clear();
+    rebuildIndex();
+}
+
+void MarkerLayerItem::setMinimumViewScale(qreal scale) {
+    if (scale <= 0.0 || qFuzzyCompare(scale, m_minimumScale)) {
+        return;
+    }
+    prepareGeometryChange();
+    m_minimumScale = scale;
+}
+
+// ========== 标记 ==========
+
+void MarkerLayerItem::clear() {
+    m_markers.clear();
+    m_index.clear();
+    m_clusterGrids.clear();
+    m_draggedId = 0;
+    update();
+}
+
+void MarkerLayerItem::insert(const QList<Marker>& markers) {
+    const bool partial = partialUpdate(markers.size());
+
+    m_markers.reserve(m_markers.size() + markers.size());
+    bool changed = false;
+    for (const Marker& marker : markers) {
+        changed |= upsert(CompactMarker::fromMarker(marker), partial);
+    }
+
+    if (!partial && changed) {
+        update();
+    }
+}
+
+int MarkerLayerItem::remove(const QStringList& markerIds) {
+    const bool partial = partialUpdate(markerIds.size());
+
+    int removed = 0;
+    for (const QString& markerId : markerIds) {
+        const int row = m_markers.rowOf(markerId);
+        if (row >= 0) {
+            removeRow(row, partial);
+            ++removed;
+        }
+    }
+
+    if (!partial && removed > 0) {
+        update();
+    }
+    return removed;
+}
+
+int MarkerLayerItem::setMarkers(const QList<Marker>& markers) {
+    const MarkerTable target = MarkerTable::fromList(markers);
+    const MarkerTable::Diff diff = MarkerTable::diff(m_markers, target);
+    const int changes = diff.added.size() + diff.removed.size() + diff.updated.size();
+    if (changes == 0) {
+        return 0;
+    }
+    const bool partial = partialUpdate(changes);
+
+    // 删除会把末行换到被删除的位置：先取出ID，再按ID逐个删除
+    QVector<quint32> removedIds;
+    removedIds.reserve(diff.removed.size());
+    for (int row : diff.removed) {
+        removedIds.append(m_markers.idAt(row));
+    }
+    for (quint32 id : std::as_const(removedIds)) {
+        removeRow(m_markers.rowOf(id), partial);
+    }
+
+    // 变化的标记原地替换，新增的追加到末尾
+    for (int row : diff.updated) {
+        upsert(target.record(row), partial);
+    }
+    m_markers.reserve(m_markers.size() + diff.added.size());
+    for (int row : diff.added) {
+        upsert(target.record(row), partial);
+    }
+
+    if (!partial) {
+        update();
+    }
+    return changes;
+}
+
+Marker MarkerLayerItem::marker(const QString& markerId) const {
+    const int row = m_markers.rowOf(markerId);
+    return row < 0 ? Marker() : m_markers.marker(row);
+}
+
+QString MarkerLayerItem::markerAt(const QPointF& scenePos, const QTransform& viewTransform) const {
+    const qreal scale = QStyleOptionGraphicsItem::levelOfDetailFromTransform(viewTransform);
+    if (scale <= 0.0) {
+        return QString();
+    }
+    const qreal radius = kMarkerRadius / scale;
+    const qreal radiusSquared = radius * radius;
+    auto hit = [&](int row) {
+        const QPointF delta = scenePosAt(row) - scenePos;
+        return QPointF::dotProduct(delta, delta) <= radiusSquared;
+    };
+
+    // 拖动中的标记画在最上面，优先命中
+    const int draggedRow = m_draggedId ? m_markers.rowOf(m_draggedId) : -1;
+    if (draggedRow >= 0 && hit(draggedRow)) {
+        return StringPool::markerStrings().at(m_draggedId);
+    }
+
+    if (scale < kClusterMaxScale) {
+        // 聚合显示：只有单独显示的标记（网格内只有一个）可以点中
+        QString found;
+        forEachCluster(QRectF(scenePos, QSizeF()), scale, [&](const Cluster& cluster) {
+            if (cluster.count != 1 || cluster.idXor == m_draggedId) {
+                return true;
+            }
+            const int row = m_markers.rowOf(cluster.idXor);
+            if (row >= 0 && hit(row)) {
+                found = StringPool::markerStrings().at(cluster.idXor);
+                return false;
+            }
+            return true;
+        });
+        return found;
+    }
+
+    // 点中的标记取最上面（行号最大）的一个；都没点中时取容差范围内最近的一个
+    const qreal reach = (kMarkerRadius + kPickTolerance) / scale;
+    int topRow = -1;
+    int nearestRow = -1;
+    qreal nearestDistance = reach * reach;
+    for (int row : rowsNear(QRectF(scenePos, QSizeF()), reach)) {
+        const QPointF delta = scenePosAt(row) - scenePos;
+        const qreal distance = QPointF::dotProduct(delta, delta);
+        if (distance <= radiusSquared) {
+            topRow = row;
+        } else if (distance <= nearestDistance) {
+            nearestRow = row;
+            nearestDistance = distance;
+        }
+    }
+    const int row = topRow >= 0 ? topRow : nearestRow;
+    return row >= 0 ? StringPool::markerStrings().at(m_markers.idAt(row)) : QString();
+}
+
+bool MarkerLayerItem::clusterAt(const QPointF& scenePos, const QTransform& viewTransform,
+                                QPointF* center) const {
+    const qreal scale = QStyleOptionGraphicsItem::levelOfDetailFromTransform(viewTransform);
+    if (scale <= 0.0 || scale >= kClusterMaxScale) {
+        return false;
+    }
+
+    bool found = false;
+    forEachCluster(QRectF(scenePos, QSizeF()), scale, [&](const Cluster& cluster) {
+        if (cluster.count < 2) {
+            return true;
+        }
+        const QPointF bubble = clusterCenter(cluster);
+        const qreal radius = bubbleRadius(cluster.count) / scale;
+        const QPointF delta = bubble - scenePos;
+        if (QPointF::dotProduct(delta, delta) > radius * radius) {
+            return true;
+        }
+        if (center) {
+            *center = bubble;
+        }
+        found = true;
+        return false;
+    });
+    return found;
+}
+
+void MarkerLayerItem::setDragOffset(const QString& markerId, const QPointF& offset) {
+    auto refresh = [this]() {
+        const int row = m_draggedId ? m_markers.rowOf(m_draggedId) : -1;
+        if (row >= 0) {
+            update(markerArea(scenePosAt(row)));
+        }
+    };
+
+    refresh();
+    const qint64 id = markerId.isEmpty() ? 0 : StringPool::markerStrings().indexOf(markerId);
+    m_draggedId = id > 0 ? static_cast<quint32>(id) : 0;
+    m_dragOffset = m_draggedId ? offset : QPointF();
+    refresh();
+}
+
+QRectF MarkerLayerItem::boundingRect() const {
+    const qreal margin = (qMax(kMarkerRadius, kMaxBubbleRadius) + 1.0) / m_minimumScale;
+    return QRectF(QPointF(0, 0), m_mapSize).adjusted(-margin, -margin, margin, margin);
+}
+
+void MarkerLayerItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) {
+    Q_UNUSED(widget);
+
+    const QTransform transform = painter->worldTransform();
+    const qreal scale = option->levelOfDetailFromTransform(transform);
+    if (scale <= 0.0) {
+        return;
+    }
+    m_paintScale = scale;
+
+    if (scale < kClusterMaxScale) {
+        paintClusters(painter, transform, option->exposedRect, scale);
+        return;
+    }
+
+    const QVector<int> rows = rowsNear(option->exposedRect, sceneMargin(scale));
+    const int draggedRow = m_draggedId ? m_markers.rowOf(m_draggedId) : -1;
+    if (rows.isEmpty() && draggedRow < 0) {
+        return;
+    }
+
+    // 在设备坐标中绘制：半径和边框宽度固定，与缩放无关
+    painter->save();
+    painter->resetTransform();
+    drawMarkers(painter, transform, rows, draggedRow);
+    painter->restore();
+}
+
+void MarkerLayerItem::drawMarkers(QPainter* painter, const QTransform& transform,
+                                  const QVector<int>& rows, int draggedRow) {
+    m_sprites.setDevicePixelRatio(painter->device()->devicePixelRatio());
+
+    QVector<QPainter::PixmapFragment> fragments;
+    fragments.reserve(rows.size() + 1);
+    for (int row : rows) {
+        fragments.append(m_sprites.fragment(transform.map(scenePosAt(row)), m_markers.colorAt(row)));
+    }
+    // 拖动中的标记最后绘制（可能已离开原来的区域）
+    if (draggedRow >= 0) {
+        fragments.append(m_sprites.fragment(transform.map(scenePosAt(draggedRow)),
+                                            m_markers.colorAt(draggedRow)));
+    }
+
+    if (!fragments.isEmpty()) {
+        painter->drawPixmapFragments(fragments.constData(), int(fragments.size()), m_sprites.pixmap());
+    }
+}
+
+bool MarkerLayerItem::partialUpdate(int changes) const {
+    // 聚合显示时气泡的位置和大小都可能变化，整体重绘（代价只与屏幕面积有关）
+    return changes <= kPartialUpdateLimit && m_paintScale >= kClusterMaxScale;
+}
+
+bool MarkerLayerItem::upsert(const CompactMarker& record, bool partial) {
+    const int oldRow = m_markers.rowOf(record.id);
+    if (oldRow >= 0) {
+        const CompactMarker old = m_markers.record(oldRow);
+        if (old == record) {
+            return false;
+        }
+        m_index.remove(old.id, old.x, old.y);
+        updateClusters(old, -1);
+        if (partial) {
+            update(markerArea(scenePosAt(oldRow)));
+        }
+    }
+
+    const int row = m_markers.insert(record);
+    m_index.insert(record.id, record.x, record.y);
+    updateClusters(record, 1);
+    if (partial) {
+        update(markerArea(scenePosAt(row)));
+    }
+    return true;
+}
+
+void MarkerLayerItem::removeRow(int row, bool partial) {
+    if (partial) {
+        update(markerArea(scenePosAt(row)));
+    }
+    const CompactMarker record = m_markers.record(row);
+    if (record.id == m_draggedId) {
+        m_draggedId = 0;
+    }
+    m_index.remove(record.id, record.x, record.y);
+    updateClusters(record, -1);
+    m_markers.removeAt(row);
+}
+
+QRectF MarkerLayerItem::markerArea(const QPointF& center) const {
+    const qreal margin = sceneMargin(m_paintScale);
+    return QRectF(center.x() - margin, center.y() - margin, margin * 2, margin * 2);
+}
+
+QPointF MarkerLayerItem::scenePosAt(int row) const {
+    const QPointF normalized = m_markers.positionAt(row);
+    const QPointF pos(normalized.x() * m_mapSize.width(), normalized.y() * m_mapSize.height());
+    return m_markers.idAt(row) == m_draggedId ? pos + m_dragOffset : pos;
+}
+
+QVector<int> MarkerLayerItem::rowsNear(const QRectF& sceneRect, qreal margin) const {
+    if (m_mapSize.isEmpty()) {
+        return QVector<int>();
+    }
+
+    const QRectF area = sceneRect.normalized().adjusted(-margin, -margin, margin, margin);
+    const QRectF normalizedArea(area.x() / m_mapSize.width(), area.y() / m_mapSize.height(),
+                                area.width() / m_mapSize.width(), area.height() / m_mapSize.height());
+
+    // 只访问与区域相交的网格；拖动中的标记单独处理
+    QVector<int> rows;
+    m_index.forEachInRect(normalizedArea, [&](quint32 id, qint32, qint32) {
+        if (id != m_draggedId) {
+            rows.append(m_markers.rowOf(id));
+        }
+    });
+    // 按行号排序，绘制顺序与点击检测的"上下"关系保持一致
+    std::sort(rows.begin(), rows.end());
+    return rows;
+}
+
+void MarkerLayerItem::rebuildIndex() {
+    m_index.reset(int(std::ceil(m_mapSize.width() / kIndexCellSize)),
+                  int(std::ceil(m_mapSize.height() / kIndexCellSize)));
+    for (int row = 0; row < m_markers.size(); ++row) {
+        const CompactMarker record = m_markers.record(row);
+        m_index.insert(record.id, record.x, record.y);
+    }
+}
+
+// ========== 聚合 ==========
+
+int MarkerLayerItem::clusterLevel(qreal scale) {
+    // 网格在屏幕上的边长落在 [kClusterCellSize, 2 * kClusterCellSize) 之间
+    return qMax(0, int(std::ceil(std::log2(kClusterCellSize / scale))));
+}
+
+const MarkerLayerItem::ClusterGrid& MarkerLayerItem::clusterGrid(int level) const {
+    auto it = m_clusterGrids.find(level);
+    if (it != m_clusterGrids.end()) {
+        return it.value();
+    }
+
+    // 第一次用到这一级：统计一次，之后由 updateClusters() 增量维护
+    ClusterGrid grid;
+    for (int row = 0; row < m_markers.size(); ++row) {
+        const CompactMarker marker = m_markers.record(row);
+        Cluster& cluster = grid[cellKey(marker.x, marker.y, level)];
+        ++cluster.count;
+        cluster.sumX += marker.x;
+        cluster.sumY += marker.y;
+        cluster.idXor ^= marker.id;
+    }
+    return m_clusterGrids.insert(level, grid).value();
+}
+
+quint64 MarkerLayerItem::cellKey(qint32 x, qint32 y, int level) const {
+    const qreal size = std::ldexp(1.0, level);
+    const qint32 column = qint32(std::floor(CompactMarker::fromFixed(x) * m_mapSize.width() / size));
+    const qint32 row = qint32(std::floor(CompactMarker::fromFixed(y) * m_mapSize.height() / size));
+    return (quint64(quint32(column)) << 32) | quint32(row);
+}
+
+void MarkerLayerItem::updateClusters(const CompactMarker& marker, int sign) {
+    for (auto it = m_clusterGrids.begin(); it != m_clusterGrids.end(); ++it) {
+        ClusterGrid& grid = it.value();
+        const quint64 key = cellKey(marker.x, marker.y, it.key());
+        Cluster& cluster = grid[key];
+        cluster.count += sign;
+        cluster.sumX += sign * qint64(marker.x);
+        cluster.sumY += sign * qint64(marker.y);
+        cluster.idXor ^= marker.id;
+        if (cluster.count <= 0) {
+            grid.remove(key);
+        }
+    }
+}
+
+QPointF MarkerLayerItem::clusterCenter(const Cluster& cluster) const {
+    const double x = CompactMarker::fromFixed(qint32(cluster.sumX / cluster.count));
+    const double y = CompactMarker::fromFixed(qint32(cluster.sumY / cluster.count));
+    return QPointF(x * m_mapSize.width(), y * m_mapSize.height());
+}
+
+qreal MarkerLayerItem::bubbleRadius(int count) {
+    return qMin(kMaxBubbleRadius, kMarkerRadius + 4.0 + 4.0 * std::log10(qreal(count)));
+}
+
+void MarkerLayerItem::paintClusters(QPainter* painter, const QTransform& transform,
+                                    const QRectF& exposedRect, qreal scale) {
+    painter->save();
+    painter->resetTransform();
+
+    QFont font = painter->font();
+    font.setPixelSize(11);
+    font.setBold(true);
+    painter->setFont(font);
+
+    const QPen bubblePen(kBubbleBorderColor, 2.0);
+    QVector<int> singles;
+
+    forEachCluster(exposedRect, scale, [&](const Cluster& cluster) {
+        if (cluster.count == 1) {
+            // 只有一个标记：照常绘制，画在气泡之上（与点击检测的优先顺序一致）
+            const int row = m_markers.rowOf(cluster.idXor);
+            if (row >= 0 && cluster.idXor != m_draggedId) {
+                singles.append(row);
+            }
+            return true;
+        }
+
+        const QPointF center = transform.map(clusterCenter(cluster));
+        const qreal radius = bubbleRadius(cluster.count);
+        painter->setPen(bubblePen);
+        painter->setBrush(kBubbleColor);
+        painter->drawEllipse(center, radius, radius);
+
+        painter->setPen(Qt::white);
+        const QRectF textRect(center.x() - radius, center.y() - radius, radius * 2, radius * 2);
+        painter->drawText(textRect, Qt::AlignCenter,
+                          cluster.count < 1000 ? QString::number(cluster.count)
+                                               : QString::number(cluster.count / 1000) + "k");
+        return true;
+    });
+
+    const int draggedRow = m_draggedId ? m_markers.rowOf(m_draggedId) : -1;
+    drawMarkers(painter, transform, singles, draggedRow);
+
+    painter->restore();
+}
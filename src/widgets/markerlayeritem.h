@@ -0,0 +1,255 @@
+#ifndef MARKERLAYERITEM_H
+#define MARKERLAYERITEM_H
+
+#include <QGraphicsItem>
+#include <QHash>
+#include <QList>
+#include <QSizeF>
+#include <QStringList>
+
+#include "../data/markergridindex.h"
+#include "../data/markertable.h"
+#include "markerspriteatlas.h"
+
+/**
+ * @class MarkerLayerItem
+ * @brief 一次绘制全部标记的图层
+ *
+ * 代替每个标记一个 QGraphicsEllipseItem：标记保存在列式的 MarkerTable 中，
+ * 场景里只有这一个图形项，增删标记不需要更新场景的 BSP 索引。
+ * - paint() 只绘制落在重绘区域内的标记
+ * - markerAt() 自行做点击检测，图层本身不接收鼠标事件
+ * - 标记位置另有网格索引（MarkerGridIndex），重绘和点击检测只访问附近的网格
+ * - 标记在屏幕坐标中绘制，大小不随缩放变化；缩放时不需要逐个更新标记
+ * - 各颜色的标记图案预先绘制在图集中，一次重绘的全部标记一次贴出
+ * - 缩小到原图分辨率以下时按网格聚合：每个网格画一个带数量的气泡，
+ *   只有一个标记的网格照常画标记。网格在屏幕上的大小固定，
+ *   绘制代价只与屏幕面积有关，与标记数量无关
+ *
+ * 聚合网格按缩放分级（每级边长翻倍），某一级第一次用到时统计一次，
+ * 之后随标记的增删改增量更新。
+ *
+ * 图层的坐标即地图像素坐标，标记位置为归一化坐标乘以地图尺寸。
+ */
+class MarkerLayerItem : public QGraphicsItem {
+public:
+    static constexpr qreal kMarkerRadius = 10.0;    ///< 标记半径（屏幕像素）
+    static constexpr qreal kClusterCellSize = 48.0; ///< 聚合网格的最小边长（屏幕像素）
+    static constexpr qreal kClusterMaxScale = 1.0;  ///< 缩放不小于此值时不聚合
+
+    /**
+     * @brief 构造函数
+     * @param parent 父图形项
+     */
+    explicit MarkerLayerItem(QGraphicsItem* parent = nullptr);
+
+    /**
+     * @brief 设置地图尺寸（像素）
+     */
+    void setMapSize(const QSizeF& size);
+
+    /**
+     * @brief 设置视图可能的最小缩放比例
+     *
+     * 标记在屏幕上大小固定，缩得越小在场景中占的范围越大，
+     * 图层的边界按最小缩放留出余量，缩放时不需要重新计算。
+     */
+    void setMinimumViewScale(qreal scale);
+
+    // ========== 标记 ==========
+
+    /**
+     * @brief 清除所有标记
+     */
+    void clear();
+
+    /**
+     * @brief 添加或替换标记（ID 已存在时替换，内容相同的跳过）
+     * @param markers 标记列表
+     */
+    void insert(const QList<Marker>& markers);
+
+    /**
+     * @brief 移除标记
+     * @param markerIds 标记ID列表（不存在的ID被忽略）
+     * @return 实际移除的个数
+     */
+    int remove(const QStringList& markerIds);
+
+    /**
+     * @brief 显示一组完整的标记集合
+     *
+     * 按ID与当前显示的标记比较：只删除消失的、替换变化的、追加新增的，
+     * 未变化的标记不重绘；变化的行原地复用，不重建整张表。
+     * @param markers 新的标记集合
+     * @return 变化的标记数
+     */
+    int setMarkers(const QList<Marker>& markers);
+
+    /**
+     * @brief 是否包含指定标记
+     */
+    bool contains(const QString& markerId) const { return m_markers.rowOf(markerId) >= 0; }
+
+    /**
+     * @brief 获取指定标记
+     * @return 标记，不存在时返回无效标记
+     */
+    Marker marker(const QString& markerId) const;
+
+    /**
+     * @brief 标记数量
+     */
+    int count() const { return m_markers.size(); }
+
+    /**
+     * @brief 查找场景坐标处的标记
+     *
+     * 重叠时取最上面的一个；没有点中任何标记时，取几个像素容差内最近的一个。
+     * @param scenePos 场景坐标
+     * @param viewTransform 视图的变换（决定标记在场景中的大小）
+     * @return 标记ID，没有标记时返回空字符串
+     */
+    QString markerAt(const QPointF& scenePos, const QTransform& viewTransform) const;
+
+    /**
+     * @brief 查找场景坐标处的聚合气泡（只在聚合显示时有效）
+     * @param scenePos 场景坐标
+     * @param viewTransform 视图的变换
+     * @param center 输出气泡中心（场景坐标）
+     * @return 命中多个标记的气泡返回 true
+     */
+    bool clusterAt(const QPointF& scenePos, const QTransform& viewTransform, QPointF* center) const;
+
+    /**
+     * @brief 临时偏移一个标记的显示位置（拖动中）
+     * @param markerId 标记ID，为空时取消偏移
+     * @param offset 偏移（场景坐标）
+     */
+    void setDragOffset(const QString& markerId, const QPointF& offset);
+
+    QRectF boundingRect() const override;
+    void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) override;
+
+private:
+    /**
+     * @brief 一个网格内标记的汇总
+     */
+    struct Cluster {
+        int count = 0;          ///< 标记数
+        qint64 sumX = 0;        ///< x 坐标之和（定点数）
+        qint64 sumY = 0;        ///< y 坐标之和（定点数）
+        quint32 idXor = 0;      ///< 所有 ID 序号的异或（只有一个标记时即为其 ID）
+    };
+    using ClusterGrid = QHash<quint64, Cluster>;
+
+    /**
+     * @brief 缩放对应的网格级别（网格边长为 2^level 地图像素）
+     */
+    static int clusterLevel(qreal scale);
+
+    /**
+     * @brief 获取指定级别的网格（第一次使用时统计）
+     */
+    const ClusterGrid& clusterGrid(int level) const;
+
+    /**
+     * @brief 坐标所在网格的键
+     */
+    quint64 cellKey(qint32 x, qint32 y, int level) const;
+
+    /**
+     * @brief 在所有已统计的网格中加入（sign = 1）或去掉（sign = -1）一个标记
+     */
+    void updateClusters(const CompactMarker& marker, int sign);
+
+    /**
+     * @brief 网格中标记的中心（场景坐标）
+     */
+    QPointF clusterCenter(const Cluster& cluster) const;
+
+    /**
+     * @brief 气泡半径（屏幕像素）
+     */
+    static qreal bubbleRadius(int count);
+
+    /**
+     * @brief 遍历场景矩形附近的网格
+     * @param visit 参数为网格汇总，返回 false 时停止
+     */
+    template <typename Visit>
+    void forEachCluster(const QRectF& sceneRect, qreal scale, const Visit& visit) const;
+
+    /**
+     * @brief 从图集贴出一组标记（画笔已重置为设备坐标）
+     * @param transform 场景到设备的变换
+     * @param rows 行号（按绘制顺序）
+     * @param draggedRow 拖动中的标记（最后绘制），没有时为 -1
+     */
+    void drawMarkers(QPainter* painter, const QTransform& transform, const QVector<int>& rows, int draggedRow);
+
+    /**
+     * @brief 按网格聚合绘制
+     */
+    void paintClusters(QPainter* painter, const QTransform& transform, const QRectF& exposedRect, qreal scale);
+
+    /**
+     * @brief 指定缩放下标记连同边框超出中心的距离（场景坐标）
+     */
+    static qreal sceneMargin(qreal scale) { return (kMarkerRadius + 1.0) / scale; }
+
+    /**
+     * @brief 一次修改这么多标记时是否只重绘各标记所在的区域
+     */
+    bool partialUpdate(int changes) const;
+
+    /**
+     * @brief 添加或替换一个标记，同时维护网格索引和聚合网格
+     * @param record 紧凑记录
+     * @param partial 是否只重绘标记所在的区域
+     * @return 内容有变化返回 true
+     */
+    bool upsert(const CompactMarker& record, bool partial);
+
+    /**
+     * @brief 删除一行，同时维护网格索引和聚合网格
+     * @param row 行号
+     * @param partial 是否只重绘标记所在的区域
+     */
+    void removeRow(int row, bool partial);
+
+    /**
+     * @brief 一个标记在最近一次绘制的缩放下占据的场景区域（用于局部重绘）
+     */
+    QRectF markerArea(const QPointF& center) const;
+
+    /**
+     * @brief 一行标记的场景坐标（含拖动偏移）
+     */
+    QPointF scenePosAt(int row) const;
+
+    /**
+     * @brief 场景矩形附近的行（按行号升序，不含拖动中的标记）
+     * @param sceneRect 场景矩形
+     * @param margin 向外扩展的距离（场景坐标）
+     */
+    QVector<int> rowsNear(const QRectF& sceneRect, qreal margin) const;
+
+    /**
+     * @brief 按地图尺寸重新划分网格索引并加入所有标记
+     */
+    void rebuildIndex();
+
+private:
+    MarkerTable m_markers;          ///< 标记（列式存储）
+    MarkerGridIndex m_index;        ///< 标记位置的网格索引
+    QSizeF m_mapSize;               ///< 地图尺寸（像素）
+    qreal m_minimumScale = 0.1;     ///< 视图可能的最小缩放比例（决定边界余量）
+    qreal m_paintScale = 1.0;       ///< 最近一次绘制时的缩放比例
+    quint32 m_draggedId = 0;        ///< 正在拖动的标记（ID 序号，0 表示无）
+    QPointF m_dragOffset;           ///< 拖动偏移（场景坐标）
+    mutable QHash<int, ClusterGrid> m_clusterGrids;  ///< 已统计的聚合网格（级别 -> 网格）
+    MarkerSpriteAtlas m_sprites;    ///< 标记图案图集
+};
+
+#endif // MARKERLAYERITEM_H
@@ -0,0 +1,84 @@
+#include "markerspriteatlas.h"
+#include <cmath>
+
+namespace {
+
+/// 图集每行的图案数
+constexpr int kAtlasColumns = 16;
+
+} // namespace
+
+MarkerSpriteAtlas::MarkerSpriteAtlas(qreal radius, qreal penWidth)
+    : m_radius(radius)
+    , m_penWidth(penWidth)
+{
+    setDevicePixelRatio(1.0);
+}
+
+void MarkerSpriteAtlas::setDevicePixelRatio(qreal ratio) {
+    if (ratio <= 0.0) {
+        ratio = 1.0;
+    }
+    if (m_spriteSize > 0 && qFuzzyCompare(ratio, m_devicePixelRatio)) {
+        return;
+    }
+
+    m_devicePixelRatio = ratio;
+    // 留出边框和抗锯齿的余量；边长取偶数，图案中心落在像素边界上
+    const int half = int(std::ceil((m_radius + m_penWidth) * ratio)) + 1;
+    m_spriteSize = half * 2;
+
+    m_image = QImage();
+    m_pixmap = QPixmap();
+    m_slots.clear();
+    m_dirty = false;
+}
+
+QPainter::PixmapFragment MarkerSpriteAtlas::fragment(const QPointF& center, QRgb color) {
+    const QRectF source = spriteRect(color);
+
+    // 中心对齐到物理像素，图案的像素与屏幕像素一一对应
+    const qreal ratio = m_devicePixelRatio;
+    const QPointF aligned(std::round(center.x() * ratio) / ratio, std::round(center.y() * ratio) / ratio);
+    return QPainter::PixmapFragment::create(aligned, source, 1.0 / ratio, 1.0 / ratio);
+}
+
+const QPixmap& MarkerSpriteAtlas::pixmap() {
+    if (m_dirty) {
+        m_pixmap = QPixmap::fromImage(m_image);
+        m_dirty = false;
+    }
+    return m_pixmap;
+}
+
+QRectF MarkerSpriteAtlas::spriteRect(QRgb color) {
+    const auto it = m_slots.constFind(color);
+    const int slot = it != m_slots.constEnd() ? it.value() : m_slots.size();
+    const QPoint topLeft((slot % kAtlasColumns) * m_spriteSize, (slot / kAtlasColumns) * m_spriteSize);
+    const QRectF rect(topLeft, QSizeF(m_spriteSize, m_spriteSize));
+    if (it != m_slots.constEnd()) {
+        return rect;
+    }
+
+    // 新颜色：图集放不下时行数翻倍（copy() 超出原图的部分为透明）
+    if (m_image.isNull()) {
+        m_image = QImage(kAtlasColumns * m_spriteSize, m_spriteSize, QImage::Format_ARGB32_Premultiplied);
+        m_image.fill(Qt::transparent);
+    } else if (topLeft.y() + m_spriteSize > m_image.height()) {
+        m_image = m_image.copy(0, 0, m_image.width(), m_image.height() * 2);
+    }
+
+    // 与直接绘制时相同：逻辑像素的半径和边框，按设备像素比例放大
+    QPainter painter(&m_image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.translate(rect.center());
+    painter.scale(m_devicePixelRatio, m_devicePixelRatio);
+    painter.setPen(QPen(Qt::black, m_penWidth));
+    painter.setBrush(QColor::fromRgba(color));
+    painter.drawEllipse(QPointF(0, 0), m_radius, m_radius);
+    painter.end();
+
+    m_slots.insert(color, slot);
+    m_dirty = true;
+    return rect;
+}
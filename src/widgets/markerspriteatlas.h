@@ -0,0 +1,70 @@
+#ifndef MARKERSPRITEATLAS_H
+#define MARKERSPRITEATLAS_H
+
+#include <QColor>
+#include <QHash>
+#include <QImage>
+#include <QPainter>
+#include <QPixmap>
+
+/**
+ * @class MarkerSpriteAtlas
+ * @brief 预先绘制好的标记图案（按颜色）拼成的图集
+ *
+ * 每种颜色的标记（带边框的抗锯齿圆）只绘制一次，按设备像素比例
+ * 以物理像素保存在同一张图集中。绘制时每个标记只是一个图集片段，
+ * 全部标记可以用一次 QPainter::drawPixmapFragments() 贴出。
+ *
+ * 片段中心对齐到物理像素，贴图时不需要插值，与直接绘制的圆看起来相同。
+ * 设备像素比例变化（窗口移到另一块屏幕）时图集整体重建。
+ */
+class MarkerSpriteAtlas {
+public:
+    /**
+     * @brief 构造函数
+     * @param radius 标记半径（逻辑像素）
+     * @param penWidth 边框宽度（逻辑像素）
+     */
+    explicit MarkerSpriteAtlas(qreal radius, qreal penWidth = 1.0);
+
+    /**
+     * @brief 设置设备像素比例（变化时清空图集）
+     */
+    void setDevicePixelRatio(qreal ratio);
+
+    /**
+     * @brief 生成一个标记的图集片段（需要时先绘制该颜色的图案）
+     * @param center 标记中心（设备坐标，逻辑像素）
+     * @param color 标记颜色
+     * @return 片段，用 pixmap() 绘制
+     */
+    QPainter::PixmapFragment fragment(const QPointF& center, QRgb color);
+
+    /**
+     * @brief 图集（有新图案时重新上传）
+     */
+    const QPixmap& pixmap();
+
+    /**
+     * @brief 已绘制的图案数
+     */
+    int spriteCount() const { return m_slots.size(); }
+
+private:
+    /**
+     * @brief 颜色对应的图案在图集中的区域（物理像素）
+     */
+    QRectF spriteRect(QRgb color);
+
+private:
+    qreal m_radius;                 ///< 标记半径（逻辑像素）
+    qreal m_penWidth;               ///< 边框宽度（逻辑像素）
+    qreal m_devicePixelRatio = 1.0; ///< 当前设备像素比例
+    int m_spriteSize = 0;           ///< 图案边长（物理像素，偶数）
+    QImage m_image;                 ///< 图集（绘制用）
+    QPixmap m_pixmap;               ///< 图集（贴图用）
+    bool m_dirty = false;           ///< m_image 有未上传的图案
+    QHash<QRgb, int> m_slots;       ///< 颜色 -> 图集中的序号
+};
+
+#endif // MARKERSPRITEATLAS_H
@@ -0,0 +1,206 @@
+#include "tiledmapitem.h"
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <QThread>
+#include <QWidget>
+#include <cmath>
+
+namespace {
+
+/// 没有任何可用瓦片时的底色（与地图占位符一致）
+const QColor kBackgroundColor(220, 220, 220);
+
+} // namespace
+
+TiledMapItem::TiledMapItem(std::shared_ptr<const TileSource> source, QGraphicsItem* parent)
+    : QGraphicsObject(parent)
+    , m_source(std::move(source))
+    , m_levelCount(m_source->levelCount())
+{
+    // 需要准确的 exposedRect，只绘制需要重绘的瓦片
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+
+    m_cache.setMaxCost(kDefaultCacheLimitMB * 1024);
+
+    // 解码只占用一半的核，避免与界面线程争抢
+    m_loader.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+
+    // 先解码整图预览：只有一个瓦片，缩放解码很快，之后作为所有区域的兜底
+    requestTile(m_levelCount - 1, 0, 0, true);
+}
+
+TiledMapItem::~TiledMapItem() {
+    m_loader.clear();
+    m_loader.waitForDone();
+}
+
+void TiledMapItem::setCacheLimit(int megabytes) {
+    m_cache.setMaxCost(qMax(1, megabytes) * 1024);
+}
+
+QRectF TiledMapItem::boundingRect() const {
+    return QRectF(QPointF(0, 0), QSizeF(m_source->imageSize()));
+}
+
+void TiledMapItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) {
+    const QRectF bounds = boundingRect();
+    const qreal scale = option->levelOfDetailFromTransform(painter->worldTransform());
+    const int level = levelForScale(scale);
+    const int span = m_source->tileSize() << level;
+    const QSize grid = m_source->gridSize(level);
+
+    // 区域覆盖的瓦片范围（列、行）
+    auto tileRange = [&](const QRectF& area) {
+        const QRectF clipped = area.intersected(bounds);
+        if (clipped.isEmpty()) {
+            return QRect();
+        }
+        const int left = int(clipped.left()) / span;
+        const int top = int(clipped.top()) / span;
+        const int right = qMin(grid.width() - 1, (int(std::ceil(clipped.right())) - 1) / span);
+        const int bottom = qMin(grid.height() - 1, (int(std::ceil(clipped.bottom())) - 1) / span);
+        return QRect(QPoint(left, top), QPoint(right, bottom));
+    };
+
+    // 记录整个视口需要的瓦片（只重绘一个瓦片时也不会丢掉其他仍可见的请求）
+    const QRectF viewport = widget
+        ? painter->worldTransform().inverted().mapRect(QRectF(widget->rect()))
+        : option->exposedRect;
+    const QRect visibleTiles = tileRange(viewport);
+    QSet<quint64> visible;
+    visible.reserve(int(visibleTiles.width()) * visibleTiles.height());
+    for (int row = visibleTiles.top(); row <= visibleTiles.bottom(); ++row) {
+        for (int column = visibleTiles.left(); column <= visibleTiles.right(); ++column) {
+            visible.insert(tileKey(level, column, row));
+        }
+    }
+    {
+        QMutexLocker lock(&m_visibleMutex);
+        m_visible = visible;
+    }
+
+    const QRect exposedTiles = tileRange(option->exposedRect);
+    for (int row = exposedTiles.top(); row <= exposedTiles.bottom(); ++row) {
+        for (int column = exposedTiles.left(); column <= exposedTiles.right(); ++column) {
+            const QRect target = m_source->tileRect(level, column, row);
+            if (const QPixmap* tile = m_cache.object(tileKey(level, column, row))) {
+                painter->drawPixmap(QRectF(target), *tile, QRectF(tile->rect()));
+                continue;
+            }
+
+            requestTile(level, column, row);
+            if (!drawFallback(painter, level, target)) {
+                painter->fillRect(target, kBackgroundColor);
+            }
+        }
+    }
+}
+
+int TiledMapItem::levelForScale(qreal scale) const {
+    if (scale >= 1.0 || scale <= 0.0) {
+        return 0;
+    }
+    // 选择分辨率不低于屏幕的最粗一级
+    const int level = int(std::floor(std::log2(1.0 / scale)));
+    return qBound(0, level, m_levelCount - 1);
+}
+
+bool TiledMapItem::drawFallback(QPainter* painter, int level, const QRect& target) {
+    for (int coarser = level + 1; coarser < m_levelCount; ++coarser) {
+        const int span = m_source->tileSize() << coarser;
+        const int column = target.x() / span;
+        const int row = target.y() / span;
+        const QPixmap* tile = m_cache.object(tileKey(coarser, column, row));
+        if (!tile) {
+            continue;
+        }
+
+        // 目标区域在粗瓦片中的位置
+        const QRect area = m_source->tileRect(coarser, column, row);
+        const qreal factor = qreal(1 << coarser);
+        const QRectF source((target.x() - area.x()) / factor, (target.y() - area.y()) / factor,
+                            target.width() / factor, target.height() / factor);
+        painter->drawPixmap(QRectF(target), *tile, source);
+        return true;
+    }
+
+    // 缓存中的粗瓦片都已被淘汰：使用常驻的预览
+    if (!m_preview.isNull()) {
+        const qreal factor = qreal(1 << (m_levelCount - 1));
+        const QRectF source(target.x() / factor, target.y() / factor,
+                            target.width() / factor, target.height() / factor);
+        painter->drawPixmap(QRectF(target), m_preview, source);
+        return true;
+    }
+    return false;
+}
+
+void TiledMapItem::requestTile(int level, int column, int row, bool force) {
+    const quint64 key = tileKey(level, column, row);
+    if (m_pending.contains(key) || m_failed.contains(key)) {
+        return;
+    }
+    m_pending.insert(key);
+
+    const std::shared_ptr<const TileSource> source = m_source;
+    m_loader.start([this, source, key, level, column, row, force]() {
+        // 开始解码前视野已经移走：跳过，之后再次可见时重新请求
+        bool wanted = force;
+        if (!wanted) {
+            QMutexLocker lock(&m_visibleMutex);
+            wanted = m_visible.contains(key);
+        }
+
+        const QImage image = wanted ? source->loadTile(level, column, row) : QImage();
+        QMetaObject::invokeMethod(this, [this, key, level, column, row, wanted, image]() {
+            onTileLoaded(key, level, column, row, wanted ? image : QImage(), !wanted);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void TiledMapItem::onTileLoaded(quint64 key, int level, int column, int row,
+                                const QImage& image, bool skipped) {
+    m_pending.remove(key);
+    if (skipped) {
+        return;
+    }
+    if (image.isNull()) {
+        // 解码失败的瓦片不再重试，用更粗的级别代替
+        m_failed.insert(key);
+        return;
+    }
+
+    QPixmap* pixmap = new QPixmap(QPixmap::fromImage(image));
+    const qint64 bytes = qint64(pixmap->width()) * pixmap->height() * pixmap->depth() / 8;
+    const bool isPreview = level == m_levelCount - 1 && m_preview.isNull();
+    if (isPreview) {
+        m_preview = *pixmap;
+    }
+    m_cache.insert(key, pixmap, qMax<qint64>(1, bytes / 1024));
+
+    update(QRectF(m_source->tileRect(level, column, row)));
+
+    if (isPreview) {
+        emit previewReady();
+    }
+
+    // 视野内的瓦片都已就绪
+    bool complete = false;
+    {
+        QMutexLocker lock(&m_visibleMutex);
+        complete = !m_visible.isEmpty();
+        for (quint64 visibleKey : std::as_const(m_visible)) {
+            if (!m_cache.contains(visibleKey)) {
+                complete = false;
+                break;
+            }
+        }
+    }
+    if (complete) {
+        emit visibleTilesReady();
+    }
+}
+
+quint64 TiledMapItem::tileKey(int level, int column, int row) {
+    return (quint64(level) << 56) | (quint64(quint32(column)) << 28) | quint64(quint32(row));
+}
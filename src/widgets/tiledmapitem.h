@@ -0,0 +1,122 @@
+#ifndef TILEDMAPITEM_H
+#define TILEDMAPITEM_H
+
+#include <QCache>
+#include <QGraphicsObject>
+#include <QMutex>
+#include <QPixmap>
+#include <QSet>
+#include <QThreadPool>
+#include <memory>
+
+#include "tilesource.h"
+
+/**
+ * @class TiledMapItem
+ * @brief 分块、多分辨率的地图图层
+ *
+ * 代替把整张地图放进一个 QGraphicsPixmapItem：
+ * - 绘制时按当前缩放选择金字塔级别，只请求可见区域的瓦片
+ * - 瓦片在后台线程中解码，完成后只重绘对应区域
+ * - 解码好的瓦片放在按 MB 限制的 LRU 缓存中，内存占用与地图大小无关
+ * - 瓦片尚未就绪时用缓存中更粗一级的瓦片放大代替，缩放时不会出现空白
+ * - 视野移走后尚未开始解码的瓦片会被跳过
+ * - 构造后立即在后台解码最粗一级作为预览，常驻内存，高分辨率瓦片就绪前先显示预览
+ *
+ * 图层在场景中的坐标即原图像素坐标（0, 0 到 imageSize()）。
+ */
+class TiledMapItem : public QGraphicsObject {
+    Q_OBJECT
+
+public:
+    static constexpr int kDefaultCacheLimitMB = 64;     ///< 默认瓦片缓存上限（MB）
+
+    /**
+     * @brief 构造函数
+     * @param source 瓦片数据源（在后台线程中使用）
+     * @param parent 父图形项
+     */
+    explicit TiledMapItem(std::shared_ptr<const TileSource> source, QGraphicsItem* parent = nullptr);
+
+    /**
+     * @brief 析构函数（丢弃未开始的解码，等待正在进行的解码结束）
+     */
+    ~TiledMapItem() override;
+
+    /**
+     * @brief 设置瓦片缓存上限
+     * @param megabytes 上限（MB）
+     */
+    void setCacheLimit(int megabytes);
+
+    /**
+     * @brief 获取瓦片缓存上限（MB）
+     */
+    int cacheLimit() const { return m_cache.maxCost() / 1024; }
+
+    /**
+     * @brief 原图尺寸（像素）
+     */
+    QSize imageSize() const { return m_source->imageSize(); }
+
+    /**
+     * @brief 预览（最粗一级）是否已经就绪
+     */
+    bool hasPreview() const { return !m_preview.isNull(); }
+
+    QRectF boundingRect() const override;
+    void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) override;
+
+signals:
+    /**
+     * @brief 预览已解码并显示
+     */
+    void previewReady();
+
+    /**
+     * @brief 当前视野需要的瓦片已全部就绪（以当前分辨率显示）
+     */
+    void visibleTilesReady();
+
+private:
+    /**
+     * @brief 根据缩放比例选择金字塔级别
+     * @param scale 场景到设备的缩放（1 为原始分辨率）
+     */
+    int levelForScale(qreal scale) const;
+
+    /**
+     * @brief 用缓存中更粗级别的瓦片绘制指定区域
+     * @return 找到可用的瓦片返回 true
+     */
+    bool drawFallback(QPainter* painter, int level, const QRect& target);
+
+    /**
+     * @brief 请求在后台解码瓦片（已在解码中则忽略）
+     * @param force 为 true 时不检查瓦片是否仍然可见（用于预览）
+     */
+    void requestTile(int level, int column, int row, bool force = false);
+
+    /**
+     * @brief 瓦片解码完成（界面线程）
+     * @param image 解码结果（失败为空图像）
+     * @param skipped 是否因已不可见而跳过解码
+     */
+    void onTileLoaded(quint64 key, int level, int column, int row, const QImage& image, bool skipped);
+
+    static quint64 tileKey(int level, int column, int row);
+
+private:
+    std::shared_ptr<const TileSource> m_source;  ///< 瓦片数据源
+    int m_levelCount;                       ///< 金字塔级数
+    QCache<quint64, QPixmap> m_cache;       ///< 已解码的瓦片（代价为 KB）
+    QSet<quint64> m_pending;                ///< 已请求、尚未完成的瓦片
+    QSet<quint64> m_failed;                 ///< 解码失败的瓦片（不再重试）
+    QPixmap m_preview;                      ///< 最粗一级的整图预览（不参与缓存淘汰）
+    QThreadPool m_loader;                   ///< 瓦片解码线程
+
+    mutable QMutex m_visibleMutex;          ///< 保护 m_visible（解码线程读取）
+    QSet<quint64> m_visible;                ///< 最近一次绘制需要的瓦片
+};
+
+#endif // TILEDMAPITEM_H
@@ -0,0 +1,71 @@
+#include "tilesource.h"
+#include <QDebug>
+#include <QImageReader>
+
+int TileSource::levelCount() const {
+    return TileArchive::levelCountFor(imageSize(), tileSize());
+}
+
+QRect TileSource::tileRect(int level, int column, int row) const {
+    const int span = tileSize() << level;
+    return QRect(column * span, row * span, span, span).intersected(QRect(QPoint(0, 0), imageSize()));
+}
+
+QSize TileSource::gridSize(int level) const {
+    return TileArchive::gridSizeFor(imageSize(), tileSize(), level);
+}
+
+ImageFileTileSource::ImageFileTileSource(const QString& fileName)
+    : m_fileName(fileName)
+{
+    // 只读取文件头中的尺寸，不解码像素
+    QImageReader reader(fileName);
+    m_size = reader.size();
+    if (m_size.isEmpty()) {
+        qWarning() << "Failed to read map image:" << fileName << reader.errorString();
+    } else if (!reader.supportsOption(QImageIOHandler::ClipRect)) {
+        qWarning() << "Image format does not support region decoding, tiles decode the whole image:"
+                   << fileName;
+    }
+}
+
+QImage ImageFileTileSource::loadTile(int level, int column, int row) const {
+    const QRect source = tileRect(level, column, row);
+    if (source.isEmpty()) {
+        return QImage();
+    }
+
+    // 每次使用独立的读取器，可以在多个线程中并发解码
+    QImageReader reader(m_fileName);
+    reader.setClipRect(source);
+    if (level > 0) {
+        const int scale = 1 << level;
+        reader.setScaledSize(QSize((source.width() + scale - 1) / scale,
+                                   (source.height() + scale - 1) / scale));
+    }
+
+    QImage tile = reader.read();
+    if (tile.isNull()) {
+        qWarning() << "Failed to decode map tile" << level << column << row << reader.errorString();
+    }
+    return tile;
+}
+
+ArchiveTileSource::ArchiveTileSource(const QString& fileName) {
+    if (!m_archive.open(fileName)) {
+        qWarning() << "Failed to open tile archive:" << fileName << m_archive.errorString();
+    }
+}
+
+QImage ArchiveTileSource::loadTile(int level, int column, int row) const {
+    const QByteArray data = m_archive.tileData(level, column, row);
+    if (data.isEmpty()) {
+        return QImage();
+    }
+
+    QImage tile = QImage::fromData(data, m_archive.header().format.constData());
+    if (tile.isNull()) {
+        qWarning() << "Failed to decode archived map tile" << level << column << row;
+    }
+    return tile;
+}
@@ -0,0 +1,123 @@
+#ifndef TILESOURCE_H
+#define TILESOURCE_H
+
+#include <QImage>
+#include <QRect>
+#include <QSize>
+#include <QString>
+
+#include "../data/tilearchive.h"
+
+/**
+ * @class TileSource
+ * @brief 多分辨率地图瓦片的数据源
+ *
+ * 把地图图片看作图像金字塔：第 0 级为原始分辨率，每升一级长宽减半，
+ * 最高一级整张图放得进一个瓦片。每级按 tileSize() 切成瓦片，
+ * 第 level 级的一个瓦片覆盖原图中 (tileSize() << level) 像素见方的区域。
+ *
+ * loadTile() 会在后台线程中并发调用，实现必须是线程安全的。
+ */
+class TileSource {
+public:
+    static constexpr int kDefaultTileSize = 256;    ///< 默认瓦片边长（像素）
+
+    virtual ~TileSource() = default;
+
+    /**
+     * @brief 原图尺寸（像素）
+     */
+    virtual QSize imageSize() const = 0;
+
+    /**
+     * @brief 瓦片边长（像素）
+     */
+    virtual int tileSize() const { return kDefaultTileSize; }
+
+    /**
+     * @brief 解码一个瓦片
+     * @param level 金字塔级别（0 为原始分辨率）
+     * @param column 列号
+     * @param row 行号
+     * @return 瓦片图像（边缘瓦片可能小于 tileSize()），失败返回空图像
+     */
+    virtual QImage loadTile(int level, int column, int row) const = 0;
+
+    /**
+     * @brief 金字塔级数（最高一级整张图放得进一个瓦片）
+     */
+    int levelCount() const;
+
+    /**
+     * @brief 瓦片覆盖的原图区域
+     * @param level 金字塔级别
+     * @param column 列号
+     * @param row 行号
+     * @return 原图坐标中的矩形（已裁剪到图片范围）
+     */
+    QRect tileRect(int level, int column, int row) const;
+
+    /**
+     * @brief 指定级别的列数和行数
+     * @param level 金字塔级别
+     */
+    QSize gridSize(int level) const;
+};
+
+/**
+ * @class ImageFileTileSource
+ * @brief 直接从图片文件按区域解码瓦片
+ *
+ * 每个瓦片只解码所需区域，并按级别缩小（JPEG 等格式的读取器支持区域和缩放解码，
+ * 不需要把整张图读入内存）。不支持区域解码的格式会退化为整张解码后裁剪，
+ * 此时应使用预先切好的瓦片归档（ArchiveTileSource）。
+ */
+class ImageFileTileSource : public TileSource {
+public:
+    /**
+     * @brief 打开图片文件（只读取文件头）
+     * @param fileName 图片路径
+     */
+    explicit ImageFileTileSource(const QString& fileName);
+
+    /**
+     * @brief 文件是否可读
+     */
+    bool isValid() const { return !m_size.isEmpty(); }
+
+    QSize imageSize() const override { return m_size; }
+    QImage loadTile(int level, int column, int row) const override;
+
+private:
+    QString m_fileName;     ///< 图片路径
+    QSize m_size;           ///< 原图尺寸
+};
+
+/**
+ * @class ArchiveTileSource
+ * @brief 从预先切好的瓦片归档（MapTileGen 生成）读取瓦片
+ *
+ * 归档映射到内存，读取瓦片只需解码一个小图片，适用于任何格式和尺寸的地图。
+ */
+class ArchiveTileSource : public TileSource {
+public:
+    /**
+     * @brief 打开瓦片归档
+     * @param fileName 归档路径
+     */
+    explicit ArchiveTileSource(const QString& fileName);
+
+    /**
+     * @brief 归档是否可读
+     */
+    bool isValid() const { return m_archive.isOpen(); }
+
+    QSize imageSize() const override { return m_archive.header().imageSize; }
+    int tileSize() const override { return m_archive.header().tileSize; }
+    QImage loadTile(int level, int column, int row) const override;
+
+private:
+    TileArchive m_archive;  ///< 映射中的归档
+};
+
+#endif // TILESOURCE_H
@@ -6,7 +6,10 @@ TimelineWidget::TimelineWidget(QWidget* parent)
     , m_timeLabel(nullptr)
     , m_descriptionLabel(nullptr)
     , m_restoreButton(nullptr)
+    , m_snapshotCount(0)
     , m_currentIndex(-1)
+    , m_displayedIndex(-1)
+    , m_displayedMarkerCount(0)
 {
     // 创建主布局
     QVBoxLayout* mainLayout = new QVBoxLayout(this);
@@ -55,27 +58,42 @@ TimelineWidget::TimelineWidget(QWidget* parent)
     });
 }
 
-void TimelineWidget::setSnapshots(const QList<MapSnapshot>& snapshots) {
-    m_snapshots = snapshots;
+void TimelineWidget::setSnapshotCount(int count) {
+    if (count == m_snapshotCount) {
+        return;
+    }
+    m_snapshotCount = count;
 
-    if (m_snapshots.isEmpty()) {
+    if (m_snapshotCount <= 0) {
+        m_snapshotCount = 0;
+        m_currentIndex = -1;
+        m_displayedIndex = -1;
+        m_slider->blockSignals(true);
         m_slider->setRange(0, 0);
+        m_slider->blockSignals(false);
         m_slider->setEnabled(false);
         m_restoreButton->setEnabled(false);
         updateDisplay();
         return;
     }
 
-    // 更新滑块范围
-    m_slider->setRange(0, m_snapshots.size() - 1);
+    // 更新滑块范围（范围变化可能调整滑块位置，不应触发回溯）
+    m_slider->blockSignals(true);
+    m_slider->setRange(0, m_snapshotCount - 1);
+    m_slider->blockSignals(false);
     m_slider->setEnabled(true);
 
-    // 默认选中最新快照
-    setCurrentIndex(m_snapshots.size() - 1);
+    // 当前索引超出新范围时不再有效
+    if (m_currentIndex >= m_snapshotCount) {
+        m_currentIndex = -1;
+        m_displayedIndex = -1;
+    }
+    m_restoreButton->setEnabled(m_currentIndex >= 0 && m_currentIndex < m_snapshotCount - 1);
+    updateDisplay();
 }
 
-void TimelineWidget::setCurrentIndex(int index) {
-    if (index < 0 || index >= m_snapshots.size()) {
+void TimelineWidget::setCurrentSnapshot(int index, const MapSnapshot& snapshot) {
+    if (index < 0 || index >= m_snapshotCount) {
         return;
     }
 
@@ -84,52 +102,57 @@ void TimelineWidget::setCurrentIndex(int index) {
     m_slider->setValue(index);
     m_slider->blockSignals(false);
 
+    // 只保留显示用的摘要，不持有标记集合
+    m_displayedIndex = index;
+    m_displayedTime = snapshot.timestamp();
+    m_displayedDescription = snapshot.description();
+    m_displayedMarkerCount = snapshot.markerCount();
+
     // 更新按钮状态
-    bool isLatest = (index == m_snapshots.size() - 1);
+    bool isLatest = (index == m_snapshotCount - 1);
     m_restoreButton->setEnabled(!isLatest);
 
     updateDisplay();
 }
 
 void TimelineWidget::onSliderValueChanged(int value) {
-    if (value < 0 || value >= m_snapshots.size()) {
+    if (value < 0 || value >= m_snapshotCount) {
         return;
     }
 
     m_currentIndex = value;
 
     // 更新按钮状态
-    bool isLatest = (value == m_snapshots.size() - 1);
+    bool isLatest = (value == m_snapshotCount - 1);
     m_restoreButton->setEnabled(!isLatest);
 
     updateDisplay();
 
+    // 回溯完成后通过 setCurrentSnapshot 更新摘要
     emit indexChanged(value);
 }
 
 void TimelineWidget::updateDisplay() {
-    if (m_snapshots.isEmpty() || m_currentIndex < 0 || m_currentIndex >= m_snapshots.size()) {
+    // 拖动时回溯在后台完成，摘要可能暂时落后于滑块位置，此时继续显示上一个摘要
+    if (m_displayedIndex < 0 || m_displayedIndex >= m_snapshotCount) {
         m_timeLabel->setText("时间: --");
         m_descriptionLabel->setText("描述: --");
         return;
     }
 
-    const MapSnapshot& snapshot = m_snapshots[m_currentIndex];
-
     // 显示时间（格式: HH:mm:ss）
-    QString timeStr = snapshot.timestamp().toString("HH:mm:ss");
-    QString dateStr = snapshot.timestamp().toString("yyyy-MM-dd");
+    QString timeStr = m_displayedTime.toString("HH:mm:ss");
+    QString dateStr = m_displayedTime.toString("yyyy-MM-dd");
     m_timeLabel->setText(QString("时间: %1 %2").arg(dateStr, timeStr));
 
     // 显示描述
-    QString desc = snapshot.description();
+    QString desc = m_displayedDescription;
     if (desc.isEmpty()) {
-        desc = QString("快照 #%1").arg(m_currentIndex + 1);
+        desc = QString("快照 #%1").arg(m_displayedIndex + 1);
     }
     m_descriptionLabel->setText(QString("描述: %1").arg(desc));
 
     // 显示标记数量
-    int markerCount = snapshot.markers().size();
     m_descriptionLabel->setText(m_descriptionLabel->text() +
-                                QString("\n标记数: %1").arg(markerCount));
+                                QString("\n标记数: %1").arg(m_displayedMarkerCount));
 }
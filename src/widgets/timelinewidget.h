@@ -34,16 +34,19 @@ public:
     ~TimelineWidget() override = default;
 
     /**
-     * @brief 设置快照列表
-     * @param snapshots 快照列表
+     * @brief 设置快照数量（更新滑块范围）
+     * @param count 快照数量
+     *
+     * 时间轴不保存快照列表，只显示当前快照的摘要（见 setCurrentSnapshot）。
      */
-    void setSnapshots(const QList<MapSnapshot>& snapshots);
+    void setSnapshotCount(int count);
 
     /**
-     * @brief 设置当前快照索引
+     * @brief 设置当前快照
      * @param index 快照索引
+     * @param snapshot 快照对象（只保留时间、描述和标记数量用于显示）
      */
-    void setCurrentIndex(int index);
+    void setCurrentSnapshot(int index, const MapSnapshot& snapshot);
 
     /**
      * @brief 获取当前选中的索引
@@ -83,8 +86,12 @@ private:
     QLabel* m_timeLabel;                ///< 当前时间显示
     QLabel* m_descriptionLabel;         ///< 快照描述显示
     QPushButton* m_restoreButton;       ///< 返回最新按钮
-    QList<MapSnapshot> m_snapshots;     ///< 快照列表
+    int m_snapshotCount;                ///< 快照数量
     int m_currentIndex;                 ///< 当前索引
+    int m_displayedIndex;               ///< 摘要对应的快照索引（异步回溯时可能落后于当前索引）
+    QDateTime m_displayedTime;          ///< 摘要：快照时间
+    QString m_displayedDescription;     ///< 摘要：快照描述
+    int m_displayedMarkerCount;         ///< 摘要：标记数量
 };
 
 #endif // TimELINEWIDGET_H
@@ -0,0 +1,462 @@
+#include "datagenerator.h"
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QtEndian>
+#include <cmath>
+
+#include "src/data/dataschema.h"
+#include "src/data/mapjsoncodec.h"
+#include "src/data/markerpatch.h"
+#include "src/data/persistentmarkermap.h"
+#include "src/data/stringpool.h"
+
+namespace {
+
+/// 各用途的随机数流，与序号组合后互不相关
+enum Stream : quint64 {
+    PlanStream = 1,
+    ClusterStream,
+    PositionStream,
+    NoteStream,
+    CreatorStream,
+    ColorStream
+};
+
+quint64 splitMix(quint64 value) {
+    value += 0x9e3779b97f4a7c15ull;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+    return value ^ (value >> 31);
+}
+
+/**
+ * @brief 轻量随机数（splitmix64）
+ *
+ * 每个标记的各个属性都从 (种子, 用途, 序号) 派生独立的状态，
+ * 构造代价只有几次乘法，生成结果与线程划分无关。
+ */
+class Random {
+public:
+    Random(quint64 seed, Stream stream, quint64 index)
+        : m_state(splitMix(seed ^ splitMix((quint64(stream) << 56) ^ index))) {}
+
+    quint64 next() { return m_state = splitMix(m_state); }
+
+    /// [0, 1) 均匀分布
+    double uniform() { return double(next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    /// [0, bound) 均匀分布的整数
+    quint32 bounded(quint32 bound) { return quint32((next() >> 32) * bound >> 32); }
+
+    /// 标准正态分布（Box-Muller）
+    double gaussian() {
+        const double u1 = 1.0 - uniform();
+        const double u2 = uniform();
+        return std::sqrt(-2.0 * std::log(u1)) * std::cos(kTwoPi * u2);
+    }
+
+private:
+    static constexpr double kTwoPi = 6.283185307179586;
+
+    quint64 m_state;
+};
+
+/// 校园场景常用汉字，用于生成中文备注（也覆盖搜索索引的二元分词）
+const char kCjkText[] =
+    "图书馆自习室阅览区座位开放时间借阅归还书架期刊报纸电子资源检索"
+    "教学楼实验室食堂宿舍操场体育馆停车场快递站打印复印咖啡厅超市医院"
+    "东西南北门口一二三四五楼层靠窗安静插座空调饮水机卫生间电梯楼梯"
+    "今天明天上午下午晚上人多人少排队预约取消维修暂停通知注意小心";
+
+/// 标记颜色（与界面的颜色选项相近）
+const QRgb kPalette[] = {
+    0xffe74c3c, 0xff3498db, 0xff2ecc71, 0xfff1c40f,
+    0xff9b59b6, 0xffe67e22, 0xff1abc9c, 0xff34495e
+};
+
+const QDateTime kDefaultStartTime = QDateTime(QDate(2024, 9, 1), QTime(8, 0));
+
+/**
+ * @brief 把 [0, count) 分成若干段，交给线程池并行处理
+ * @param count 元素个数
+ * @param threads 线程数
+ * @param work 处理一段 [begin, end)
+ */
+template <typename Work>
+void parallelRanges(int count, int threads, const Work& work) {
+    if (threads <= 1 || count < 2) {
+        work(0, count);
+        return;
+    }
+
+    // 段数多于线程数，平衡各段代价的差异
+    const int rangeCount = qMin(count, threads * 4);
+    QVector<QPair<int, int>> ranges;
+    ranges.reserve(rangeCount);
+    for (int i = 0; i < rangeCount; ++i) {
+        ranges.append({int(qint64(count) * i / rangeCount),
+                       int(qint64(count) * (i + 1) / rangeCount)});
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    QtConcurrent::blockingMap(&pool, ranges, [&work](const QPair<int, int>& range) {
+        work(range.first, range.second);
+    });
+}
+
+void appendCborArrayHeader(QByteArray& out, quint64 count) {
+    // CBOR 主类型 4（数组），长度按 RFC 8949 的最短编码
+    if (count < 24) {
+        out += char(0x80 | count);
+    } else if (count <= 0xff) {
+        out += char(0x98);
+        out += char(count);
+    } else if (count <= 0xffff) {
+        char bytes[2];
+        qToBigEndian(quint16(count), bytes);
+        out += char(0x99);
+        out.append(bytes, 2);
+    } else if (count <= 0xffffffffull) {
+        char bytes[4];
+        qToBigEndian(quint32(count), bytes);
+        out += char(0x9a);
+        out.append(bytes, 4);
+    } else {
+        char bytes[8];
+        qToBigEndian(count, bytes);
+        out += char(0x9b);
+        out.append(bytes, 8);
+    }
+}
+
+} // namespace
+
+DataGenerator::DataGenerator(const Options& options)
+    : m_options(options)
+{
+    if (!m_options.startTime.isValid()) {
+        m_options.startTime = kDefaultStartTime;
+    }
+    m_options.markers = qMax(0, m_options.markers);
+    m_options.snapshots = qMax(1, m_options.snapshots);
+    m_options.creators = qMax(1, m_options.creators);
+    m_options.noteMaxLength = qMax(1, m_options.noteMaxLength);
+    m_options.eventIntervalSecs = qMax(1, m_options.eventIntervalSecs);
+
+    // 聚类中心避开地图边缘
+    for (int i = 0; i < m_options.clusters; ++i) {
+        Random random(m_options.seed, ClusterStream, quint64(i));
+        const double x = 0.1 + 0.8 * random.uniform();
+        const double y = 0.1 + 0.8 * random.uniform();
+        m_clusterCenters.append(QPointF(x, y));
+    }
+}
+
+bool DataGenerator::parseFormat(const QString& name, Format* format) {
+    const QString lower = name.toLower();
+    if (lower == "json") {
+        *format = Format::Json;
+    } else if (lower == "cbor") {
+        *format = Format::Cbor;
+    } else if (lower == "binary") {
+        *format = Format::Binary;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int DataGenerator::threadCount() const {
+    return m_options.threads > 0 ? m_options.threads : QThread::idealThreadCount();
+}
+
+QDateTime DataGenerator::eventTime(qint64 eventIndex) const {
+    return m_options.startTime.addSecs(eventIndex * m_options.eventIntervalSecs);
+}
+
+// ========== 事件规划 ==========
+
+QVector<DataGenerator::Event> DataGenerator::planEvents() const {
+    const double deleteRatio = qMax(0.0, m_options.deleteRatio);
+    const double updateRatio = qMax(0.0, m_options.updateRatio);
+    const double total = 1.0 + deleteRatio + updateRatio;
+    const double addProbability = 1.0 / total;
+    const double deleteProbability = deleteRatio / total;
+
+    QVector<Event> events;
+    events.reserve(int(m_options.markers * total) + 16);
+
+    // 当前存在的标记序号，删除时与末尾交换后移除
+    QVector<quint32> live;
+    live.reserve(m_options.markers);
+
+    Random random(m_options.seed, PlanStream, 0);
+    quint32 nextSerial = 0;
+    while (nextSerial < quint32(m_options.markers)) {
+        const double roll = random.uniform();
+        if (live.isEmpty() || roll < addProbability) {
+            events.append({Event::Add, nextSerial});
+            live.append(nextSerial++);
+            continue;
+        }
+
+        const int index = int(random.bounded(quint32(live.size())));
+        if (roll < addProbability + deleteProbability) {
+            events.append({Event::Delete, live[index]});
+            live[index] = live.last();
+            live.removeLast();
+        } else {
+            events.append({Event::Update, live[index]});
+        }
+    }
+    return events;
+}
+
+// ========== 标记属性 ==========
+
+QPointF DataGenerator::makePosition(quint64 key) const {
+    Random random(m_options.seed, PositionStream, key);
+    if (m_clusterCenters.isEmpty() || random.uniform() >= m_options.clusteredFraction) {
+        return QPointF(random.uniform(), random.uniform());
+    }
+
+    const QPointF center = m_clusterCenters[int(random.bounded(quint32(m_clusterCenters.size())))];
+    const double x = center.x() + random.gaussian() * m_options.clusterSpread;
+    const double y = center.y() + random.gaussian() * m_options.clusterSpread;
+    return QPointF(qBound(0.0, x, 1.0), qBound(0.0, y, 1.0));
+}
+
+QString DataGenerator::makeNote(quint64 key) const {
+    static const QString cjk = QString::fromUtf8(kCjkText);
+
+    Random random(m_options.seed, NoteStream, key);
+
+    // 长度服从均值为 noteMeanLength 的指数分布，截断到 noteMaxLength
+    const double mean = qMax(1, m_options.noteMeanLength);
+    const int length = qBound(1, 1 + int(-mean * std::log(1.0 - random.uniform())),
+                              m_options.noteMaxLength);
+
+    QString note;
+    note.reserve(length);
+    if (random.uniform() < m_options.cjkFraction) {
+        for (int i = 0; i < length; ++i) {
+            note += cjk[int(random.bounded(quint32(cjk.size())))];
+        }
+    } else {
+        // 英文：2-8 个字母的单词，以空格分隔
+        while (note.size() < length) {
+            if (!note.isEmpty()) {
+                note += ' ';
+            }
+            const int wordLength = 2 + int(random.bounded(7));
+            for (int i = 0; i < wordLength; ++i) {
+                note += QChar('a' + int(random.bounded(26)));
+            }
+        }
+        note.truncate(length);
+    }
+    return note;
+}
+
+QString DataGenerator::makeCreator(quint64 key) const {
+    Random random(m_options.seed, CreatorStream, key);
+
+    // u^(1+skew) 向 0 集中：skew 越大，少数创建者占的标记越多
+    const double u = std::pow(random.uniform(), 1.0 + qMax(0.0, m_options.creatorSkew));
+    const int index = qMin(m_options.creators - 1, int(u * m_options.creators));
+    return QString("user%1").arg(index);
+}
+
+CompactMarker DataGenerator::makeMarker(quint32 serial, qint64 eventIndex) const {
+    StringPool& strings = StringPool::markerStrings();
+    const QDateTime createTime = eventTime(eventIndex);
+    const QPointF position = makePosition(serial);
+    Random colorRandom(m_options.seed, ColorStream, serial);
+
+    // ID 格式与 Marker::generateId() 相同（marker-时间戳-序号），序号保证唯一
+    CompactMarker record;
+    record.id = strings.intern(QString("marker-%1-%2")
+                                   .arg(createTime.toMSecsSinceEpoch())
+                                   .arg(serial));
+    record.x = CompactMarker::toFixed(position.x());
+    record.y = CompactMarker::toFixed(position.y());
+    record.color = kPalette[colorRandom.bounded(sizeof(kPalette) / sizeof(kPalette[0]))];
+    record.createTime = createTime.toMSecsSinceEpoch();
+    record.timeOffset = CompactMarker::timeOffsetOf(createTime);
+    record.note = strings.intern(makeNote(serial));
+    record.createdBy = strings.intern(makeCreator(serial));
+    return record;
+}
+
+// ========== 生成 ==========
+
+QList<MapSnapshot> DataGenerator::generate(Stats* stats) const {
+    const QVector<Event> events = planEvents();
+    const int threads = threadCount();
+
+    // 新增事件在事件序列中的位置（决定创建时间）
+    QVector<qint64> addEventIndex(m_options.markers);
+    for (int i = 0; i < events.size(); ++i) {
+        if (events[i].type == Event::Add) {
+            addEventIndex[int(events[i].serial)] = i;
+        }
+    }
+
+    // 并行构造所有新增的标记（StringPool 是线程安全的）
+    QVector<CompactMarker> added(m_options.markers);
+    parallelRanges(m_options.markers, threads, [&](int begin, int end) {
+        for (int serial = begin; serial < end; ++serial) {
+            added[serial] = makeMarker(quint32(serial), addEventIndex[serial]);
+        }
+    });
+
+    // 顺序应用事件，每个快照结束时记录当前集合（O(1)，共享结构）
+    const StringPool& strings = StringPool::markerStrings();
+    const int snapshotCount = qMax(1, qMin(m_options.snapshots, int(events.size())));
+    Stats result;
+    PersistentMarkerMap markers;
+    QList<MapSnapshot> snapshots;
+    snapshots.reserve(snapshotCount);
+
+    int eventIndex = 0;
+    for (int s = 0; s < snapshotCount; ++s) {
+        const int last = int(qint64(events.size()) * (s + 1) / snapshotCount);
+        int addCount = 0;
+        int deleteCount = 0;
+        int updateCount = 0;
+        const CompactMarker* lastMarker = nullptr;
+        Event::Type lastType = Event::Add;
+
+        for (; eventIndex < last; ++eventIndex) {
+            const Event& event = events[eventIndex];
+            const CompactMarker& origin = added[int(event.serial)];
+            lastType = event.type;
+            switch (event.type) {
+            case Event::Add:
+                markers.insert(origin);
+                lastMarker = &origin;
+                ++addCount;
+                break;
+            case Event::Delete:
+                markers.remove(origin.id);
+                lastMarker = &origin;
+                ++deleteCount;
+                break;
+            case Event::Update: {
+                CompactMarker moved = *markers.find(origin.id);
+                // 新位置的随机数序号排在所有新增标记之后
+                const QPointF position = makePosition(quint64(m_options.markers) + quint64(eventIndex));
+                moved.x = CompactMarker::toFixed(position.x());
+                moved.y = CompactMarker::toFixed(position.y());
+                markers.insert(moved);
+                lastMarker = &origin;
+                ++updateCount;
+                break;
+            }
+            }
+        }
+
+        // 描述与 MarkerManager 的格式一致；一个快照包含多个事件时给出汇总
+        QString description;
+        if (addCount + deleteCount + updateCount == 1 && lastMarker) {
+            const QString note = strings.at(lastMarker->note);
+            if (lastType == Event::Update) {
+                MarkerPatch move;
+                move.fields = MarkerPatch::Position;
+                description = move.describe(note);
+            } else {
+                description = QString(lastType == Event::Add ? "添加标记: %1" : "删除标记: %1").arg(note.left(20));
+            }
+            description += QString(" (操作者: %1)").arg(strings.at(lastMarker->createdBy));
+        } else {
+            description = QString("批量变更: 新增 %1, 删除 %2, 移动 %3")
+                              .arg(addCount).arg(deleteCount).arg(updateCount);
+        }
+
+        snapshots.append(MapSnapshot(eventTime(qMax(0, last - 1)), markers, description));
+        result.added += addCount;
+        result.deleted += deleteCount;
+        result.updated += updateCount;
+        result.markerRecords += markers.size();
+    }
+
+    result.finalMarkers = markers.size();
+    if (stats) {
+        *stats = result;
+    }
+    return snapshots;
+}
+
+// ========== 编码 ==========
+
+QByteArray DataGenerator::encode(const QList<MapSnapshot>& snapshots, Format format) const {
+    const int threads = threadCount();
+    const int count = int(snapshots.size());
+
+    if (format == Format::Json && (threads <= 1 || count < 2)) {
+        return MapJsonCodec::writeSnapshots(snapshots, QJsonDocument::Indented);
+    }
+
+    // 按快照分段并行编码，每段的结果按原顺序拼接
+    const int partCount = qMax(1, qMin(count, threads * 4));
+    QVector<QByteArray> parts(partCount);
+    parallelRanges(partCount, threads, [&](int begin, int end) {
+        for (int part = begin; part < end; ++part) {
+            const int first = int(qint64(count) * part / partCount);
+            const int last = int(qint64(count) * (part + 1) / partCount);
+            QByteArray& out = parts[part];
+
+            if (format == Format::Json) {
+                // 缩进格式的数组为 "[\n" 元素 ",\n" 元素 "\n]\n"，去掉首尾后即可拼接
+                out = MapJsonCodec::writeSnapshots(snapshots.mid(first, last - first),
+                                                   QJsonDocument::Indented);
+                out = out.mid(2, out.size() - 5);
+                continue;
+            }
+            for (int i = first; i < last; ++i) {
+                if (format == Format::Cbor) {
+                    out += DataSchema::toCbor(snapshots[i]);
+                } else {
+                    const QByteArray record = DataSchema::toBinary(snapshots[i]);
+                    DataSchema::writeVarint(out, quint64(record.size()));
+                    out += record;
+                }
+            }
+        }
+    });
+
+    qsizetype total = 16;
+    for (const QByteArray& part : parts) {
+        total += part.size() + 2;
+    }
+
+    QByteArray out;
+    out.reserve(total);
+    switch (format) {
+    case Format::Json:
+        out += "[\n";
+        for (int i = 0; i < parts.size(); ++i) {
+            if (i > 0) {
+                out += ",\n";
+            }
+            out += parts[i];
+        }
+        out += "\n]\n";
+        break;
+    case Format::Cbor:
+        appendCborArrayHeader(out, quint64(count));
+        for (const QByteArray& part : parts) {
+            out += part;
+        }
+        break;
+    case Format::Binary:
+        DataSchema::writeVarint(out, quint64(count));
+        for (const QByteArray& part : parts) {
+            out += part;
+        }
+        break;
+    }
+    return out;
+}
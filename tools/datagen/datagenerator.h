@@ -0,0 +1,124 @@
+#ifndef DATAGENERATOR_H
+#define DATAGENERATOR_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QList>
+#include <QPointF>
+#include <QString>
+#include <QVector>
+
+#include "src/data/compactmarker.h"
+#include "src/data/mapsnapshot.h"
+
+/**
+ * @class DataGenerator
+ * @brief 合成的标记历史，用于负载和规模测试
+ *
+ * 历史由一串标记事件组成（添加 / 删除 / 修改位置），事件平均分配到各个快照，
+ * 每个快照保存该时刻的完整标记集合（与后端 map_data.json 相同）。
+ *
+ * 生成分三步：
+ * 1. 顺序规划事件（类型、目标标记），只涉及整数，代价很小
+ * 2. 并行构造新增的标记（位置、备注、颜色、创建者），
+ *    每个标记使用由种子和序号派生的独立随机数，结果与线程数无关
+ * 3. 顺序把事件应用到 PersistentMarkerMap，相邻快照共享未变化的部分
+ *
+ * 编码同样按快照分块并行，输出与 MapJsonCodec::writeSnapshots() 逐字节相同。
+ */
+class DataGenerator {
+public:
+    /**
+     * @brief 输出格式
+     */
+    enum class Format {
+        Json,       ///< 后端持久化格式（map_data.json，缩进 JSON）
+        Cbor,       ///< CBOR 数组，元素为 DataSchema::toCbor(快照)
+        Binary      ///< 快照数（varint）+ 每个快照的长度（varint）和 DataSchema::toBinary(快照)
+    };
+
+    /**
+     * @brief 生成参数
+     */
+    struct Options {
+        int markers = 10000;            ///< 新增标记总数（不同的标记ID数）
+        int snapshots = 1000;           ///< 快照数
+        double deleteRatio = 0.2;       ///< 删除事件数 / 新增事件数
+        double updateRatio = 0.2;       ///< 修改位置事件数 / 新增事件数
+        int clusters = 12;              ///< 空间聚类数（0 表示均匀分布）
+        double clusterSpread = 0.03;    ///< 聚类的标准差（归一化坐标）
+        double clusteredFraction = 0.8; ///< 落在聚类中的标记比例
+        int noteMeanLength = 16;        ///< 备注平均长度（字符，指数分布）
+        int noteMaxLength = 200;        ///< 备注最大长度
+        double cjkFraction = 0.7;       ///< 中文备注的比例
+        int creators = 200;             ///< 创建者数量
+        double creatorSkew = 1.0;       ///< 创建者分布的偏斜（0 为均匀，越大越集中于少数人）
+        quint64 seed = 1;               ///< 随机种子
+        QDateTime startTime;            ///< 第一个事件的时间（无效时使用 2024-09-01 08:00）
+        int eventIntervalSecs = 30;     ///< 相邻事件的时间间隔（秒）
+        int threads = 0;                ///< 线程数（<= 0 表示按 CPU 核数）
+    };
+
+    /**
+     * @brief 生成统计
+     */
+    struct Stats {
+        qint64 added = 0;           ///< 新增事件数
+        qint64 deleted = 0;         ///< 删除事件数
+        qint64 updated = 0;         ///< 修改事件数
+        qint64 markerRecords = 0;   ///< 所有快照中的标记记录总数（决定输出大小）
+        int finalMarkers = 0;       ///< 最后一个快照的标记数
+    };
+
+    /**
+     * @brief 构造函数
+     * @param options 生成参数
+     */
+    explicit DataGenerator(const Options& options);
+
+    /**
+     * @brief 生成快照历史
+     * @param stats 输出的统计信息（可选）
+     * @return 按时间排序的快照列表
+     */
+    QList<MapSnapshot> generate(Stats* stats = nullptr) const;
+
+    /**
+     * @brief 编码快照历史
+     * @param snapshots 快照列表
+     * @param format 输出格式
+     * @return 编码后的数据
+     */
+    QByteArray encode(const QList<MapSnapshot>& snapshots, Format format) const;
+
+    /**
+     * @brief 解析格式名称（json / cbor / binary）
+     * @param name 格式名称
+     * @param format 输出的格式
+     * @return 名称有效返回 true
+     */
+    static bool parseFormat(const QString& name, Format* format);
+
+private:
+    /**
+     * @brief 规划好的一个事件
+     */
+    struct Event {
+        enum Type : quint8 { Add, Delete, Update };
+        Type type;
+        quint32 serial;     ///< 目标标记的序号（新增事件按 0, 1, 2... 递增）
+    };
+
+    QVector<Event> planEvents() const;
+    CompactMarker makeMarker(quint32 serial, qint64 eventIndex) const;
+    QPointF makePosition(quint64 key) const;
+    QString makeNote(quint64 key) const;
+    QString makeCreator(quint64 key) const;
+    QDateTime eventTime(qint64 eventIndex) const;
+    int threadCount() const;
+
+    Options m_options;
+    QVector<QPointF> m_clusterCenters;  ///< 聚类中心
+};
+
+#endif // DATAGENERATOR_H
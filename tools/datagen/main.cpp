@@ -0,0 +1,127 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+#include <QDebug>
+
+#include "datagenerator.h"
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("MapDataGen");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("生成合成的标记历史（map_data.json），用于负载和规模测试");
+    parser.addHelpOption();
+
+    const DataGenerator::Options defaults;
+    QCommandLineOption outputOption(QStringList() << "o" << "output",
+                                    "输出文件", "file", "map_data.json");
+    QCommandLineOption formatOption(QStringList() << "format",
+                                    "输出格式：json（后端持久化格式）/ cbor / binary", "format", "json");
+    QCommandLineOption markersOption(QStringList() << "n" << "markers",
+                                     "新增标记总数", "count", QString::number(defaults.markers));
+    QCommandLineOption snapshotsOption(QStringList() << "m" << "snapshots",
+                                       "快照数（事件平均分配到各快照）", "count",
+                                       QString::number(defaults.snapshots));
+    QCommandLineOption deleteRatioOption(QStringList() << "delete-ratio",
+                                         "删除事件数与新增事件数之比", "ratio",
+                                         QString::number(defaults.deleteRatio));
+    QCommandLineOption updateRatioOption(QStringList() << "update-ratio",
+                                         "移动事件数与新增事件数之比", "ratio",
+                                         QString::number(defaults.updateRatio));
+    QCommandLineOption clustersOption(QStringList() << "clusters",
+                                      "空间聚类数（0 表示均匀分布）", "count",
+                                      QString::number(defaults.clusters));
+    QCommandLineOption spreadOption(QStringList() << "cluster-spread",
+                                    "聚类的标准差（归一化坐标）", "sigma",
+                                    QString::number(defaults.clusterSpread));
+    QCommandLineOption clusteredOption(QStringList() << "clustered-fraction",
+                                       "落在聚类中的标记比例", "fraction",
+                                       QString::number(defaults.clusteredFraction));
+    QCommandLineOption noteMeanOption(QStringList() << "note-mean",
+                                      "备注平均长度（字符）", "length",
+                                      QString::number(defaults.noteMeanLength));
+    QCommandLineOption noteMaxOption(QStringList() << "note-max",
+                                     "备注最大长度（字符）", "length",
+                                     QString::number(defaults.noteMaxLength));
+    QCommandLineOption cjkOption(QStringList() << "cjk-fraction",
+                                 "中文备注的比例", "fraction",
+                                 QString::number(defaults.cjkFraction));
+    QCommandLineOption creatorsOption(QStringList() << "creators",
+                                      "创建者数量", "count", QString::number(defaults.creators));
+    QCommandLineOption skewOption(QStringList() << "creator-skew",
+                                  "创建者分布的偏斜（0 为均匀）", "skew",
+                                  QString::number(defaults.creatorSkew));
+    QCommandLineOption seedOption(QStringList() << "seed",
+                                  "随机种子", "seed", QString::number(defaults.seed));
+    QCommandLineOption intervalOption(QStringList() << "interval",
+                                      "相邻事件的时间间隔（秒）", "seconds",
+                                      QString::number(defaults.eventIntervalSecs));
+    QCommandLineOption threadsOption(QStringList() << "j" << "threads",
+                                     "线程数（0 表示按 CPU 核数）", "count", "0");
+
+    parser.addOptions({outputOption, formatOption, markersOption, snapshotsOption,
+                       deleteRatioOption, updateRatioOption, clustersOption, spreadOption,
+                       clusteredOption, noteMeanOption, noteMaxOption, cjkOption,
+                       creatorsOption, skewOption, seedOption, intervalOption, threadsOption});
+    parser.process(app);
+
+    DataGenerator::Format format;
+    if (!DataGenerator::parseFormat(parser.value(formatOption), &format)) {
+        qCritical() << "Unknown output format:" << parser.value(formatOption);
+        return 1;
+    }
+
+    DataGenerator::Options options;
+    options.markers = parser.value(markersOption).toInt();
+    options.snapshots = parser.value(snapshotsOption).toInt();
+    options.deleteRatio = parser.value(deleteRatioOption).toDouble();
+    options.updateRatio = parser.value(updateRatioOption).toDouble();
+    options.clusters = parser.value(clustersOption).toInt();
+    options.clusterSpread = parser.value(spreadOption).toDouble();
+    options.clusteredFraction = parser.value(clusteredOption).toDouble();
+    options.noteMeanLength = parser.value(noteMeanOption).toInt();
+    options.noteMaxLength = parser.value(noteMaxOption).toInt();
+    options.cjkFraction = parser.value(cjkOption).toDouble();
+    options.creators = parser.value(creatorsOption).toInt();
+    options.creatorSkew = parser.value(skewOption).toDouble();
+    options.seed = parser.value(seedOption).toULongLong();
+    options.eventIntervalSecs = parser.value(intervalOption).toInt();
+    options.threads = parser.value(threadsOption).toInt();
+
+    QTextStream out(stdout);
+    QElapsedTimer timer;
+    timer.start();
+
+    DataGenerator generator(options);
+    DataGenerator::Stats stats;
+    const QList<MapSnapshot> snapshots = generator.generate(&stats);
+    const qint64 generateMs = timer.restart();
+
+    const QByteArray data = generator.encode(snapshots, format);
+    const qint64 encodeMs = timer.restart();
+
+    QFile file(parser.value(outputOption));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCritical() << "Failed to open output file:" << file.errorString();
+        return 1;
+    }
+    if (file.write(data) != data.size()) {
+        qCritical() << "Failed to write output file:" << file.errorString();
+        return 1;
+    }
+    file.close();
+    const qint64 writeMs = timer.elapsed();
+
+    out << "事件: 新增 " << stats.added << ", 删除 " << stats.deleted
+        << ", 移动 " << stats.updated << "\n"
+        << "快照: " << snapshots.size() << ", 最终标记数 " << stats.finalMarkers
+        << ", 标记记录 " << stats.markerRecords << "\n"
+        << "输出: " << file.fileName() << " (" << data.size() << " 字节)\n"
+        << "耗时: 生成 " << generateMs << " ms, 编码 " << encodeMs
+        << " ms, 写入 " << writeMs << " ms\n";
+    return 0;
+}
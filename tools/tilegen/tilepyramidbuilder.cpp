@@ -0,0 +1,230 @@
+#include "tilepyramidbuilder.h"
+#include <QBuffer>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QThread>
+#include <QtConcurrent>
+
+#include "src/data/tilearchive.h"
+
+namespace {
+
+/**
+ * @brief 把 [0, count) 分成若干段，交给线程池并行处理
+ * @param count 元素个数
+ * @param pool 线程池
+ * @param work 处理一段 [begin, end)
+ */
+template <typename Work>
+void parallelRanges(int count, QThreadPool* pool, const Work& work) {
+    const int threads = pool->maxThreadCount();
+    if (threads <= 1 || count < 2) {
+        work(0, count);
+        return;
+    }
+
+    // 段数多于线程数，平衡各段代价的差异
+    const int rangeCount = qMin(count, threads * 4);
+    QVector<QPair<int, int>> ranges;
+    ranges.reserve(rangeCount);
+    for (int i = 0; i < rangeCount; ++i) {
+        ranges.append({int(qint64(count) * i / rangeCount),
+                       int(qint64(count) * (i + 1) / rangeCount)});
+    }
+
+    QtConcurrent::blockingMap(pool, ranges, [&work](const QPair<int, int>& range) {
+        work(range.first, range.second);
+    });
+}
+
+/**
+ * @brief 四个 32 位像素逐通道求平均（四舍五入）
+ *
+ * 一次处理两个通道：每个通道放在 16 位的槽里，4 个 8 位值之和不超过 10 位，
+ * 不会溢出到相邻的槽。循环体只有整数加法和移位，编译器可以直接向量化。
+ */
+inline quint32 average4(quint32 a, quint32 b, quint32 c, quint32 d) {
+    constexpr quint32 kMask = 0x00ff00ffu;
+    constexpr quint32 kRounding = 0x00020002u;
+    const quint32 rb = (a & kMask) + (b & kMask) + (c & kMask) + (d & kMask) + kRounding;
+    const quint32 ag = ((a >> 8) & kMask) + ((b >> 8) & kMask) + ((c >> 8) & kMask)
+                       + ((d >> 8) & kMask) + kRounding;
+    return ((rb >> 2) & kMask) | (((ag >> 2) & kMask) << 8);
+}
+
+QByteArray encodeTile(const QImage& tile, const QByteArray& format, int quality) {
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+
+    QImageWriter writer(&buffer, format);
+    writer.setQuality(quality);
+    if (!writer.write(tile)) {
+        qWarning() << "Failed to encode tile:" << writer.errorString();
+        return QByteArray();
+    }
+    return data;
+}
+
+} // namespace
+
+TilePyramidBuilder::TilePyramidBuilder(const Options& options)
+    : m_options(options)
+{
+    m_pool.setMaxThreadCount(options.threads > 0 ? options.threads : QThread::idealThreadCount());
+}
+
+bool TilePyramidBuilder::build(const QString& inputFile, const QString& outputFile, Stats* stats) {
+    Stats local;
+    Stats& result = stats ? *stats : local;
+    result = Stats();
+
+    if (m_options.tileSize <= 0) {
+        m_error = QStringLiteral("瓦片边长无效: %1").arg(m_options.tileSize);
+        return false;
+    }
+    if (!QImageWriter::supportedImageFormats().contains(m_options.format)) {
+        m_error = QStringLiteral("不支持的瓦片格式: %1").arg(QString::fromLatin1(m_options.format));
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // 原图只解码一次；解除 QImageReader 默认的 256MB 分配上限
+    QImageReader::setAllocationLimit(0);
+    QImageReader reader(inputFile);
+    QImage image = reader.read();
+    if (image.isNull()) {
+        m_error = QStringLiteral("无法读取图片: %1").arg(reader.errorString());
+        return false;
+    }
+    image.convertTo(image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied
+                                            : QImage::Format_RGB32);
+    result.decodeMs = timer.restart();
+
+    TileArchive::Header header;
+    header.imageSize = image.size();
+    header.tileSize = m_options.tileSize;
+    header.levelCount = TileArchive::levelCountFor(header.imageSize, header.tileSize);
+    header.format = m_options.format;
+    result.imageSize = header.imageSize;
+    result.levels = header.levelCount;
+
+    TileArchiveWriter writer(outputFile);
+    if (!writer.begin(header)) {
+        m_error = writer.errorString();
+        return false;
+    }
+
+    const int tileSize = header.tileSize;
+    const int batchSize = qMax(64, m_pool.maxThreadCount() * 8);
+    QVector<int> batch;
+    QVector<QByteArray> encoded;
+
+    for (int level = 0; level < header.levelCount; ++level) {
+        if (level > 0) {
+            timer.restart();
+            image = downsample(image, &m_pool);
+            result.downsampleMs += timer.elapsed();
+            if (image.isNull()) {
+                m_error = QStringLiteral("内存不足，无法生成第 %1 级").arg(level);
+                return false;
+            }
+        }
+
+        timer.restart();
+        const QSize grid = TileArchive::gridSizeFor(header.imageSize, tileSize, level);
+        const qint64 count = qint64(grid.width()) * grid.height();
+
+        // 按批并行编码，再按顺序写入，编码结果只保留一批
+        for (qint64 first = 0; first < count; first += batchSize) {
+            const int size = int(qMin<qint64>(batchSize, count - first));
+            batch.resize(size);
+            for (int i = 0; i < size; ++i) {
+                batch[i] = i;
+            }
+            encoded.fill(QByteArray(), size);
+            QByteArray* output = encoded.data();
+
+            const QImage& source = image;
+            QtConcurrent::blockingMap(&m_pool, batch, [&](int i) {
+                const qint64 tile = first + i;
+                const int column = int(tile % grid.width());
+                const int row = int(tile / grid.width());
+                const QRect area = QRect(column * tileSize, row * tileSize, tileSize, tileSize)
+                                       .intersected(source.rect());
+
+                // 直接引用原图的像素，不复制
+                const QImage view(source.constBits() + qsizetype(area.top()) * source.bytesPerLine()
+                                      + qsizetype(area.left()) * 4,
+                                  area.width(), area.height(), source.bytesPerLine(), source.format());
+                output[i] = encodeTile(view, m_options.format, m_options.quality);
+            });
+
+            for (int i = 0; i < size; ++i) {
+                const qint64 tile = first + i;
+                const int column = int(tile % grid.width());
+                const int row = int(tile / grid.width());
+                if (encoded[i].isEmpty()) {
+                    m_error = QStringLiteral("编码瓦片失败: %1/%2/%3").arg(level).arg(column).arg(row);
+                    return false;
+                }
+                if (!writer.writeTile(level, column, row, encoded[i])) {
+                    m_error = writer.errorString();
+                    return false;
+                }
+            }
+        }
+
+        result.tiles += count;
+        result.encodeMs += timer.elapsed();
+    }
+
+    result.bytes = writer.bytesWritten();
+    if (!writer.finish()) {
+        m_error = writer.errorString();
+        return false;
+    }
+    return true;
+}
+
+QImage TilePyramidBuilder::downsample(const QImage& image, QThreadPool* pool) {
+    Q_ASSERT(image.depth() == 32);
+
+    const int width = (image.width() + 1) / 2;
+    const int height = (image.height() + 1) / 2;
+    QImage result(width, height, image.format());
+    if (result.isNull()) {
+        return result;
+    }
+
+    const uchar* sourceBits = image.constBits();
+    const qsizetype sourceStride = image.bytesPerLine();
+    uchar* targetBits = result.bits();
+    const qsizetype targetStride = result.bytesPerLine();
+    const int lastRow = image.height() - 1;
+    const int lastColumn = image.width() - 1;
+    const int pairs = image.width() / 2;    // 完整的两像素对数
+
+    parallelRanges(height, pool, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            const quint32* top = reinterpret_cast<const quint32*>(sourceBits + qsizetype(2 * y) * sourceStride);
+            const quint32* bottom = reinterpret_cast<const quint32*>(
+                sourceBits + qsizetype(qMin(2 * y + 1, lastRow)) * sourceStride);
+            quint32* out = reinterpret_cast<quint32*>(targetBits + qsizetype(y) * targetStride);
+
+            for (int x = 0; x < pairs; ++x) {
+                out[x] = average4(top[2 * x], top[2 * x + 1], bottom[2 * x], bottom[2 * x + 1]);
+            }
+            // 奇数宽度：最后一列与自身平均
+            if (width > pairs) {
+                out[pairs] = average4(top[lastColumn], top[lastColumn],
+                                      bottom[lastColumn], bottom[lastColumn]);
+            }
+        }
+    });
+    return result;
+}